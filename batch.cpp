@@ -0,0 +1,177 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/batch.h"
+#include <fstream>
+
+using namespace stdopt;
+
+
+STDOPT_INLINE
+batch_result_c::batch_result_c( const config_schema_c &schema
+		, const std::string &name, const char *begin, const char *end )
+: m_name( name )
+, m_begin( begin )
+, m_end( end )
+, m_values( schema )
+{}
+
+
+STDOPT_INLINE
+config_batch_c::config_batch_c( const config_schema_c &schema, int threads )
+: m_schema( schema )
+, m_result()
+, m_threads( threads )
+, m_worker()
+, m_mutex()
+, m_start()
+, m_done()
+, m_round( 0 )
+, m_busy( 0 )
+, m_stop( false )
+, m_next( 0 )
+, m_buffer()
+{
+	if ( m_threads <= 0 ) {
+		m_threads = std::thread::hardware_concurrency();
+	}
+	if ( m_threads <= 0 ) {
+		m_threads = 1;
+	}
+}
+
+STDOPT_INLINE
+config_batch_c::~config_batch_c()
+{
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_stop = true;
+	}
+	m_start.notify_all();
+	for ( std::size_t i(0); i<m_worker.size(); ++i ) {
+		m_worker[ i ].join();
+	}
+}
+
+STDOPT_INLINE
+void config_batch_c::add_file( const std::string &path )
+{
+	m_result.emplace_back( m_schema, path, nullptr, nullptr );
+}
+
+STDOPT_INLINE
+void config_batch_c::add_buffer( const std::string &name, const char *begin
+		, const char *end )
+{
+	m_result.emplace_back( m_schema, name, begin, end );
+}
+
+STDOPT_INLINE
+bool config_batch_c::parse()
+{
+	if ( m_result.empty() ) {
+		return true;
+	}
+	if ( m_worker.empty() ) {
+		// the calling thread is one of the workers
+		for ( int i(1); i<m_threads; ++i ) {
+			m_worker.emplace_back( &config_batch_c::run_worker, this );
+		}
+	}
+
+	m_next.store( 0, std::memory_order_relaxed );
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		++m_round;
+		m_busy = m_worker.size();
+	}
+	m_start.notify_all();
+	claim_items( m_buffer );
+	{
+		// taking the lock after each worker is done with the round
+		// makes its results visible here
+		std::unique_lock< std::mutex > lock( m_mutex );
+		m_done.wait( lock, [ this ]() { return m_busy == 0; } );
+	}
+
+	std::vector< batch_result_c >::const_iterator it;
+	for ( it=m_result.begin(); it!=m_result.end(); ++it ) {
+		if ( it->error() ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+STDOPT_INLINE
+void config_batch_c::run_worker()
+{
+	// each worker reuses one buffer for every file it reads
+	std::string buffer;
+	uint64_t round( 0 );
+	std::unique_lock< std::mutex > lock( m_mutex );
+	for ( ;; ) {
+		m_start.wait( lock, [ this, round ]()
+				{ return m_stop || m_round != round; } );
+		if ( m_stop ) {
+			return;
+		}
+		round = m_round;
+		lock.unlock();
+		claim_items( buffer );
+		lock.lock();
+		if ( --m_busy == 0 ) {
+			m_done.notify_one();
+		}
+	}
+}
+
+STDOPT_INLINE
+void config_batch_c::claim_items( std::string &buffer )
+{
+	for ( ;; ) {
+		std::size_t i( m_next.fetch_add( 1, std::memory_order_relaxed ) );
+		if ( i >= m_result.size() ) {
+			return;
+		}
+		parse_item( m_result[ i ], buffer );
+	}
+}
+
+STDOPT_INLINE
+void config_batch_c::parse_item( batch_result_c &result
+		, std::string &buffer ) const
+{
+	result.m_values.clear();
+	if ( result.m_begin ) {
+		result.m_values.parse( result.m_begin, result.m_end );
+		return;
+	}
+
+	std::ifstream input( result.m_name.c_str(), std::ios::binary );
+	if ( ! input ) {
+		result.m_values.add_diagnostic( config_diagnostic_c( 0
+					, std::string_view(), "cannot read file" ) );
+		return;
+	}
+	buffer.clear();
+	read_text( input, buffer );
+	if ( input.bad() ) {
+		result.m_values.add_diagnostic( config_diagnostic_c( 0
+					, std::string_view(), "cannot read file" ) );
+		return;
+	}
+	result.m_values.parse( buffer.data(), buffer.data() + buffer.size() );
+}
@@ -0,0 +1,294 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Benchmark runner and regression gate.
+ *
+ *   run_stdopt_bench [--samples N] [--baseline FILE] [--threshold PCT]
+ *                    [--write-baseline FILE] [--filter NAME]
+ *
+ * Each benchmark is sampled N times.  The median throughput and a 95%
+ * confidence interval for the median are reported along with heap
+ * allocations per iteration.  With --baseline, the exit status is
+ * non-zero if any benchmark's throughput fell, or its allocations grew,
+ * by more than the threshold percentage.  Throughput only counts as
+ * fallen when the upper end of its confidence interval is below the
+ * threshold.
+ */
+
+#include "bench.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <vector>
+#include <time.h>
+
+using namespace bench;
+
+
+// counted from every thread, the batch benchmarks allocate on workers
+static std::atomic< unsigned long > allocation_count( 0 );
+
+void * operator new( std::size_t size )
+{
+	allocation_count.fetch_add( 1, std::memory_order_relaxed );
+	void *ptr( malloc( size ? size : 1 ) );
+	if ( ! ptr ) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void * operator new[]( std::size_t size )
+{
+	return operator new( size );
+}
+
+void operator delete( void *ptr ) throw()
+{
+	free( ptr );
+}
+
+void operator delete[]( void *ptr ) throw()
+{
+	free( ptr );
+}
+
+void operator delete( void *ptr, std::size_t ) throw()
+{
+	free( ptr );
+}
+
+void operator delete[]( void *ptr, std::size_t ) throw()
+{
+	free( ptr );
+}
+
+
+namespace {
+
+struct benchmark_s
+{
+	const char *name;
+	bench_fn fn;
+	int iterations;
+};
+
+struct result_s
+{
+	double median;
+	double ci_low;
+	double ci_high;
+	double allocs;
+};
+
+struct baseline_s
+{
+	double throughput;
+	double allocs;
+};
+
+std::vector< benchmark_s > & benchmarks()
+{
+	static std::vector< benchmark_s > list;
+	return list;
+}
+
+double now()
+{
+	timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Run one benchmark for the given number of samples.
+ */
+result_s run( const benchmark_s &b, int samples )
+{
+	// warm up caches and any lazily built state
+	b.fn( b.iterations / 10 + 1 );
+
+	std::vector< double > rates;
+	unsigned long allocs( 0 );
+	for ( int i(0); i<samples; ++i ) {
+		unsigned long start_allocs( allocation_count.load() );
+		double start( now() );
+		b.fn( b.iterations );
+		double elapsed( now() - start );
+		allocs += allocation_count.load() - start_allocs;
+		rates.push_back( b.iterations / elapsed );
+	}
+	std::sort( rates.begin(), rates.end() );
+
+	result_s r;
+	int n( rates.size() );
+	r.median = n % 2 ? rates[ n / 2 ]
+		: ( rates[ n / 2 - 1 ] + rates[ n / 2 ] ) / 2;
+
+	// distribution free confidence interval for the median
+	// from the order statistics around it
+	double spread( 1.96 * std::sqrt( (double) n ) / 2 );
+	int low( (int) std::floor( n / 2.0 - spread ) );
+	int high( (int) std::ceil( n / 2.0 + spread ) );
+	r.ci_low = rates[ std::max( low, 0 ) ];
+	r.ci_high = rates[ std::min( high, n - 1 ) ];
+	r.allocs = (double) allocs / ( (double) samples * b.iterations );
+	return r;
+}
+
+/**
+ * Read a baseline file.  Each line is
+ *   name throughput allocs_per_iteration
+ * Blank lines and lines starting with # are ignored.
+ */
+bool read_baseline( const char *path
+		, std::map< std::string, baseline_s > &baseline )
+{
+	std::ifstream input( path );
+	if ( ! input ) {
+		return false;
+	}
+
+	std::string line;
+	while ( getline( input, line ) ) {
+		if ( line.empty() || line[0] == '#' ) {
+			continue;
+		}
+		std::istringstream fields( line );
+		std::string name;
+		baseline_s b;
+		if ( fields >> name >> b.throughput >> b.allocs ) {
+			baseline[ name ] = b;
+		}
+	}
+	return true;
+}
+
+void usage_error( const char *program )
+{
+	std::cerr << "Usage: " << program << " [--samples N]"
+		" [--baseline FILE] [--threshold PCT]"
+		" [--write-baseline FILE] [--filter NAME]\n";
+	exit( 2 );
+}
+
+} // end namespace
+
+
+register_c::register_c( const char *name, bench_fn fn, int iterations )
+{
+	benchmark_s b = { name, fn, iterations };
+	benchmarks().push_back( b );
+}
+
+
+int main( int argc, const char **argv )
+{
+	int samples( 11 );
+	double threshold( 20.0 );
+	const char *baseline_path( NULL );
+	const char *write_path( NULL );
+	const char *filter( NULL );
+
+	for ( int i(1); i<argc; ++i ) {
+		if ( i + 1 >= argc ) {
+			usage_error( argv[0] );
+		}
+		if ( strcmp( argv[i], "--samples" ) == 0 ) {
+			samples = atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "--threshold" ) == 0 ) {
+			threshold = atof( argv[++i] );
+		} else if ( strcmp( argv[i], "--baseline" ) == 0 ) {
+			baseline_path = argv[++i];
+		} else if ( strcmp( argv[i], "--write-baseline" ) == 0 ) {
+			write_path = argv[++i];
+		} else if ( strcmp( argv[i], "--filter" ) == 0 ) {
+			filter = argv[++i];
+		} else {
+			usage_error( argv[0] );
+		}
+	}
+	if ( samples < 1 ) {
+		usage_error( argv[0] );
+	}
+
+	std::map< std::string, baseline_s > baseline;
+	if ( baseline_path && ! read_baseline( baseline_path, baseline ) ) {
+		std::cerr << "cannot read baseline " << baseline_path << "\n";
+		return 2;
+	}
+
+	std::ostringstream written;
+	written << "# name throughput(iterations/s) allocations/iteration\n";
+
+	bool regressed( false );
+	printf( "%-28s %14s %27s %10s %9s\n", "benchmark", "median/s"
+			, "95% ci", "allocs/it", "change" );
+
+	std::vector< benchmark_s >::const_iterator it;
+	for ( it=benchmarks().begin(); it!=benchmarks().end(); ++it ) {
+		if ( filter && ! strstr( it->name, filter ) ) {
+			continue;
+		}
+		result_s r( run( *it, samples ) );
+		written << it->name << ' ' << r.median << ' ' << r.allocs << '\n';
+
+		printf( "%-28s %14.0f [%12.0f, %12.0f] %10.2f", it->name
+				, r.median, r.ci_low, r.ci_high, r.allocs );
+
+		std::map< std::string, baseline_s >::const_iterator base(
+				baseline.find( it->name ) );
+		if ( base == baseline.end() ) {
+			printf( " %9s\n", baseline_path ? "new" : "" );
+			continue;
+		}
+
+		// only call it slower if the whole confidence interval is
+		// below the allowed throughput so noisy runs don't fail
+		double change( ( r.median / base->second.throughput - 1 ) * 100 );
+		bool slower( r.ci_high < base->second.throughput
+				* ( 1 - threshold / 100 ) );
+		bool more_allocs( r.allocs > base->second.allocs
+				* ( 1 + threshold / 100 ) + 0.005 );
+		printf( " %+8.1f%%%s%s\n", change, slower ? " SLOWER" : ""
+				, more_allocs ? " ALLOCS" : "" );
+		regressed = regressed || slower || more_allocs;
+	}
+
+	if ( write_path ) {
+		std::ofstream output( write_path );
+		output << written.str();
+		if ( ! output ) {
+			std::cerr << "cannot write baseline " << write_path << "\n";
+			return 2;
+		}
+	}
+
+	if ( regressed ) {
+		std::cerr << "performance regressed by more than " << threshold
+			<< "% against " << baseline_path << "\n";
+		return 1;
+	}
+	return 0;
+}
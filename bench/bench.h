@@ -0,0 +1,59 @@
+#ifndef STDOPT_BENCH_H
+#define STDOPT_BENCH_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+namespace bench {
+
+
+/**
+ * A benchmark body.  It should run the measured operation the given
+ * number of times.
+ */
+typedef void (*bench_fn)( int iterations );
+
+/**
+ * Registers a benchmark with the runner at static init time.
+ */
+class register_c
+{
+public:
+	register_c( const char *name, bench_fn fn, int iterations );
+};
+
+/**
+ * Keep the compiler from optimizing away a value computed by a benchmark.
+ */
+template < typename T >
+void keep( const T &value )
+{
+	asm volatile( "" : : "g"( &value ) : "memory" );
+}
+
+
+} // end namespace
+
+/**
+ * Define a benchmark.  The body runs the measured operation `iterations`
+ * times.  Throughput is reported in iterations per second.
+ */
+#define STDOPT_BENCH( name, count ) \
+	static void name( int ); \
+	static bench::register_c name##_register( #name, name, count ); \
+	static void name( int iterations )
+
+#endif
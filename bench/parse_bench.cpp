@@ -0,0 +1,208 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bench.h"
+#ifdef STDOPT_BENCH_SINGLE
+#define STDOPT_HEADER_ONLY
+#include "stdopt_single.h"
+#else
+#include "stdopt/batch.h"
+#include "stdopt/configuration.h"
+#include "stdopt/usage.h"
+#endif
+#include <sstream>
+
+using namespace stdopt;
+
+
+/**
+ * Parse a typical command line with a mix of short, long, attached
+ * and positional arguments.
+ */
+STDOPT_BENCH( usage_parse_args, 20000 )
+{
+	const char *argv[] = { "bin", "-vx", "--output=/var/log/out.log"
+		, "-f", "xml", "--depth=12", "--verb", "--include=src/include"
+		, "--include=test", "input.txt" };
+	const int argc( sizeof( argv ) / sizeof( argv[0] ) );
+
+	for ( int i(0); i<iterations; ++i ) {
+		usage_option_c< bool > external( 'x', "external", "External." );
+		usage_option_c< bool > verbose( 'v', "verbose", "Verbose." );
+		usage_option_c< std::string > output( 'o', "output", "Output." );
+		usage_option_c< std::string > format( 'f', "format", "Format." );
+		usage_option_c< int > depth( 'd', "depth", "Depth." );
+		usage_option_c< std::string > include( 'i', "include", "Include." );
+		positional_value_c< std::string > input;
+
+		usage_c usage;
+		usage.add( external );
+		usage.add( verbose );
+		usage.add( output );
+		usage.add( format );
+		usage.add( depth );
+		usage.add( include );
+		usage.add( input );
+		bench::keep( usage.parse_args( argc, argv ) );
+	}
+}
+
+/**
+ * Parse argv style commands, like a command server does, through one
+ * usage that's reset between commands.  Throughput is commands per
+ * second and the options are only set up once, so allocations per
+ * command should be 0.
+ */
+STDOPT_BENCH( usage_reparse_commands, 50000 )
+{
+	const char *restart[] = { "restart", "-v", "--service=api", "-g", "5" };
+	const char *drain[] = { "drain", "--service=db", "--grace=30", "-f" };
+	const char *status[] = { "status", "-vf", "--serv=cache" };
+	const char **commands[] = { restart, drain, status };
+	const int argc[] = { 5, 4, 3 };
+
+	usage_option_c< bool > verbose( 'v', "verbose", "Verbose." );
+	usage_option_c< bool > force( 'f', "force", "Force." );
+	usage_option_c< std::string > service( 's', "service", "Service." );
+	usage_option_c< int > grace( 'g', "grace", "Grace seconds." );
+	usage_c usage;
+	usage.add( verbose );
+	usage.add( force );
+	usage.add( service );
+	usage.add( grace );
+
+	for ( int i(0); i<iterations; ++i ) {
+		usage.reset();
+		bench::keep( usage.parse_args( argc[ i % 3 ], commands[ i % 3 ] ) );
+	}
+}
+
+/**
+ * Look up long options in a usage with a large number of options.
+ */
+STDOPT_BENCH( usage_many_options, 200 )
+{
+	const int option_count( 1000 );
+	std::vector< std::string > names;
+	std::vector< std::string > args;
+	for ( int i(0); i<option_count; ++i ) {
+		std::ostringstream name;
+		name << "plugin-option-" << i;
+		names.push_back( name.str() );
+		args.push_back( "--" + name.str() + "=" + name.str() );
+	}
+	std::vector< const char * > argv( 1, "bin" );
+	for ( int i(0); i<option_count; i+=10 ) {
+		argv.push_back( args[i].c_str() );
+	}
+
+	for ( int i(0); i<iterations; ++i ) {
+		std::vector< usage_option_c< std::string > * > options;
+		usage_c usage;
+		for ( int j(0); j<option_count; ++j ) {
+			options.push_back( new usage_option_c< std::string >( 0
+						, names[j] ) );
+			usage.add( *options.back() );
+		}
+		bench::keep( usage.parse_args( argv.size(), &argv[0] ) );
+		for ( int j(0); j<option_count; ++j ) {
+			delete options[j];
+		}
+	}
+}
+
+/**
+ * Parse a medium sized configuration file.
+ */
+STDOPT_BENCH( config_parse, 500 )
+{
+	std::ostringstream text;
+	for ( int i(0); i<100; ++i ) {
+		text << "port = " << 4000 + i << "\n";
+		text << "host=backend-" << i << ".example.com\n";
+		text << "session-timeout = " << i << " \r\n";
+		text << "\n";
+		text << "debug=1\n";
+	}
+	const std::string input_text( text.str() );
+
+	for ( int i(0); i<iterations; ++i ) {
+		config_option_c< int > port( "port", "Port." );
+		config_option_c< std::string > host( "host", "Host." );
+		config_option_c< int > timeout( "session-timeout", "Timeout." );
+		config_option_c< bool > debug( "debug", "Debug." );
+
+		configuration_c config;
+		config.add( port );
+		config.add( host );
+		config.add( timeout );
+		config.add( debug );
+
+		std::istringstream input( input_text );
+		config.parse( input );
+		bench::keep( config.error() );
+	}
+}
+
+/**
+ * Parse a batch of 64 small tenant configurations on the given number
+ * of threads.  The batch and its workers are set up once, so each
+ * iteration is one parse() of the whole batch and the throughputs of
+ * the batch_parse benchmarks show how parsing scales with threads.
+ */
+static void parse_batch( int threads, int iterations )
+{
+	config_schema_c schema;
+	schema.add( 80, "port", "Port." );
+	schema.add( std::string( "localhost" ), "host", "Host." );
+	schema.add( 30, "session-timeout", "Timeout." );
+	schema.add( false, "debug", "Debug." );
+
+	std::vector< std::string > text;
+	for ( int i(0); i<64; ++i ) {
+		std::ostringstream tenant;
+		for ( int j(0); j<20; ++j ) {
+			tenant << "port = " << 4000 + i << "\n";
+			tenant << "host=tenant-" << i << ".example.com\n";
+			tenant << "session-timeout = " << j << "\n";
+			tenant << "debug=1\n";
+		}
+		text.push_back( tenant.str() );
+	}
+
+	config_batch_c batch( schema, threads );
+	for ( std::size_t i(0); i<text.size(); ++i ) {
+		batch.add_buffer( "tenant", text[i].data()
+				, text[i].data() + text[i].size() );
+	}
+	for ( int i(0); i<iterations; ++i ) {
+		bench::keep( batch.parse() );
+	}
+}
+
+STDOPT_BENCH( batch_parse_1_thread, 100 )
+{
+	parse_batch( 1, iterations );
+}
+
+STDOPT_BENCH( batch_parse_2_threads, 100 )
+{
+	parse_batch( 2, iterations );
+}
+
+STDOPT_BENCH( batch_parse_4_threads, 100 )
+{
+	parse_batch( 4, iterations );
+}
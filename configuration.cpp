@@ -14,68 +14,396 @@
  */
 
 #include "stdopt/configuration.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <ostream>
 
 using namespace stdopt;
 
 
+STDOPT_INLINE
 configuration_c::configuration_c()
-: m_option()
+: m_index()
+, m_patterns()
+, m_pattern_callback()
+, m_option()
+, m_observer()
+, m_snapshot()
+, m_snapshot_bytes()
+, m_value_buffer()
+, m_captures()
+, m_update( 0 )
+, m_update_depth( 0 )
+, m_reloading( false )
+, m_keep_parsing( false )
+, m_error( false )
+{}
+
+STDOPT_INLINE
+configuration_c::configuration_c( std::pmr::memory_resource *resource )
+: m_index( resource )
+, m_patterns()
+, m_pattern_callback()
+, m_option( resource )
+, m_observer()
+, m_snapshot()
+, m_snapshot_bytes()
+, m_value_buffer()
+, m_captures()
+, m_update( 0 )
+, m_update_depth( 0 )
+, m_reloading( false )
+, m_keep_parsing( false )
 , m_error( false )
 {}
 
 
-void configuration_c::add( config_option_i &option )
+STDOPT_INLINE
+int configuration_c::add_record( const option_record_c &record )
 {
-	m_option[ option.option_name() ] = &option;
+	int id( m_index.insert( record.option_name() ) );
+	if ( id == int( m_option.size() ) ) {
+		option_slot slot = { record, 0, false };
+		m_option.push_back( slot );
+	} else {
+		m_option[ id ].record = record;
+	}
+	return id;
 }
 
-void configuration_c::parse( std::istream &input )
+STDOPT_INLINE
+int configuration_c::add_pattern( std::string_view pattern
+		, const pattern_callback &callback )
+{
+	int id( m_patterns.insert( pattern ) );
+	if ( id == int( m_pattern_callback.size() ) ) {
+		m_pattern_callback.push_back( callback );
+	} else {
+		m_pattern_callback[ id ] = callback;
+	}
+	return id;
+}
+
+STDOPT_INLINE
+void configuration_c::reserve_values( const char *begin, const char *end )
+{
+	std::vector< int > count( m_option.size(), 0 );
+	config_scanner_c scanner( begin, end );
+	std::string_view key;
+	std::string_view value;
+	while ( scanner.next( key, value ) ) {
+		int id( m_index.find( key ) );
+		if ( id >= 0 ) {
+			++count[ id ];
+		}
+	}
+	for ( std::size_t id(0); id<count.size(); ++id ) {
+		if ( count[ id ] > 1 ) {
+			option( id ).reserve_values( count[ id ] );
+		}
+	}
+}
+
+STDOPT_INLINE
+option_memory_c configuration_c::memory() const
 {
-	std::string line;
-	std::string key_chunk;
-	std::string value_chunk;
-	std::string key;
-	std::string value;
+	option_memory_c bytes( table_memory() );
+	for ( std::size_t i(0); i<m_option.size(); ++i ) {
+		bytes += memory( i );
+	}
+	return bytes;
+}
 
-	while ( ! input.eof() ) {
-		// reset these for the next line
-		line.clear();
-		key_chunk.clear();
-		value_chunk.clear();
-		key.clear();
-		value.clear();
+STDOPT_INLINE
+option_memory_c configuration_c::table_memory() const
+{
+	option_memory_c bytes;
+	bytes.inline_bytes = sizeof( *this );
+	bytes.heap_bytes = m_index.heap_bytes() + m_patterns.heap_bytes()
+		+ m_pattern_callback.capacity() * sizeof( pattern_callback )
+		+ m_option.capacity() * sizeof( option_slot )
+		+ m_observer.capacity() * sizeof( observer )
+		+ m_snapshot.capacity() * sizeof( snapshot )
+		+ value_footprint_c< std::string >::heap_bytes( m_snapshot_bytes )
+		+ value_footprint_c< std::string >::heap_bytes( m_value_buffer )
+		+ m_captures.capacity() * sizeof( std::string_view );
+	for ( std::size_t i(0); i<m_observer.size(); ++i ) {
+		bytes.heap_bytes += m_observer[ i ].ids.capacity() * sizeof( int );
+	}
+	return bytes;
+}
 
-		// separate the line into chunks broken by the first '='
-		getline( input, line );
-		std::istringstream line_parser( line );
+STDOPT_INLINE
+void configuration_c::write_memory( std::ostream &out
+		, std::string_view prefix ) const
+{
+	std::string metric( prefix );
+	metric += "_option_bytes";
+	std::string text;
+	option_memory_c total( table_memory() );
+	for ( std::size_t i(0); i<m_option.size(); ++i ) {
+		option_memory_c bytes( memory( i ) );
+		bytes.append_metrics( text, metric
+				, m_option[ i ].record.option_name() );
+		total += bytes;
+	}
+	metric.assign( prefix.data(), prefix.size() );
+	metric += "_bytes";
+	total.append_metrics( text, metric, std::string_view() );
+	out.write( text.data(), text.size() );
+}
 
-		getline( line_parser, key_chunk, '=' );
-		getline( line_parser, value_chunk );
+STDOPT_INLINE
+void configuration_c::observe( const change_callback &callback )
+{
+	observe( std::vector< int >(), callback );
+}
 
-		// parse the key and values out of the chunks
-		std::istringstream key_parser( key_chunk );
-		std::istringstream value_parser( value_chunk );
+STDOPT_INLINE
+void configuration_c::observe( const std::vector< int > &ids
+		, const change_callback &callback )
+{
+	observer obs;
+	obs.ids = ids;
+	std::sort( obs.ids.begin(), obs.ids.end() );
+	obs.callback = callback;
+	m_observer.push_back( obs );
+}
 
-		key_parser >> key;
-		value_parser >> value;
+STDOPT_INLINE
+void configuration_c::begin_update()
+{
+	if ( m_update_depth++ == 0 ) {
+		++m_update;
+	}
+}
 
-		if ( ! ( key.empty() || value.empty() ) ) {
-			option_map::iterator it( m_option.find( key ) );
+STDOPT_INLINE
+void configuration_c::end_update()
+{
+	if ( --m_update_depth > 0 ) {
+		return;
+	}
 
-			if ( it == m_option.end() ) {
-				// std::cerr << "error";
-				return;
-			}
-			if ( value[ value.length() - 1 ] == '\r' ) {
-				value.erase( value.length() - 1 );
+	if ( m_reloading ) {
+		// options that were dropped from the configuration
+		for ( std::size_t id(0); id<m_option.size(); ++id ) {
+			if ( m_option[ id ].loaded
+					&& m_option[ id ].touched_update != m_update ) {
+				touch( id );
 			}
+		}
+		m_reloading = false;
+	}
+
+	for ( std::size_t id(0); id<m_option.size(); ++id ) {
+		option_slot &slot( m_option[ id ] );
+		if ( slot.touched_update == m_update ) {
+			slot.loaded = option( id ).source() == CONFIG_SOURCE;
+		}
+	}
+
+	std::vector< int > changed;
+	for ( std::size_t i(0); i<m_snapshot.size(); ++i ) {
+		if ( ! snapshot_equals( m_snapshot[ i ] ) ) {
+			changed.push_back( m_snapshot[ i ].id );
+		}
+	}
+	m_snapshot.clear();
+	m_snapshot_bytes.clear();
+	notify( changed );
+}
+
+STDOPT_INLINE
+void configuration_c::parse( std::istream &input )
+{
+	std::pmr::string text( resource() );
+	read_text( input, text );
+	parse( text.data(), text.data() + text.size() );
+}
 
-			it->second->parse_value( value );
-			if ( it->second->error() ) {
+STDOPT_INLINE
+bool configuration_c::parse( const char *begin, const char *end )
+{
+	config_scanner_c scanner( begin, end );
+	return parse( scanner );
+}
+
+STDOPT_INLINE
+bool configuration_c::parse( config_tokenizer_i &scanner )
+{
+	begin_update();
+	bool ok( parse_tokens( scanner ) );
+	end_update();
+	return ok;
+}
+
+STDOPT_INLINE
+void configuration_c::reload( std::istream &input )
+{
+	std::pmr::string text( resource() );
+	read_text( input, text );
+	reload( text.data(), text.data() + text.size() );
+}
+
+STDOPT_INLINE
+bool configuration_c::reload( const char *begin, const char *end )
+{
+	begin_update();
+	m_reloading = true;
+	m_error = false;
+	config_scanner_c scanner( begin, end );
+	bool ok( parse_tokens( scanner ) );
+	end_update();
+	return ok;
+}
+
+STDOPT_INLINE
+bool configuration_c::parse_tokens( config_tokenizer_i &scanner )
+{
+	std::string_view key;
+	std::string_view value;
+	bool ok( true );
+
+	STDOPT_EVENT_START( config_parse, parse_timer, key, 0 );
+	while ( ok && scanner.next( key, value ) ) {
+		int id( m_index.find( key ) );
+		if ( id < 0 ) {
+			int pattern( m_pattern_callback.empty() ? -1
+					: m_patterns.match( key, m_captures ) );
+			if ( pattern < 0 ) {
+				// std::cerr << "error";
+				ok = false;
+				break;
+			}
+			m_value_buffer.assign( value.data(), value.size() );
+			if ( ! m_pattern_callback[ pattern ]( m_captures
+						, m_value_buffer ) ) {
 				m_error = true;
-				return;
+				ok = false;
 			}
+			continue;
+		}
+
+		STDOPT_EVENT_START( config_line, line_timer, key, value.size() );
+		touch( id );
+		m_value_buffer.assign( value.data(), value.size() );
+		if ( ! m_option[ id ].record.merge_value( m_value_buffer
+					, CONFIG_SOURCE )
+				&& ! m_keep_parsing ) {
+			m_error = true;
+			ok = false;
 		}
+		STDOPT_EVENT_END( config_line, line_timer, key, value.size() );
 	}
+	if ( ok && scanner.error() ) {
+		m_error = true;
+		ok = false;
+	}
+	// the size of a whole parse is its number of lines
+	STDOPT_EVENT_END( config_parse, parse_timer, std::string_view()
+			, scanner.line() );
+	return ok;
 }
 
+STDOPT_INLINE
+void configuration_c::touch( int id )
+{
+	if ( m_option[ id ].touched_update == m_update ) {
+		return;
+	}
+	m_option[ id ].touched_update = m_update;
+
+	// only observers need to know what the option was before
+	if ( ! m_observer.empty() ) {
+		snapshot snap;
+		snap.id = id;
+		snap.begin = m_snapshot_bytes.size();
+		snap.encoded = encode_option( id, m_snapshot_bytes );
+		snap.end = m_snapshot_bytes.size();
+		m_snapshot.push_back( snap );
+	}
+
+	if ( m_reloading ) {
+		option( id ).clear_source( CONFIG_SOURCE );
+	}
+}
+
+STDOPT_INLINE
+bool configuration_c::encode_option( int id, std::string &bytes ) const
+{
+	const config_option_i &opt( option( id ) );
+	bytes += opt.error() ? 'e' : 'v';
+	int count( opt.size() );
+	bytes.append( reinterpret_cast< const char * >( &count )
+			, sizeof( count ) );
+	for ( int i(0); i<count; ++i ) {
+		// a placeholder for the size of the value
+		std::size_t size_pos( bytes.size() );
+		bytes.append( sizeof( std::size_t ), '\0' );
+		if ( ! opt.encode_value( i, bytes ) ) {
+			return false;
+		}
+		std::size_t size( bytes.size() - size_pos - sizeof( size ) );
+		memcpy( &bytes[ size_pos ], &size, sizeof( size ) );
+	}
+	return true;
+}
+
+STDOPT_INLINE
+bool configuration_c::snapshot_equals( const snapshot &snap ) const
+{
+	if ( ! snap.encoded ) {
+		return false;
+	}
+	const config_option_i &opt( option( snap.id ) );
+	std::string_view bytes( m_snapshot_bytes.data() + snap.begin
+			, snap.end - snap.begin );
+	int count;
+	if ( bytes.size() < 1 + sizeof( count )
+			|| bytes[ 0 ] != ( opt.error() ? 'e' : 'v' ) ) {
+		return false;
+	}
+	memcpy( &count, bytes.data() + 1, sizeof( count ) );
+	if ( count != opt.size() ) {
+		return false;
+	}
+	bytes.remove_prefix( 1 + sizeof( count ) );
+	for ( int i(0); i<count; ++i ) {
+		std::size_t size;
+		memcpy( &size, bytes.data(), sizeof( size ) );
+		bytes.remove_prefix( sizeof( size ) );
+		// compare through the option so padding bytes don't count
+		if ( ! opt.value_equals( i, bytes.substr( 0, size ) ) ) {
+			return false;
+		}
+		bytes.remove_prefix( size );
+	}
+	return true;
+}
+
+STDOPT_INLINE
+void configuration_c::notify( std::vector< int > &changed ) const
+{
+	if ( changed.empty() ) {
+		return;
+	}
+	std::sort( changed.begin(), changed.end() );
+
+	std::vector< int > watched;
+	for ( std::size_t i(0); i<m_observer.size(); ++i ) {
+		const observer &obs( m_observer[ i ] );
+		if ( obs.ids.empty() ) {
+			obs.callback( changed );
+			continue;
+		}
+		watched.clear();
+		std::set_intersection( changed.begin(), changed.end()
+				, obs.ids.begin(), obs.ids.end()
+				, std::back_inserter( watched ) );
+		if ( ! watched.empty() ) {
+			obs.callback( watched );
+		}
+	}
+}
@@ -0,0 +1,170 @@
+#ifndef STDOPT_BATCH_H
+#define STDOPT_BATCH_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/schema.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace stdopt {
+
+
+/**
+ * The result of parsing one file or buffer in a config_batch_c.
+ */
+class batch_result_c
+{
+	friend class config_batch_c;
+
+public:
+	batch_result_c( const config_schema_c &, const std::string &name
+			, const char *begin, const char *end );
+
+	/**
+	 * Get the path of the file or the name given for the buffer.
+	 */
+	const std::string & name() const { return m_name; }
+
+	/**
+	 * Get the values parsed from the file or buffer.
+	 */
+	const config_values_c & values() const { return m_values; }
+
+	/**
+	 * Check if the file couldn't be read or didn't parse.
+	 */
+	bool error() const { return m_values.error(); }
+
+	/**
+	 * Get the problems found reading and parsing the file.
+	 */
+	const std::vector< config_diagnostic_c > & diagnostics() const
+	{
+		return m_values.diagnostics();
+	}
+
+private:
+	std::string m_name;
+	const char *m_begin;
+	const char *m_end;
+	config_values_c m_values;
+};
+
+
+/**
+ * Parses many configuration files or buffers against one shared schema
+ * on a pool of threads.  The batch owns its worker threads, which are
+ * started by the first parse() and kept until the batch is destroyed,
+ * so parsing the batch again doesn't start new threads.  The calling
+ * thread is one of the workers.  Workers claim the next item with an
+ * atomic counter, so a slow file doesn't hold up the others and there
+ * are no locks on the parsing path.  Each result is only written by
+ * the worker that claimed it.
+ *
+ * One thread at a time may add to and parse a batch.
+ */
+class config_batch_c
+{
+public:
+	/**
+	 * Construct a batch for the given schema.  With 0 threads it uses
+	 * one per hardware thread.
+	 */
+	explicit config_batch_c( const config_schema_c &, int threads = 0 );
+
+	/**
+	 * Stop and join the worker threads.
+	 */
+	~config_batch_c();
+
+	/**
+	 * Add a file to parse.
+	 */
+	void add_file( const std::string &path );
+
+	/**
+	 * Add a buffer to parse.  The buffer isn't copied and must stay
+	 * valid until parse() returns.
+	 */
+	void add_buffer( const std::string &name, const char *begin
+			, const char *end );
+
+	/**
+	 * Parse everything that was added and wait for it to finish.
+	 * Parsing again rereads every file and buffer, replacing the
+	 * earlier results.
+	 * @return true if everything was read and parsed successfully
+	 */
+	bool parse();
+
+	/**
+	 * Get the number of files and buffers in the batch.
+	 */
+	int size() const { return m_result.size(); }
+
+	/**
+	 * Get the number of threads that parse the batch, including the
+	 * calling thread.
+	 */
+	int threads() const { return m_threads; }
+
+	/**
+	 * Get the result for the ith file or buffer added.
+	 */
+	const batch_result_c & result( int i ) const { return m_result[ i ]; }
+
+private:
+	config_batch_c( const config_batch_c & );
+	config_batch_c & operator = ( const config_batch_c & );
+
+	/**
+	 * Wait for each parse() and help claim its items until told to
+	 * stop.
+	 */
+	void run_worker();
+
+	/**
+	 * Claim and parse items until there are none left in this round.
+	 */
+	void claim_items( std::string &buffer );
+	void parse_item( batch_result_c &, std::string &buffer ) const;
+
+	const config_schema_c &m_schema;
+	std::vector< batch_result_c > m_result;
+	int m_threads;
+
+	std::vector< std::thread > m_worker;
+	// guards m_round, m_busy and m_stop
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+	uint64_t m_round;
+	int m_busy;
+	bool m_stop;
+	std::atomic< std::size_t > m_next;
+	// the calling thread's read buffer, the workers each keep their own
+	std::string m_buffer;
+};
+
+
+} // end namespace
+
+#endif
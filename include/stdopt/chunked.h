@@ -0,0 +1,269 @@
+#ifndef STDOPT_CHUNKED_H
+#define STDOPT_CHUNKED_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace stdopt {
+
+
+/**
+ * A list of values stored in fixed size chunks.  Growing only
+ * allocates another chunk, so values are never copied or moved once
+ * they're stored and the memory never spikes to twice the values the
+ * way a vector's does while it grows.  The chunk size is rounded up to
+ * a power of 2.
+ */
+template < typename T, typename Alloc = std::allocator< T > >
+class chunked_list_c
+{
+	typedef std::allocator_traits< Alloc > alloc_traits;
+	typedef typename alloc_traits::template rebind_alloc< T * > table_alloc;
+
+public:
+	explicit chunked_list_c( std::size_t chunk_size
+			, const Alloc &alloc = Alloc() )
+	: m_alloc( alloc )
+	, m_chunk( table_alloc( alloc ) )
+	, m_shift( 0 )
+	, m_size( 0 )
+	{
+		while ( ( std::size_t( 1 ) << m_shift ) < chunk_size ) {
+			++m_shift;
+		}
+	}
+
+	chunked_list_c( const chunked_list_c &list )
+	: m_alloc( alloc_traits::select_on_container_copy_construction(
+				list.m_alloc ) )
+	, m_chunk( table_alloc( m_alloc ) )
+	, m_shift( list.m_shift )
+	, m_size( 0 )
+	{
+		reserve( list.m_size );
+		for ( std::size_t i(0); i<list.m_size; ++i ) {
+			push_back( list[ i ] );
+		}
+	}
+
+	~chunked_list_c()
+	{
+		clear();
+		for ( std::size_t i(0); i<m_chunk.size(); ++i ) {
+			alloc_traits::deallocate( m_alloc, m_chunk[ i ]
+					, chunk_size() );
+		}
+	}
+
+	Alloc get_allocator() const { return m_alloc; }
+
+	std::size_t chunk_size() const { return std::size_t( 1 ) << m_shift; }
+	std::size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	/**
+	 * Get the bytes allocated for the chunks and the chunk table.
+	 */
+	std::size_t heap_bytes() const
+	{
+		return m_chunk.size() * chunk_size() * sizeof( T )
+			+ m_chunk.capacity() * sizeof( T * );
+	}
+
+	const T & operator [] ( std::size_t i ) const
+	{
+		return m_chunk[ i >> m_shift ][ i & ( chunk_size() - 1 ) ];
+	}
+	const T & front() const { return ( *this )[ 0 ]; }
+	const T & back() const { return ( *this )[ m_size - 1 ]; }
+
+	/**
+	 * Allocate the chunks for count values up front.
+	 */
+	void reserve( std::size_t count )
+	{
+		std::size_t chunks( ( count + chunk_size() - 1 ) >> m_shift );
+		m_chunk.reserve( chunks );
+		while ( m_chunk.size() < chunks ) {
+			m_chunk.push_back( alloc_traits::allocate( m_alloc
+						, chunk_size() ) );
+		}
+	}
+
+	void push_back( const T &value )
+	{
+		alloc_traits::construct( m_alloc, next_slot(), value );
+		++m_size;
+	}
+
+	void push_back( T &&value )
+	{
+		alloc_traits::construct( m_alloc, next_slot(), std::move( value ) );
+		++m_size;
+	}
+
+	/**
+	 * Destroy the values.  The chunks are kept to be filled again.
+	 */
+	void clear()
+	{
+		for ( std::size_t i(0); i<m_size; ++i ) {
+			alloc_traits::destroy( m_alloc, &slot( i ) );
+		}
+		m_size = 0;
+	}
+
+private:
+	chunked_list_c & operator = ( const chunked_list_c & );
+
+	T & slot( std::size_t i )
+	{
+		return m_chunk[ i >> m_shift ][ i & ( chunk_size() - 1 ) ];
+	}
+
+	T * next_slot()
+	{
+		if ( ( m_size >> m_shift ) == m_chunk.size() ) {
+			m_chunk.push_back( alloc_traits::allocate( m_alloc
+						, chunk_size() ) );
+		}
+		return &slot( m_size );
+	}
+
+	Alloc m_alloc;
+	std::vector< T *, table_alloc > m_chunk;
+	unsigned m_shift;
+	std::size_t m_size;
+};
+
+
+/**
+ * A read-only random access iterator over anything with a value( int )
+ * accessor, so the iterator doesn't depend on how the values are
+ * stored.  Reference is what value( int ) returns.  Owners that return
+ * values rather than references, like std::vector< bool >, can't be
+ * dereferenced with ->.
+ */
+template < typename Owner, typename T, typename Reference = const T & >
+class value_iterator_c
+{
+public:
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef T value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef const T * pointer;
+	typedef Reference reference;
+
+	value_iterator_c()
+	: m_owner( NULL )
+	, m_index( 0 )
+	{}
+
+	value_iterator_c( const Owner *owner, difference_type index )
+	: m_owner( owner )
+	, m_index( index )
+	{}
+
+	reference operator * () const { return m_owner->value( m_index ); }
+
+	template < typename R = Reference >
+	typename std::enable_if< std::is_reference< R >::value, pointer >::type
+	operator -> () const
+	{
+		return &m_owner->value( m_index );
+	}
+	reference operator [] ( difference_type n ) const
+	{
+		return m_owner->value( m_index + n );
+	}
+
+	value_iterator_c & operator ++ () { ++m_index; return *this; }
+	value_iterator_c & operator -- () { --m_index; return *this; }
+	value_iterator_c operator ++ ( int )
+	{
+		value_iterator_c it( *this );
+		++m_index;
+		return it;
+	}
+	value_iterator_c operator -- ( int )
+	{
+		value_iterator_c it( *this );
+		--m_index;
+		return it;
+	}
+
+	value_iterator_c & operator += ( difference_type n )
+	{
+		m_index += n;
+		return *this;
+	}
+	value_iterator_c & operator -= ( difference_type n )
+	{
+		m_index -= n;
+		return *this;
+	}
+	value_iterator_c operator + ( difference_type n ) const
+	{
+		return value_iterator_c( m_owner, m_index + n );
+	}
+	value_iterator_c operator - ( difference_type n ) const
+	{
+		return value_iterator_c( m_owner, m_index - n );
+	}
+	difference_type operator - ( const value_iterator_c &it ) const
+	{
+		return m_index - it.m_index;
+	}
+
+	bool operator == ( const value_iterator_c &it ) const
+	{
+		return m_index == it.m_index;
+	}
+	bool operator != ( const value_iterator_c &it ) const
+	{
+		return m_index != it.m_index;
+	}
+	bool operator < ( const value_iterator_c &it ) const
+	{
+		return m_index < it.m_index;
+	}
+	bool operator > ( const value_iterator_c &it ) const
+	{
+		return m_index > it.m_index;
+	}
+	bool operator <= ( const value_iterator_c &it ) const
+	{
+		return m_index <= it.m_index;
+	}
+	bool operator >= ( const value_iterator_c &it ) const
+	{
+		return m_index >= it.m_index;
+	}
+
+private:
+	const Owner *m_owner;
+	difference_type m_index;
+};
+
+
+} // end namespace
+
+#endif
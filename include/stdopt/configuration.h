@@ -15,8 +15,15 @@
  * limitations under the License.
  */
 
+#include "key_index.h"
 #include "option.h"
-#include <map>
+#include "pattern.h"
+#include "scanner.h"
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace stdopt {
 
@@ -24,9 +31,9 @@ namespace stdopt {
 /**
  * An option to be set in the configuration file.
  */
-template < typename T >
+template < typename T, typename Alloc = std::allocator< T > >
 class config_option_c
-: public option_value_c< T >
+: public option_value_c< T, Alloc >
 , virtual public config_option_i
 {
 public:
@@ -34,11 +41,10 @@ public:
 	 * Construct the config option.  The name is the key in the
 	 * configuration file.
 	 */
-	config_option_c( const std::string &name, const std::string &desc )
-	: option_value_c< T >()
-	, m_option_name( name )
-	, m_description( desc )
-	, m_config_required( false )
+	config_option_c( const std::string &name, const std::string &desc
+			, const Alloc &alloc = Alloc() )
+	: option_value_c< T, Alloc >( alloc )
+	, m_descriptor( 0, name, desc )
 	{}
 
 	/**
@@ -46,11 +52,30 @@ public:
 	 * is the key in the configuration file.
 	 */
 	config_option_c( const T &default_value, const std::string &name
-			, const std::string &desc )
-	: option_value_c< T >( default_value )
-	, m_option_name( name )
-	, m_description( desc )
-	, m_config_required( false )
+			, const std::string &desc, const Alloc &alloc = Alloc() )
+	: option_value_c< T, Alloc >( default_value, alloc )
+	, m_descriptor( 0, name, desc )
+	{}
+
+	/**
+	 * Construct the config option from a descriptor that outlives it,
+	 * usually a static constexpr one.
+	 */
+	explicit config_option_c( const option_descriptor_c &descriptor
+			, const Alloc &alloc = Alloc() )
+	: option_value_c< T, Alloc >( alloc )
+	, m_descriptor( descriptor )
+	{}
+
+	/**
+	 * Construct the config option with a default value from a
+	 * descriptor that outlives it.
+	 */
+	config_option_c( const T &default_value
+			, const option_descriptor_c &descriptor
+			, const Alloc &alloc = Alloc() )
+	: option_value_c< T, Alloc >( default_value, alloc )
+	, m_descriptor( descriptor )
 	{}
 
 	/**
@@ -58,7 +83,11 @@ public:
 	 */
 	virtual const std::string & option_name() const
 	{
-		return m_option_name;
+		return m_descriptor.name_string();
+	}
+	virtual std::string_view option_name_view() const
+	{
+		return m_descriptor.option_name();
 	}
 
 	/**
@@ -66,54 +95,333 @@ public:
 	 */
 	virtual const std::string & description() const
 	{
-		return m_description;
+		return m_descriptor.description_string();
+	}
+	virtual std::string_view description_view() const
+	{
+		return m_descriptor.description();
 	}
 
 	/**
 	 * Check if it's required that this value be set in the configuration.
 	 */
-	virtual bool config_required() const { return m_config_required; }
+	virtual bool config_required() const
+	{
+		return m_descriptor.config_required();
+	}
 
-private:
-	std::string m_option_name;
-	std::string m_description;
+	/**
+	 * Get the bytes held by the option, including its owned name and
+	 * description.
+	 */
+	virtual option_memory_c memory() const
+	{
+		option_memory_c bytes( option_value_c< T, Alloc >::memory() );
+		bytes.inline_bytes = sizeof( *this );
+		bytes.heap_bytes += m_descriptor.heap_bytes();
+		return bytes;
+	}
 
-	bool m_config_required;
+private:
+	descriptor_ref_c m_descriptor;
 };
 
+template < typename T, typename Alloc >
+class typed_option_traits_c< config_option_c< T, Alloc > >
+: public std::true_type
+{};
+
 
 /**
  * A parser class to get all the configurations from a file.
+ * Option names are interned into dense key ids when they're added,
+ * so parsing looks keys up straight from the input buffer and client
+ * code can keep an id to get at an option without any string work.
+ *
+ * Observers are told which options changed value after each parse or
+ * reload.  Only the options that were in the parsed text, or that were
+ * dropped from it on a reload, are compared.
  */
 class configuration_c
 {
-private:
-	typedef std::map< std::string, config_option_i * > option_map;
-
 public:
+	/**
+	 * Called with the ids of the options that changed, in order.
+	 */
+	typedef std::function< void ( const std::vector< int > & ) >
+		change_callback;
+
+	/**
+	 * Called with the segments a pattern's wildcards captured and the
+	 * value for a key that matched the pattern.
+	 * @return false if the value is an error
+	 */
+	typedef std::function< bool ( const std::vector< std::string_view > &
+			, const std::string & ) > pattern_callback;
+
 	/**
 	 * Construct the config parser for a given input
 	 * stream.
 	 */
 	configuration_c();
 
+	/**
+	 * Construct the config parser to allocate its option index from
+	 * the given memory resource.  Options don't pick it up on their
+	 * own; construct pmr options with resource() to keep their values
+	 * in it too.  Values are handed to options in a std::string and
+	 * pattern captures in a std::vector, since that's what option
+	 * parsers and pattern callbacks take, so those two buffers come
+	 * from the global heap.  They're kept between parses, so they
+	 * only allocate when a value or key is bigger than any before it.
+	 */
+	explicit configuration_c( std::pmr::memory_resource * );
+
+	/**
+	 * Get the memory resource the configuration allocates from.
+	 * Pass it to pmr options to keep their values in it as well.
+	 */
+	std::pmr::memory_resource * resource() const
+	{
+		return m_option.get_allocator().resource();
+	}
+
 	/**
 	 * Add an option that can be set in the configuration file.
+	 * Adding another option with the same name replaces the first
+	 * one and keeps its id.
+	 * @return the key id for the option name
+	 */
+	int add( config_option_i &option )
+	{
+		return add_record( option_record_c( option ) );
+	}
+
+	/**
+	 * Add one of this library's option classes.  Its values are
+	 * parsed without going through the virtual option interface.
+	 */
+	template < typename Option >
+	typename std::enable_if< typed_option_traits_c< Option >::value
+		&& std::is_base_of< config_option_i, Option >::value, int >::type
+	add( Option &option )
+	{
+		return add_record( option_record_c( option ) );
+	}
+
+	/**
+	 * Add a callback for the keys that match a pattern, like
+	 *   backend.<name>.weight
+	 * where a segment of * or <name> matches any one segment of the
+	 * key.  Keys only go to patterns when no option has that exact
+	 * name.  Adding the same pattern again replaces its callback.
+	 * @return the pattern id
+	 */
+	int add_pattern( std::string_view pattern
+			, const pattern_callback &callback );
+
+	/**
+	 * Count how many times each key is set in [begin, end) and pass
+	 * the counts on to the options as reserve_values() hints.  Only
+	 * keys are scanned and no values are parsed, so it's cheap next
+	 * to parse() on files that set some options very many times.
+	 */
+	void reserve_values( const char *begin, const char *end );
+
+	/**
+	 * Find the key id for an option name.
+	 * @return the id or -1 if no option has that name
 	 */
-	void add( config_option_i & );
+	int find( std::string_view name ) const { return m_index.find( name ); }
+
+	/**
+	 * Get the number of option names in the configuration.
+	 */
+	int size() const { return m_option.size(); }
+
+	/**
+	 * Get the option for a key id.
+	 */
+	config_option_i & option( int id ) const
+	{
+		return *m_option[ id ].record.config_option();
+	}
+
+	/**
+	 * Get the bytes held by the option for a key id.
+	 */
+	option_memory_c memory( int id ) const
+	{
+		return m_option[ id ].record.config_option()->memory();
+	}
+
+	/**
+	 * Get the bytes held by all the options, plus the configuration
+	 * object and its own tables.
+	 */
+	option_memory_c memory() const;
+
+	/**
+	 * Write the bytes held by each option and the totals in the
+	 * Prometheus text format, with metric names starting with prefix:
+	 *   stdopt_config_option_bytes{option="port",storage="inline"} 96
+	 *   stdopt_config_bytes{storage="heap"} 2048
+	 */
+	void write_memory( std::ostream &
+			, std::string_view prefix = "stdopt_config" ) const;
+
+	/**
+	 * Observe changes to every option.  Observers are called in the
+	 * order they were added, once at the end of each update that
+	 * changed something.  An observer added in the middle of an
+	 * update only hears about options first changed after it.
+	 */
+	void observe( const change_callback & );
+
+	/**
+	 * Observe changes to the options with the given ids.  The
+	 * observer is only called if one of them changed.
+	 */
+	void observe( const std::vector< int > &ids, const change_callback & );
+
+	/**
+	 * Start an update that spans several calls to parse(), so
+	 * observers only hear about it once.  Updates can be nested and
+	 * observers are called when the outermost one ends.
+	 */
+	void begin_update();
+
+	/**
+	 * End an update started with begin_update().
+	 */
+	void end_update();
 
 	/**
 	 * Parse the input from the given input stream.
 	 */
 	void parse( std::istream &input );
 
+	/**
+	 * Parse the configuration text in [begin, end).  Text can be
+	 * parsed in pieces as long as each piece ends at the end of a line.
+	 * @return false if parsing stopped at an unknown key or a bad value
+	 */
+	bool parse( const char *begin, const char *end );
+
+	/**
+	 * Parse the keys and values from a tokenizer, like a
+	 * json_scanner_c or toml_scanner_c.  A syntax error is an error
+	 * in the configuration.
+	 * @return false if parsing stopped at an unknown key, a bad value
+	 * or a syntax error
+	 */
+	bool parse( config_tokenizer_i & );
+
+	/**
+	 * Parse a new version of the configuration.  Values parsed from an
+	 * earlier configuration are replaced, and options that aren't in
+	 * the new one go back to their defaults.  Values from other
+	 * sources, like the command line, are kept.
+	 */
+	void reload( std::istream &input );
+
+	/**
+	 * Parse a new version of the configuration text in [begin, end).
+	 * @return false if parsing stopped at an unknown key or a bad value
+	 */
+	bool reload( const char *begin, const char *end );
+
 	/**
 	 * Check if there was an error parsing the configuration.
 	 */
 	bool error() const { return m_error; }
 
+	/**
+	 * Keep parsing past values that don't parse.  The error is left on
+	 * the option, where a value from a higher precedence source can
+	 * still replace it, and isn't an error in the configuration.
+	 */
+	void keep_parsing( bool keep ) { m_keep_parsing = keep; }
+
 private:
-	option_map m_option;
+	class observer
+	{
+	public:
+		// sorted ids to watch, empty for all of them
+		std::vector< int > ids;
+		change_callback callback;
+	};
+
+	/**
+	 * An option's record with its state across updates, kept together
+	 * so adding an option only grows one table.
+	 */
+	class option_slot
+	{
+	public:
+		option_record_c record;
+		// the update the option was last touched in
+		unsigned touched_update;
+		// if the option has values from the configuration
+		bool loaded;
+	};
+
+	/**
+	 * The values of an option before it was first touched in
+	 * an update, encoded in m_snapshot.
+	 */
+	class snapshot
+	{
+	public:
+		int id;
+		std::size_t begin;
+		std::size_t end;
+		bool encoded;
+	};
+
+	bool parse_tokens( config_tokenizer_i & );
+
+	/**
+	 * Add an option's record under its name, replacing any option
+	 * already added with that name.
+	 * @return the key id of the option
+	 */
+	int add_record( const option_record_c & );
+	/**
+	 * Get the bytes held by the configuration object and its tables,
+	 * without the options.
+	 */
+	option_memory_c table_memory() const;
+
+	/**
+	 * Note that an option is about to change in the current update.
+	 */
+	void touch( int id );
+	bool encode_option( int id, std::string &bytes ) const;
+	/**
+	 * Check if an option still has the values in its snapshot.
+	 */
+	bool snapshot_equals( const snapshot & ) const;
+	void notify( std::vector< int > &changed ) const;
+
+	key_index_c m_index;
+	pattern_trie_c m_patterns;
+	// callbacks indexed by pattern id
+	std::vector< pattern_callback > m_pattern_callback;
+	// options indexed by key id
+	std::pmr::vector< option_slot > m_option;
+	// the update tracking for each option, indexed by key id
+	std::vector< observer > m_observer;
+	std::vector< snapshot > m_snapshot;
+	std::string m_snapshot_bytes;
+	// holds each value while it's parsed, reused between values
+	std::string m_value_buffer;
+	// the wildcard segments of the last pattern matched
+	std::vector< std::string_view > m_captures;
+	unsigned m_update;
+	int m_update_depth;
+	bool m_reloading;
+	bool m_keep_parsing;
 	bool m_error;
 };
 
@@ -0,0 +1,58 @@
+#ifndef STDOPT_CONSTRAINT_H
+#define STDOPT_CONSTRAINT_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/option.h>
+#include <memory>
+#include <regex>
+#include <string>
+
+namespace stdopt {
+
+
+/**
+ * A constraint that requires string values to match a regular
+ * expression.  The expression is compiled once, when the constraint
+ * is made, and shared by copies of the constraint.
+ *   host.constrain( pattern_constraint_c( "[a-z0-9.-]+" ) );
+ * This is kept out of option.h so the option headers don't need
+ * <regex>.
+ */
+class pattern_constraint_c
+{
+public:
+	explicit pattern_constraint_c( const std::string &pattern
+			, std::regex::flag_type flags = std::regex::ECMAScript )
+	: m_pattern( std::make_shared< const std::regex >( pattern, flags ) )
+	{}
+
+	/**
+	 * Check that the whole value matches the pattern.
+	 */
+	template < typename String >
+	bool operator () ( const String &value ) const
+	{
+		return std::regex_match( value.begin(), value.end(), *m_pattern );
+	}
+
+private:
+	std::shared_ptr< const std::regex > m_pattern;
+};
+
+
+} // end namespace
+
+#endif
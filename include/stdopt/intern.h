@@ -0,0 +1,225 @@
+#ifndef STDOPT_INTERN_H
+#define STDOPT_INTERN_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/key_index.h>
+#include <stdopt/option.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stdopt {
+
+class string_pool_c;
+
+
+/**
+ * A handle to a string stored once in a string_pool_c.  It's a view of
+ * the pool's copy, which stays put as long as the pool does, so
+ * handles from the same pool are equal only if they point at the same
+ * copy and comparing them is a pointer comparison.  A default handle
+ * is the empty string in the global pool.
+ */
+class interned_string_c
+{
+public:
+	interned_string_c();
+
+	/**
+	 * Get the empty string in a pool.  Give it to an option as its
+	 * default to have the option intern its values in that pool.
+	 */
+	explicit interned_string_c( string_pool_c &pool );
+
+	std::string_view view() const
+	{
+		return std::string_view( m_data, m_size );
+	}
+	operator std::string_view () const { return view(); }
+	const char * data() const { return m_data; }
+	std::size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	/**
+	 * Get the pool the string is in.
+	 */
+	string_pool_c & pool() const;
+
+	bool operator == ( const interned_string_c &s ) const
+	{
+		return m_data == s.m_data;
+	}
+	bool operator != ( const interned_string_c &s ) const
+	{
+		return m_data != s.m_data;
+	}
+	/**
+	 * Order by the characters, for sorting and range constraints.
+	 */
+	bool operator < ( const interned_string_c &s ) const
+	{
+		return view() < s.view();
+	}
+
+private:
+	friend class string_pool_c;
+
+	interned_string_c( string_pool_c *pool, const char *data
+			, std::size_t size )
+	: m_pool( pool )
+	, m_data( data )
+	, m_size( size )
+	{}
+
+	string_pool_c *m_pool;
+	const char *m_data;
+	std::size_t m_size;
+};
+
+
+/**
+ * Stores each distinct string once.  Strings are hashed as they're
+ * interned and the copies are kept in blocks that never move, so the
+ * handles stay valid for the life of the pool.  Nothing is removed
+ * until the pool is destroyed.  Interning locks the pool, so one pool
+ * can be shared by configurations parsed on different threads.
+ *   string_pool_c hosts;
+ *   config_option_c< interned_string_c > upstream(
+ *       interned_string_c( hosts ), "upstream", "Upstream host." );
+ */
+class string_pool_c
+{
+public:
+	/**
+	 * Construct an empty pool that copies strings into blocks of
+	 * block_size characters.  Longer strings get a block to
+	 * themselves.
+	 */
+	explicit string_pool_c( std::size_t block_size = 4096 );
+
+	/**
+	 * The characters every empty handle points at, so all empty
+	 * strings are equal.
+	 */
+	static constexpr char EMPTY[ 1 ] = { 0 };
+
+	/**
+	 * Get the pool options intern their values in when they don't
+	 * have a default from another pool.
+	 */
+	static string_pool_c & global();
+
+	/**
+	 * Get the handle for a string, copying it into the pool if it
+	 * isn't there yet.
+	 */
+	interned_string_c intern( std::string_view str );
+
+	/**
+	 * Get the number of distinct strings in the pool.
+	 */
+	std::size_t size() const;
+
+	/**
+	 * Get the bytes allocated for the copies and the hash table.
+	 */
+	std::size_t heap_bytes() const;
+
+private:
+	string_pool_c( const string_pool_c & );
+	string_pool_c & operator = ( const string_pool_c & );
+
+	class entry
+	{
+	public:
+		const char *data;
+		std::size_t size;
+		uint64_t hash;
+	};
+
+	const char * copy( std::string_view str );
+	void rehash( std::size_t slots );
+
+	mutable std::mutex m_mutex;
+	std::vector< entry > m_entry;
+	// entry indexes, -1 for an empty slot
+	std::vector< int > m_slot;
+	std::vector< std::unique_ptr< char[] > > m_block;
+	std::size_t m_block_size;
+	std::size_t m_block_used;
+	std::size_t m_block_bytes;
+};
+
+
+/**
+ * Interns the value in the pool of the value it's parsed over, which
+ * is the option's default.
+ */
+template <>
+class value_parser_c< interned_string_c >
+{
+public:
+	static bool parse( const std::string &str_value
+			, interned_string_c &value );
+};
+
+/**
+ * Copy the characters, not the handle.
+ */
+template <>
+class value_codec_c< interned_string_c, true >
+{
+public:
+	static bool encode( const interned_string_c &value, std::string &bytes )
+	{
+		bytes.append( value.data(), value.size() );
+		return true;
+	}
+
+	static bool equal( const interned_string_c &value
+			, std::string_view bytes )
+	{
+		return value.view() == bytes;
+	}
+};
+
+std::ostream & operator << ( std::ostream &, const interned_string_c & );
+
+
+} // end namespace
+
+namespace std {
+
+/**
+ * Hash the handle, not the characters.
+ */
+template <>
+struct hash< stdopt::interned_string_c >
+{
+	std::size_t operator () ( const stdopt::interned_string_c &s ) const
+	{
+		return std::hash< const char * >()( s.data() );
+	}
+};
+
+} // end namespace
+
+#endif
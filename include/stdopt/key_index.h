@@ -0,0 +1,103 @@
+#ifndef STDOPT_KEY_INDEX_H
+#define STDOPT_KEY_INDEX_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "option.h"
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stdopt {
+
+
+/**
+ * Interns keys into dense ids, starting at 0 in the order they were
+ * inserted.  Lookups hash the key span directly, so a key can be
+ * found straight from an input buffer without building a string.
+ * The table uses open addressing with linear probing and is kept at
+ * most half full.
+ */
+class key_index_c
+{
+public:
+	/**
+	 * Construct an empty index.
+	 */
+	key_index_c();
+
+	/**
+	 * Construct an empty index that allocates from the given memory
+	 * resource.
+	 */
+	explicit key_index_c( std::pmr::memory_resource * );
+
+	/**
+	 * Insert a key.  The key is copied into the index.
+	 * @return the id for the key, the existing one if it was already
+	 * inserted
+	 */
+	int insert( std::string_view key );
+
+	/**
+	 * Find the id for a key.
+	 * @return the id or -1 if the key isn't in the index
+	 */
+	int find( std::string_view key ) const;
+
+	/**
+	 * Get the number of keys in the index.
+	 */
+	int size() const { return m_key.size(); }
+
+	/**
+	 * Get the key for an id.
+	 */
+	std::string_view key( int id ) const { return m_key[ id ]; }
+
+	/**
+	 * Get the bytes allocated for the keys and the slot table.
+	 */
+	std::size_t heap_bytes() const;
+
+	/**
+	 * Hash a key.  This is 64 bit FNV-1a.
+	 */
+	static uint64_t hash( std::string_view key );
+
+private:
+	/**
+	 * Find the slot for a key.  It's either the slot holding the
+	 * key or the empty slot where it should go.
+	 */
+	std::size_t find_slot( std::string_view key ) const;
+
+	/**
+	 * Rebuild the slot table with the given number of slots, which
+	 * must be a power of 2.
+	 */
+	void rehash( std::size_t slots );
+
+	std::pmr::vector< std::pmr::string > m_key;
+	// key ids, -1 for an empty slot
+	std::pmr::vector< int > m_slot;
+};
+
+
+} // end namespace
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef STDOPT_LOADER_H
+#define STDOPT_LOADER_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/configuration.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#if defined( __cpp_impl_coroutine ) && __has_include( <coroutine> )
+#include <coroutine>
+#define STDOPT_COROUTINES
+#endif
+
+namespace stdopt {
+
+
+/**
+ * Loads a configuration file in the background so the calling thread
+ * doesn't block on file I/O.  Loads run on a small pool of worker
+ * threads shared by every loader, which is started on first use and
+ * kept for the life of the program.  The worker queues the file's
+ * chunk reads on an io_uring so they overlap, or reads the chunks with
+ * pread where io_uring isn't available, and each run of complete lines
+ * is parsed as soon as the chunks holding it have been read.
+ *
+ * The configuration is filled on the worker, so leave it alone until
+ * the load has finished.  Its observers are called on the worker too,
+ * once for the whole file.  Callbacks shouldn't wait for other loads,
+ * since those may be queued behind them.
+ */
+class config_loader_c
+{
+public:
+	/**
+	 * Called when the load finishes with true if the file was read and
+	 * parsed without errors.
+	 */
+	typedef std::function< void ( bool ) > callback;
+
+	/**
+	 * Construct a loader to fill the configuration from the file
+	 * at path.  Nothing is read until start() is called.
+	 */
+	config_loader_c( configuration_c &, const std::string &path
+			, std::size_t chunk_size = 64 * 1024 );
+
+	/**
+	 * Wait for the load and its callback to finish.
+	 */
+	~config_loader_c();
+
+	/**
+	 * Choose whether io_uring may be used.  It's used by default when
+	 * the kernel supports it.
+	 */
+	void use_io_uring( bool use ) { m_use_io_uring = use; }
+
+	/**
+	 * Start loading.  The callback is called on the worker thread.
+	 * A loader only loads once.
+	 * @return false if the load was already started
+	 */
+	bool start( const callback & = callback() );
+
+	/**
+	 * Wait for the load to finish.
+	 * @return true if the file was read and parsed without errors,
+	 * false right away if the load was never started
+	 */
+	bool wait();
+
+	/**
+	 * Check if the load has finished.
+	 */
+	bool done() const;
+
+	/**
+	 * Check if the file couldn't be read.
+	 */
+	bool read_error() const { return m_read_error; }
+
+	/**
+	 * Check if the file was read with io_uring.  Only valid once the
+	 * load is done.
+	 */
+	bool used_io_uring() const { return m_used_io_uring; }
+
+#ifdef STDOPT_COROUTINES
+	/**
+	 * Awaits the load from a coroutine.  The coroutine is resumed on
+	 * the worker thread, so post it back to the event loop if that's
+	 * where it has to run.
+	 */
+	class awaiter_c
+	{
+	public:
+		explicit awaiter_c( config_loader_c &loader )
+		: m_loader( loader )
+		{}
+
+		bool await_ready() const { return false; }
+		/**
+		 * Start the load and suspend, or if it was already started
+		 * elsewhere wait for it and carry on without suspending.
+		 */
+		bool await_suspend( std::coroutine_handle<> handle )
+		{
+			if ( m_loader.start( [ handle ]( bool ) { handle.resume(); } ) ) {
+				return true;
+			}
+			m_loader.wait();
+			return false;
+		}
+		bool await_resume() const { return m_loader.m_ok; }
+
+	private:
+		config_loader_c &m_loader;
+	};
+
+	/**
+	 * Start loading and suspend until it's done.
+	 *   bool ok = co_await loader;
+	 */
+	awaiter_c operator co_await () { return awaiter_c( *this ); }
+#endif
+
+private:
+	config_loader_c( const config_loader_c & );
+	config_loader_c & operator = ( const config_loader_c & );
+
+	class worker_pool_c;
+
+	/**
+	 * Get the worker pool shared by every loader.
+	 */
+	static worker_pool_c & pool();
+
+	void run( callback );
+	bool read_io_uring( int fd );
+	bool read_pread( int fd );
+
+	/**
+	 * Parse the complete lines in the first ready bytes of the text
+	 * that haven't been parsed yet.  Parses everything that's left
+	 * at the end of the file.
+	 */
+	void parse_ready( std::size_t ready );
+
+	configuration_c &m_config;
+	std::string m_path;
+	std::size_t m_chunk_size;
+	std::string m_text;
+	std::size_t m_parsed;
+	bool m_parse_stopped;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_done_cond;
+	bool m_started;
+	bool m_done;
+	// set once the callback has returned
+	bool m_finished;
+	// the worker running the callback and the flag that tells it the
+	// callback destroyed the loader
+	std::thread::id m_callback_thread;
+	bool *m_destroyed;
+	bool m_ok;
+	bool m_read_error;
+	bool m_use_io_uring;
+	bool m_used_io_uring;
+};
+
+
+} // end namespace
+
+#endif
@@ -15,23 +15,283 @@
  * limitations under the License.
  */
 
+#include "chunked.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 #include <vector>
 
+/**
+ * Functions defined in the library sources are marked STDOPT_INLINE.
+ * When the amalgamated stdopt_single.h is included with
+ * STDOPT_HEADER_ONLY defined, they become inline so every translation
+ * unit can include the definitions and the compiler can inline them.
+ */
+#ifdef STDOPT_HEADER_ONLY
+#define STDOPT_INLINE inline
+#else
+#define STDOPT_INLINE
+#endif
+
 namespace stdopt {
 
 
+/**
+ * The sources an option value can come from, lowest precedence first.
+ */
+enum option_source : unsigned char
+{
+	DEFAULT_SOURCE,
+	CONFIG_SOURCE,
+	ENVIRONMENT_SOURCE,
+	ARGS_SOURCE
+};
+
+
+/**
+ * The bytes held by an option, or the sum over a set of options.
+ *   inline_bytes  the option object itself
+ *   value_bytes   the storage allocated for its values: vector
+ *                 capacity or chunks
+ *   heap_bytes    everything else it allocated: string buffers of its
+ *                 values, owned names and settings
+ */
+class option_memory_c
+{
+public:
+	option_memory_c()
+	: inline_bytes( 0 )
+	, value_bytes( 0 )
+	, heap_bytes( 0 )
+	, values( 0 )
+	{}
+
+	std::size_t total() const
+	{
+		return inline_bytes + value_bytes + heap_bytes;
+	}
+
+	option_memory_c & operator += ( const option_memory_c &memory )
+	{
+		inline_bytes += memory.inline_bytes;
+		value_bytes += memory.value_bytes;
+		heap_bytes += memory.heap_bytes;
+		values += memory.values;
+		return *this;
+	}
+
+	/**
+	 * Append the bytes as lines in the Prometheus text format:
+	 *   metric{option="port",storage="inline"} 96
+	 * with one line for each kind of storage.  The option label is
+	 * left out if option is empty.
+	 */
+	void append_metrics( std::string &text, std::string_view metric
+			, std::string_view option ) const;
+
+	std::size_t inline_bytes;
+	std::size_t value_bytes;
+	std::size_t heap_bytes;
+	// the number of values held
+	std::size_t values;
+};
+
+
+/**
+ * Counts the heap bytes a value of type T holds outside of its own
+ * object.  Strings count their buffer unless it fits inside the
+ * string.  Specialize this class for other types that allocate, with
+ * allocates set so their values are counted as they're stored.
+ */
+template < typename T >
+class value_footprint_c
+{
+public:
+	static constexpr bool allocates = false;
+	static std::size_t heap_bytes( const T & ) { return 0; }
+};
+
+template < typename Traits, typename Alloc >
+class value_footprint_c< std::basic_string< char, Traits, Alloc > >
+{
+public:
+	static constexpr bool allocates = true;
+	static std::size_t heap_bytes(
+			const std::basic_string< char, Traits, Alloc > &value )
+	{
+		const char *object( reinterpret_cast< const char * >( &value ) );
+		std::less< const char * > before;
+		if ( ! before( value.data(), object )
+				&& before( value.data(), object + sizeof( value ) ) ) {
+			return 0;
+		}
+		return value.capacity() + 1;
+	}
+};
+
+
+/**
+ * The running count of heap bytes held by an option's values, so
+ * reporting it doesn't walk them.  It's empty for types that don't
+ * allocate.
+ */
+template < bool Allocates >
+class value_heap_count_c
+{
+public:
+	value_heap_count_c()
+	: m_value_heap( 0 )
+	{}
+
+	std::size_t value_heap() const { return m_value_heap; }
+	void add_value_heap( std::size_t bytes ) { m_value_heap += bytes; }
+	void clear_value_heap() { m_value_heap = 0; }
+
+private:
+	std::size_t m_value_heap;
+};
+
+template <>
+class value_heap_count_c< false >
+{
+public:
+	std::size_t value_heap() const { return 0; }
+	void add_value_heap( std::size_t ) {}
+	void clear_value_heap() {}
+};
+
+
+/**
+ * The bounds from range< Min, Max >() on an arithmetic option.  They're
+ * kept apart from the constraints so checking them is two comparisons
+ * instead of a call through a std::function.  It's empty for other
+ * types, which check their bounds as constraints.
+ */
+template < typename T, bool = std::is_arithmetic< T >::value >
+class value_bounds_c
+{
+public:
+	value_bounds_c()
+	: m_min()
+	, m_max()
+	, m_bounded( false )
+	{}
+
+	/**
+	 * Narrow the bounds to [min_value, max_value].
+	 */
+	void bound( T min_value, T max_value )
+	{
+		if ( ! m_bounded || m_min < min_value ) {
+			m_min = min_value;
+		}
+		if ( ! m_bounded || max_value < m_max ) {
+			m_max = max_value;
+		}
+		m_bounded = true;
+	}
+
+	bool contains( T value ) const
+	{
+		return ! m_bounded || ! ( value < m_min || m_max < value );
+	}
+
+private:
+	T m_min;
+	T m_max;
+	bool m_bounded;
+};
+
+template < typename T >
+class value_bounds_c< T, false >
+{};
+
+
 /**
  * Interface for storing the option value.
  */
 class option_value_i
 {
 public:
+	virtual ~option_value_i() {}
+
 	/**
 	 * Virtual parser
 	 */
 	virtual bool parse_value( const std::string & ) = 0;
 
+	/**
+	 * Parse a value that came from the given source.  Values from a
+	 * higher precedence source replace values from lower precedence
+	 * sources.  Values from a lower precedence source than the one
+	 * already set are ignored.
+	 */
+	virtual bool merge_value( const std::string &, option_source ) = 0;
+
+	/**
+	 * Get the source of the values currently set for this option.
+	 */
+	virtual option_source source() const = 0;
+
+	/**
+	 * Clear the values if they came from the given source, so the
+	 * source can be parsed again.
+	 */
+	virtual void clear_source( option_source ) = 0;
+
+	/**
+	 * Get the number of values set.
+	 */
+	virtual int size() const = 0;
+
+	/**
+	 * Hint how many values are going to be set, so storage can be
+	 * allocated once up front.  Options are free to ignore it.
+	 */
+	virtual void reserve_values( int ) {}
+
+	/**
+	 * Get the bytes held by the option and its values.  It doesn't
+	 * allocate, so it can be called periodically to export.  Options
+	 * that don't know report nothing.
+	 */
+	virtual option_memory_c memory() const { return option_memory_c(); }
+
+	/**
+	 * Append the bytes of the ith value onto the string so it can be
+	 * read in place from another process.
+	 * @return false if values of this type can't be copied as bytes
+	 */
+	virtual bool encode_value( int i, std::string &bytes ) const = 0;
+
+	/**
+	 * Check if the ith value equals bytes that encode_value wrote
+	 * earlier.  Options that can compare their values directly should,
+	 * since equal values can encode to different bytes.
+	 */
+	virtual bool value_equals( int i, std::string_view bytes ) const
+	{
+		std::string encoded;
+		return encode_value( i, encoded ) && encoded == bytes;
+	}
+
+	/**
+	 * Append the bytes of the default value, like encode_value.
+	 * @return false if there is no default or it can't be copied
+	 */
+	virtual bool encode_default( std::string & ) const { return false; }
+
 	/**
 	 * Check if this option was set _correctly_ in the configuration file.
 	 * It returns false if there was an error.
@@ -64,6 +324,23 @@ public:
 	 */
 	virtual const std::string & description() const = 0;
 
+	/**
+	 * Get the name without needing it in a std::string.  The
+	 * library's options override these so reading the name doesn't
+	 * copy it.
+	 */
+	virtual std::string_view option_name_view() const
+	{
+		return option_name();
+	}
+	/**
+	 * Get the description without needing it in a std::string.
+	 */
+	virtual std::string_view description_view() const
+	{
+		return description();
+	}
+
 	/**
 	 * Check if this usage option requires a parameter.
 	 */
@@ -106,6 +383,21 @@ public:
 	 */
 	virtual const std::string & description() const = 0;
 
+	/**
+	 * Get the name without needing it in a std::string.
+	 */
+	virtual std::string_view option_name_view() const
+	{
+		return option_name();
+	}
+	/**
+	 * Get the description without needing it in a std::string.
+	 */
+	virtual std::string_view description_view() const
+	{
+		return description();
+	}
+
 	/**
 	 * Check if this options _must_ be set in the configuration file.
 	 */
@@ -114,187 +406,1240 @@ public:
 
 
 /**
- * A templated implementation of the option_value_i interface.
- * This implements the code for parsing values and setting them
- * for later retrieval by the client code.
- * Any type can be used as long as it has a default constructor and supports
- * the istream >> operator.
+ * The fixed metadata for an option: its short character, name,
+ * description and whether the configuration must set it.  Descriptors
+ * can be constexpr so they live in read-only data and options only
+ * point at them.
+ *   static constexpr option_descriptor_c PORT( 'p', "port", "Port." );
+ *   usage_option_c< int > port( 80, PORT );
  */
-template < typename T >
-class option_value_c
-: virtual public option_value_i
+class option_descriptor_c
 {
-private:
-	/**
-	 * The internal type for storing values set by command line or
-	 * configuration file.
-	 */
-	typedef std::vector< T > value_list;
-
 public:
-	/**
-	 * The iterator class for iterating over values set for a given
-	 * option.  Values are read-only for client code.
-	 */
-	typedef typename value_list::const_iterator iterator;
-	typedef typename value_list::reference reference;
-	typedef typename value_list::const_reference const_reference;
+	constexpr explicit option_descriptor_c( char usage_char
+			, std::string_view name
+			, std::string_view desc = std::string_view()
+			, bool config_required = false )
+	: m_option_name( name )
+	, m_description( desc )
+	, m_usage_char( usage_char )
+	, m_config_required( config_required )
+	{}
 
-public:
 	/**
-	 * Construct an option value with _no_ default value.
+	 * Construct a descriptor for an option without a short character.
 	 */
-	option_value_c()
-	: m_values()
-	, m_default()
-	, m_default_set( false )
-	, m_set( false )
-	, m_error( false )
+	constexpr explicit option_descriptor_c( std::string_view name
+			, std::string_view desc = std::string_view()
+			, bool config_required = false )
+	: m_option_name( name )
+	, m_description( desc )
+	, m_usage_char( 0 )
+	, m_config_required( config_required )
 	{}
 
-	/**
-	 * Construct an option value with a default value.
-	 */
-	option_value_c( const_reference default_value )
-	: m_values()
-	, m_default( default_value )
-	, m_default_set( true )
-	, m_set( false )
-	, m_error( false )
+	constexpr char usage_character() const { return m_usage_char; }
+	constexpr std::string_view option_name() const { return m_option_name; }
+	constexpr std::string_view description() const { return m_description; }
+	constexpr bool config_required() const { return m_config_required; }
+
+private:
+	std::string_view m_option_name;
+	std::string_view m_description;
+	char m_usage_char;
+	bool m_config_required;
+};
+
+
+/**
+ * Points an option at its descriptor.  Options constructed from name
+ * and description strings own a copy of them here instead, inline if
+ * they're short enough so most options don't allocate for them.
+ * std::string copies are only made if something asks for them.
+ */
+class descriptor_ref_c
+{
+public:
+	explicit descriptor_ref_c( const option_descriptor_c &descriptor )
+	: m_descriptor( &descriptor )
+	, m_strings( NULL )
+	, m_name_size( 0 )
+	, m_desc_size( 0 )
+	, m_usage_char( 0 )
+	, m_storage( STATIC_STORAGE )
+	, m_config_required( false )
 	{}
 
-	/**
-	 * Check if this option was set _correctly_ in the configuration file.
-	 * It returns false if there was an error.
-	 */
-	virtual bool set() const
+	descriptor_ref_c( char usage_char, const std::string &name
+			, const std::string &desc )
+	: m_descriptor( NULL )
+	, m_strings( NULL )
 	{
-		return m_set && ! m_error;
+		own( usage_char, name, desc, false );
 	}
 
-	/**
-	 * Check if this option was set incorrectly in the configuration file.
-	 */
-	virtual bool error() const { return m_error; }
+	descriptor_ref_c( const descriptor_ref_c &ref )
+	: m_descriptor( ref.m_descriptor )
+	, m_strings( NULL )
+	{
+		if ( ref.m_storage == STATIC_STORAGE ) {
+			m_name_size = 0;
+			m_desc_size = 0;
+			m_usage_char = 0;
+			m_storage = STATIC_STORAGE;
+			m_config_required = false;
+		} else {
+			own( ref.usage_character(), ref.option_name()
+					, ref.description(), ref.config_required() );
+		}
+	}
 
-	/**
-	 * Get the value set.  If the value is set multiple times
-	 * this will return the first value.
-	 */
-	const_reference value() const
+	~descriptor_ref_c()
 	{
-		if ( ! m_set ) {
-			// return default even if it's not set
-			// to avoid seg faults
-			return m_default;
+		if ( m_storage == HEAP_STORAGE ) {
+			delete[] m_heap.chars;
 		}
-		return m_values.front();
+		delete m_strings.load( std::memory_order_relaxed );
 	}
 
-	/**
-	 * If the value is set multiple times, this will return the
-	 * most recently set value.
-	 */
-	const_reference last_value() const
+	char usage_character() const
 	{
-		if ( ! m_set ) {
-			// return default even if it's not set
-			// to avoid seg faults
-			return m_default;
+		if ( m_storage == STATIC_STORAGE ) {
+			return m_descriptor->usage_character();
 		}
-		return m_values.back();
+		return m_usage_char;
 	}
 
-	/**
-	 * Get the number of values set for this option.
-	 */
-	int size() const { return m_values.size(); }
+	std::string_view option_name() const
+	{
+		switch ( m_storage ) {
+			case STATIC_STORAGE:
+				return m_descriptor->option_name();
+			case INLINE_STORAGE:
+				return std::string_view( m_inline, m_name_size );
+			default:
+				return std::string_view( m_heap.chars, m_heap.name_size );
+		}
+	}
 
-	/**
-	 * Get the ith value set for this option.
-	 */
-	const_reference value( int i ) const { return m_values[ i ]; }
+	std::string_view description() const
+	{
+		switch ( m_storage ) {
+			case STATIC_STORAGE:
+				return m_descriptor->description();
+			case INLINE_STORAGE:
+				return std::string_view( m_inline + m_name_size
+						, m_desc_size );
+			default:
+				return std::string_view( m_heap.chars + m_heap.name_size
+						, m_heap.desc_size );
+		}
+	}
+
+	bool config_required() const
+	{
+		if ( m_storage == STATIC_STORAGE ) {
+			return m_descriptor->config_required();
+		}
+		return m_config_required;
+	}
 
 	/**
-	 * Get the begin iterator for the list of values on this option.
-	 */
-	iterator begin() const { return m_values.begin(); }
-	/**
-	 * Get the end iterator for the list of values on this option.
+	 * Get the name and description as std::strings.  They're copied
+	 * the first time either is asked for.
 	 */
-	iterator end() const { return m_values.end(); }
+	const std::string & name_string() const { return strings().name; }
+	const std::string & description_string() const
+	{
+		return strings().description;
+	}
 
 	/**
-	 * Implementation of parsing the string value into the templated
-	 * type.  The templated type just needs an implementation of
-	 *   istream >> T
+	 * Get the heap bytes of the owned copy, if it didn't fit inline,
+	 * and of the std::string copies, if they were made.
 	 */
-	virtual bool parse_value( const std::string &str_value )
+	std::size_t heap_bytes() const
 	{
-		// don't keep parsing after an error
-		if ( m_error )
-			return false;
-
-		std::istringstream input( str_value );
-		T val( m_default );
-		input >> val;
-		m_error = input.fail();
-		if ( ! m_error ) {
-			m_set = true;
-			m_values.push_back( val );
+		std::size_t bytes( 0 );
+		if ( m_storage == HEAP_STORAGE ) {
+			bytes += m_heap.name_size + m_heap.desc_size;
 		}
-		return ! m_error;
+		const string_copies *copies(
+				m_strings.load( std::memory_order_acquire ) );
+		if ( copies ) {
+			bytes += sizeof( string_copies )
+				+ value_footprint_c< std::string >::heap_bytes( copies->name )
+				+ value_footprint_c< std::string >::heap_bytes(
+						copies->description );
+		}
+		return bytes;
 	}
 
 private:
-	value_list m_values;
-	const T m_default;
-	const bool m_default_set;
-	bool m_set;
-	bool m_error;
-};
+	descriptor_ref_c & operator = ( const descriptor_ref_c & );
 
-template <>
-bool option_value_c< bool >::parse_value( const std::string &str_value );
+	static constexpr std::size_t INLINE_CHARS = 24;
 
-template <>
-bool option_value_c< std::string >::parse_value( const std::string &str_value );
+	enum storage : unsigned char
+	{
+		STATIC_STORAGE,
+		INLINE_STORAGE,
+		HEAP_STORAGE
+	};
 
+	void own( char usage_char, std::string_view name, std::string_view desc
+			, bool config_required )
+	{
+		char *chars;
+		m_name_size = 0;
+		m_desc_size = 0;
+		if ( name.size() + desc.size() <= INLINE_CHARS ) {
+			m_storage = INLINE_STORAGE;
+			m_name_size = name.size();
+			m_desc_size = desc.size();
+			chars = m_inline;
+		} else {
+			m_storage = HEAP_STORAGE;
+			m_heap.chars = new char[ name.size() + desc.size() ];
+			m_heap.name_size = name.size();
+			m_heap.desc_size = desc.size();
+			chars = m_heap.chars;
+		}
+		std::copy( name.begin(), name.end(), chars );
+		std::copy( desc.begin(), desc.end(), chars + name.size() );
+		m_usage_char = usage_char;
+		m_config_required = config_required;
+	}
 
-/**
- * An option that can be set on command line usage or a configuration file.
- */
-template < typename T >
-class shared_option_c
-: public option_value_c< T >
-, virtual public config_option_i
+	class heap_chars
+	{
+	public:
+		char *chars;
+		std::uint32_t name_size;
+		std::uint32_t desc_size;
+	};
+
+	class string_copies
+	{
+	public:
+		std::string name;
+		std::string description;
+	};
+
+	/**
+	 * Make the string copies if they haven't been.  Options can be
+	 * read from several threads, so the first copy published wins.
+	 */
+	const string_copies & strings() const
+	{
+		string_copies *copies( m_strings.load( std::memory_order_acquire ) );
+		if ( copies ) {
+			return *copies;
+		}
+		std::string_view name( option_name() );
+		std::string_view desc( description() );
+		copies = new string_copies{ std::string( name.data(), name.size() )
+			, std::string( desc.data(), desc.size() ) };
+		string_copies *expected( NULL );
+		if ( ! m_strings.compare_exchange_strong( expected, copies
+					, std::memory_order_acq_rel ) ) {
+			delete copies;
+			return *expected;
+		}
+		return *copies;
+	}
+
+	union
+	{
+		const option_descriptor_c *m_descriptor;
+		char m_inline[ INLINE_CHARS ];
+		heap_chars m_heap;
+	};
+	mutable std::atomic< string_copies * > m_strings;
+	unsigned char m_name_size;
+	unsigned char m_desc_size;
+	char m_usage_char;
+	storage m_storage;
+	bool m_config_required;
+};
+
+
+/**
+ * Parses a string into a value of type T.  The default implementation
+ * uses the istream >> operator.  Specialize this class for types that
+ * need to be parsed some other way.
+ */
+template < typename T >
+class value_parser_c
+{
+public:
+	/**
+	 * Parse the string into the value.  The value is left as it was
+	 * if there's nothing to parse.
+	 * @return false if the string couldn't be parsed
+	 */
+	static bool parse( const std::string &str_value, T &value )
+	{
+		std::istringstream input( str_value );
+		input >> value;
+		return ! input.fail();
+	}
+};
+
+/**
+ * Booleans are set to true just by being given.
+ */
+template <>
+class value_parser_c< bool >
+{
+public:
+	static bool parse( const std::string &str_value, bool &value );
+};
+
+/**
+ * Strings take the whole value, including any whitespace.
+ */
+template <>
+class value_parser_c< std::string >
+{
+public:
+	static bool parse( const std::string &str_value, std::string &value );
+};
+
+
+/**
+ * Checks if T has an == operator.
+ */
+template < typename T, typename = void >
+class equality_comparable_c
+: public std::false_type
+{};
+
+template < typename T >
+class equality_comparable_c< T, decltype( void( std::declval< const T & >()
+			== std::declval< const T & >() ) ) >
+: public std::true_type
+{};
+
+
+/**
+ * Copies values of type T to bytes that can be read in place from
+ * another process.  Trivially copyable types are copied as they are
+ * and strings are copied as their characters.  Specialize this class
+ * for other types that can be.
+ *
+ * equal() checks a value against bytes it encoded earlier.  Copied
+ * types are copied back and compared with ==, when they have it, so
+ * padding in their bytes, like in a long double, doesn't count.
+ */
+template < typename T, bool = std::is_trivially_copyable< T >::value >
+class value_codec_c
+{
+public:
+	static bool encode( const T &, std::string & ) { return false; }
+	static bool equal( const T &, std::string_view ) { return false; }
+};
+
+template < typename T >
+class value_codec_c< T, true >
+{
+public:
+	static bool encode( const T &value, std::string &bytes )
+	{
+		bytes.append( reinterpret_cast< const char * >( &value )
+				, sizeof( T ) );
+		return true;
+	}
+
+	static bool equal( const T &value, std::string_view bytes )
+	{
+		if ( bytes.size() != sizeof( T ) ) {
+			return false;
+		}
+		if constexpr ( equality_comparable_c< T >::value ) {
+			T copy;
+			memcpy( static_cast< void * >( &copy ), bytes.data()
+					, sizeof( T ) );
+			return bool( copy == value );
+		} else {
+			return memcmp( &value, bytes.data(), sizeof( T ) ) == 0;
+		}
+	}
+};
+
+template < typename Traits, typename Alloc >
+class value_codec_c< std::basic_string< char, Traits, Alloc >, false >
+{
+public:
+	static bool encode( const std::basic_string< char, Traits, Alloc > &value
+			, std::string &bytes )
+	{
+		bytes.append( value.data(), value.size() );
+		return true;
+	}
+
+	static bool equal( const std::basic_string< char, Traits, Alloc > &value
+			, std::string_view bytes )
+	{
+		return std::string_view( value.data(), value.size() ) == bytes;
+	}
+};
+
+
+/**
+ * Makes values that use the option's allocator when the value type
+ * can use one, like std::pmr::string.  Other types are just copied.
+ */
+template < typename T, typename Alloc
+	, bool = std::uses_allocator< T, Alloc >::value >
+class allocated_value_c
+{
+public:
+	static T make( const Alloc & ) { return T(); }
+	static T copy( const T &value, const Alloc & ) { return value; }
+};
+
+template < typename T, typename Alloc >
+class allocated_value_c< T, Alloc, true >
+{
+public:
+	static T make( const Alloc &alloc ) { return T( alloc ); }
+	static T copy( const T &value, const Alloc &alloc )
+	{
+		return T( value, alloc );
+	}
+};
+
+
+/**
+ * A templated implementation of the option_value_i interface.
+ * This implements the code for parsing values and setting them
+ * for later retrieval by the client code.
+ * Any type can be used as long as it has a default constructor and
+ * either supports the istream >> operator or has a specialization
+ * of value_parser_c.
+ * Values are stored with the given allocator, which is also passed
+ * on to values that can use it.
+ */
+template < typename T, typename Alloc = std::allocator< T > >
+class option_value_c
+: virtual public option_value_i
+, private value_heap_count_c< value_footprint_c< T >::allocates >
+{
+private:
+	/**
+	 * The internal type for storing values set by command line or
+	 * configuration file.
+	 */
+	typedef std::vector< T, Alloc > value_list;
+	typedef chunked_list_c< T, Alloc > chunk_list;
+	typedef allocated_value_c< T, Alloc > allocated_value;
+	typedef std::vector< std::function< bool ( const T & ) > >
+		constraint_list;
+
+public:
+	typedef Alloc allocator_type;
+
+	typedef typename value_list::reference reference;
+	typedef typename value_list::const_reference const_reference;
+	/**
+	 * The iterator class for iterating over values set for a given
+	 * option.  Values are read-only for client code.
+	 */
+	typedef value_iterator_c< option_value_c, T, const_reference > iterator;
+
+	/**
+	 * Takes each value as it's parsed, instead of the option
+	 * storing it.
+	 */
+	typedef std::function< void ( T && ) > consumer_callback;
+
+public:
+	/**
+	 * Construct an option value with _no_ default value.
+	 */
+	option_value_c()
+	: m_values()
+	, m_settings()
+	, m_default()
+	, m_default_set( false )
+	, m_source( DEFAULT_SOURCE )
+	, m_set( false )
+	, m_error( false )
+	{}
+
+	/**
+	 * Construct an option value with _no_ default value that stores
+	 * values with the given allocator.
+	 */
+	explicit option_value_c( const Alloc &alloc )
+	: m_values( alloc )
+	, m_settings()
+	, m_default( allocated_value::make( alloc ) )
+	, m_default_set( false )
+	, m_source( DEFAULT_SOURCE )
+	, m_set( false )
+	, m_error( false )
+	{}
+
+	/**
+	 * Construct an option value with a default value.
+	 */
+	option_value_c( const_reference default_value
+			, const Alloc &alloc = Alloc() )
+	: m_values( alloc )
+	, m_settings()
+	, m_default( allocated_value::copy( default_value, alloc ) )
+	, m_default_set( true )
+	, m_source( DEFAULT_SOURCE )
+	, m_set( false )
+	, m_error( false )
+	{}
+
+	/**
+	 * Copy an option value, including its constraints.
+	 */
+	option_value_c( const option_value_c &value )
+	: option_value_i()
+	, m_values( value.m_values )
+	, m_settings( value.m_settings
+			? new value_settings( *value.m_settings ) : NULL )
+	, m_default( value.m_default )
+	, m_default_set( value.m_default_set )
+	, m_source( value.m_source )
+	, m_set( value.m_set )
+	, m_error( value.m_error )
+	{
+		// copied values only have the capacity they need
+		for ( int i(0); i<size(); ++i ) {
+			this->add_value_heap( value_footprint_c< T >::heap_bytes(
+						this->value( i ) ) );
+		}
+	}
+
+	/**
+	 * Get the allocator values are stored with.
+	 */
+	allocator_type get_allocator() const
+	{
+		return m_values.get_allocator();
+	}
+
+	/**
+	 * Add a constraint that every value must pass.  A value that fails
+	 * a constraint is an error, same as one that doesn't parse.
+	 */
+	option_value_c & constrain( const std::function< bool ( const T & ) > &c )
+	{
+		settings().constraints.push_back( c );
+		return *this;
+	}
+
+	/**
+	 * Require values to be at least min.
+	 */
+	option_value_c & min( const T &min_value )
+	{
+		return constrain( [ min_value ]( const T &value )
+				{ return ! ( value < min_value ); } );
+	}
+
+	/**
+	 * Require values to be at most max.
+	 */
+	option_value_c & max( const T &max_value )
+	{
+		return constrain( [ max_value ]( const T &value )
+				{ return ! ( max_value < value ); } );
+	}
+
+	/**
+	 * Require values to be in [min, max].
+	 */
+	option_value_c & range( const T &min_value, const T &max_value )
+	{
+		return constrain( [ min_value, max_value ]( const T &value )
+				{ return ! ( value < min_value || max_value < value ); } );
+	}
+
+	/**
+	 * Require values to be in [Min, Max] where the bounds are known at
+	 * compile time.  Arithmetic options check them inline before any
+	 * other constraints, not through the constraint list.
+	 *   port.range< 1, 65535 >();
+	 */
+	template < auto Min, auto Max >
+	option_value_c & range()
+	{
+		if constexpr ( std::is_arithmetic< T >::value ) {
+			settings().bounds.bound( T( Min ), T( Max ) );
+			return *this;
+		} else {
+			return constrain( &in_range< Min, Max > );
+		}
+	}
+
+	/**
+	 * Require values to be one of the given values.
+	 */
+	option_value_c & allowed( std::initializer_list< T > values )
+	{
+		std::vector< T > allowed_values( values );
+		return constrain( [ allowed_values ]( const T &value )
+				{
+					return std::find( allowed_values.begin()
+						, allowed_values.end(), value )
+						!= allowed_values.end();
+				} );
+	}
+
+	/**
+	 * Require values, like strings, to have at most max size().
+	 */
+	option_value_c & max_length( std::size_t max_size )
+	{
+		return constrain( [ max_size ]( const T &value )
+				{ return value.size() <= max_size; } );
+	}
+
+	/**
+	 * Store values in fixed size chunks instead of one array, for
+	 * options that are set very many times.  Growing never copies the
+	 * values that are already stored.
+	 */
+	option_value_c & chunked( std::size_t chunk_size = 1024 )
+	{
+		value_settings &config( settings() );
+		if ( ! config.chunks ) {
+			config.chunks.reset( new chunk_list( chunk_size
+						, m_values.get_allocator() ) );
+			config.chunks->reserve( m_values.size() );
+			for ( std::size_t i(0); i<m_values.size(); ++i ) {
+				config.chunks->push_back( std::move( m_values[ i ] ) );
+			}
+			m_values.clear();
+			m_values.shrink_to_fit();
+		}
+		return *this;
+	}
+
+	/**
+	 * Pass each value to the consumer as it's parsed instead of
+	 * storing it.  The option is still set, but has no values, so
+	 * value() returns the default.
+	 */
+	option_value_c & consume( const consumer_callback &consumer )
+	{
+		settings().consumer = consumer;
+		return *this;
+	}
+
+	/**
+	 * Allocate storage for count values up front.
+	 */
+	virtual void reserve_values( int count )
+	{
+		if ( m_settings && m_settings->consumer ) {
+			return;
+		}
+		if ( m_settings && m_settings->chunks ) {
+			m_settings->chunks->reserve( count );
+		} else {
+			m_values.reserve( count );
+		}
+	}
+
+	/**
+	 * Check if this option was set _correctly_ in the configuration file.
+	 * It returns false if there was an error.
+	 */
+	virtual bool set() const
+	{
+		return m_set && ! m_error;
+	}
+
+	/**
+	 * Check if this option was set incorrectly in the configuration file.
+	 */
+	virtual bool error() const { return m_error; }
+
+	/**
+	 * Get the source of the values currently set for this option.
+	 */
+	virtual option_source source() const { return m_source; }
+
+	/**
+	 * Clear the values if they came from the given source.
+	 */
+	virtual void clear_source( option_source src )
+	{
+		if ( src != m_source ) {
+			return;
+		}
+		clear_values();
+		m_set = false;
+		m_error = false;
+		m_source = DEFAULT_SOURCE;
+	}
+
+	/**
+	 * Get the value set.  If the value is set multiple times
+	 * this will return the first value.
+	 */
+	const_reference value() const
+	{
+		if ( ! m_set || size() == 0 ) {
+			// return default even if it's not set
+			// to avoid seg faults
+			return m_default;
+		}
+		return value( 0 );
+	}
+
+	/**
+	 * If the value is set multiple times, this will return the
+	 * most recently set value.
+	 */
+	const_reference last_value() const
+	{
+		if ( ! m_set || size() == 0 ) {
+			// return default even if it's not set
+			// to avoid seg faults
+			return m_default;
+		}
+		return value( size() - 1 );
+	}
+
+	/**
+	 * Get the number of values set for this option.
+	 */
+	virtual int size() const
+	{
+		if ( m_settings && m_settings->chunks ) {
+			return m_settings->chunks->size();
+		}
+		return m_values.size();
+	}
+
+	/**
+	 * Get the ith value set for this option.
+	 */
+	const_reference value( int i ) const
+	{
+		if ( m_settings && m_settings->chunks ) {
+			return ( *m_settings->chunks )[ i ];
+		}
+		return m_values[ i ];
+	}
+
+	/**
+	 * Get the begin iterator for the list of values on this option.
+	 */
+	iterator begin() const { return iterator( this, 0 ); }
+	/**
+	 * Get the end iterator for the list of values on this option.
+	 */
+	iterator end() const { return iterator( this, size() ); }
+
+	/**
+	 * Append the bytes of the ith value with value_codec_c.
+	 */
+	virtual bool encode_value( int i, std::string &bytes ) const
+	{
+		return value_codec_c< T >::encode( value( i ), bytes );
+	}
+
+	/**
+	 * Compare the ith value with value_codec_c.
+	 */
+	virtual bool value_equals( int i, std::string_view bytes ) const
+	{
+		return value_codec_c< T >::equal( value( i ), bytes );
+	}
+
+	/**
+	 * Append the bytes of the default value with value_codec_c.
+	 */
+	virtual bool encode_default( std::string &bytes ) const
+	{
+		return m_default_set && value_codec_c< T >::encode( m_default, bytes );
+	}
+
+	/**
+	 * Get the bytes held by the option.  The heap bytes of the values
+	 * are counted with value_footprint_c as they're stored, so this
+	 * is constant time.
+	 */
+	virtual option_memory_c memory() const
+	{
+		option_memory_c bytes;
+		bytes.inline_bytes = sizeof( *this );
+		if constexpr ( std::is_same< T, bool >::value ) {
+			// std::vector< bool > packs its values into bits
+			bytes.value_bytes = ( m_values.capacity() + 7 ) / 8;
+		} else {
+			bytes.value_bytes = m_values.capacity() * sizeof( T );
+		}
+		bytes.heap_bytes = value_footprint_c< T >::heap_bytes( m_default )
+			+ this->value_heap();
+		bytes.values = size();
+		if ( m_settings ) {
+			bytes.heap_bytes += sizeof( value_settings )
+				+ m_settings->constraints.capacity()
+					* sizeof( typename constraint_list::value_type );
+			if ( m_settings->chunks ) {
+				bytes.value_bytes += m_settings->chunks->heap_bytes();
+			}
+		}
+		return bytes;
+	}
+
+	/**
+	 * Implementation of parsing the string value into the templated
+	 * type.  The templated type just needs an implementation of
+	 *   istream >> T
+	 * or a specialization of value_parser_c.
+	 */
+	virtual bool parse_value( const std::string &str_value )
+	{
+		return store_value( str_value );
+	}
+
+	/**
+	 * Parse a value from the given source.  The first value from a
+	 * higher precedence source clears the values and any error from
+	 * lower precedence sources, so the winning values are stored in
+	 * place no matter what order the sources are parsed in.
+	 */
+	virtual bool merge_value( const std::string &str_value
+			, option_source src )
+	{
+		if ( ! accept_source( src ) ) {
+			return ! m_error;
+		}
+		return parse_value( str_value );
+	}
+
+	/**
+	 * The same as merge_value, but calls the parser for T directly
+	 * instead of through the virtual parse_value.  Option records use
+	 * this for the option classes in this library, which don't
+	 * override parse_value.
+	 */
+	bool merge_typed_value( const std::string &str_value
+			, option_source src )
+	{
+		if ( ! accept_source( src ) ) {
+			return ! m_error;
+		}
+		return store_value( str_value );
+	}
+
+private:
+	/**
+	 * Prepare to take a value from the given source.
+	 * @return false if the option is already set from a higher
+	 * precedence source
+	 */
+	bool accept_source( option_source src )
+	{
+		if ( src < m_source ) {
+			return false;
+		}
+		if ( src > m_source ) {
+			clear_values();
+			m_set = false;
+			m_error = false;
+			m_source = src;
+		}
+		return true;
+	}
+
+	bool store_value( const std::string &str_value )
+	{
+		// don't keep parsing after an error
+		if ( m_error )
+			return false;
+
+		T val( allocated_value::copy( m_default
+					, m_values.get_allocator() ) );
+		m_error = ! value_parser_c< T >::parse( str_value, val );
+		if ( ! m_error && m_settings ) {
+			m_error = ! check_constraints( val );
+		}
+		if ( ! m_error ) {
+			m_set = true;
+			push_value( std::move( val ) );
+		}
+		return ! m_error;
+	}
+
+	template < auto Min, auto Max >
+	static bool in_range( const T &value )
+	{
+		return ! ( value < Min || Max < value );
+	}
+
+	bool check_constraints( const T &value ) const
+	{
+		if constexpr ( std::is_arithmetic< T >::value ) {
+			if ( ! m_settings->bounds.contains( value ) ) {
+				return false;
+			}
+		}
+		const constraint_list &constraints( m_settings->constraints );
+		for ( std::size_t i(0); i<constraints.size(); ++i ) {
+			if ( ! constraints[ i ]( value ) ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void push_value( T &&value )
+	{
+		if ( ! m_settings || ! m_settings->consumer ) {
+			// moving the value keeps its buffer
+			this->add_value_heap( value_footprint_c< T >::heap_bytes(
+						value ) );
+		}
+		if ( ! m_settings ) {
+			m_values.push_back( std::move( value ) );
+		} else if ( m_settings->consumer ) {
+			m_settings->consumer( std::move( value ) );
+		} else if ( m_settings->chunks ) {
+			m_settings->chunks->push_back( std::move( value ) );
+		} else {
+			m_values.push_back( std::move( value ) );
+		}
+	}
+
+	void clear_values()
+	{
+		this->clear_value_heap();
+		m_values.clear();
+		if ( m_settings && m_settings->chunks ) {
+			m_settings->chunks->clear();
+		}
+	}
+
+	/**
+	 * The rarely used settings of an option: its bounds, constraints
+	 * and how its values are stored.
+	 */
+	class value_settings
+	{
+	public:
+		value_settings()
+		: bounds()
+		, constraints()
+		, chunks()
+		, consumer()
+		{}
+
+		value_settings( const value_settings &config )
+		: bounds( config.bounds )
+		, constraints( config.constraints )
+		, chunks( config.chunks ? new chunk_list( *config.chunks ) : NULL )
+		, consumer( config.consumer )
+		{}
+
+		value_bounds_c< T > bounds;
+		constraint_list constraints;
+		std::unique_ptr< chunk_list > chunks;
+		consumer_callback consumer;
+	};
+
+	value_settings & settings()
+	{
+		if ( ! m_settings ) {
+			m_settings.reset( new value_settings() );
+		}
+		return *m_settings;
+	}
+
+	value_list m_values;
+	// only allocated for options with constraints or other settings
+	std::unique_ptr< value_settings > m_settings;
+	const T m_default;
+	const bool m_default_set;
+	option_source m_source;
+	bool m_set;
+	bool m_error;
+};
+
+
+/**
+ * Marks the option classes in this library.  They don't override
+ * parse_value, so option records can parse their values without
+ * virtual calls.  Classes derived from them aren't marked and are
+ * called through their interfaces.
+ */
+template < typename Option >
+class typed_option_traits_c
+: public std::false_type
+{};
+
+/**
+ * An option that can be set on command line usage or a configuration file.
+ * The same object is added to both the usage and the configuration
+ * so its values are only stored once.
+ */
+template < typename T >
+class shared_option_c
+: public option_value_c< T >
+, virtual public config_option_i
 , virtual public usage_option_i
 {
 public:
-	shared_option_c();
+	/**
+	 * Construct the shared option.  The name is the long option on
+	 * the command line and the key in the configuration file.
+	 */
+	shared_option_c( char short_opt, const std::string &name
+			, const std::string &desc = std::string() )
+	: option_value_c< T >()
+	, m_descriptor( short_opt, name, desc )
+	{}
+
+	/**
+	 * Construct the shared option with a default value.
+	 */
+	shared_option_c( const T &default_value, char short_opt
+			, const std::string &name
+			, const std::string &desc = std::string() )
+	: option_value_c< T >( default_value )
+	, m_descriptor( short_opt, name, desc )
+	{}
 
-	virtual char option_character() const { return m_option_char; }
+	/**
+	 * Construct the shared option from a descriptor that outlives it.
+	 */
+	explicit shared_option_c( const option_descriptor_c &descriptor )
+	: option_value_c< T >()
+	, m_descriptor( descriptor )
+	{}
+
+	/**
+	 * Construct the shared option with a default value from a
+	 * descriptor that outlives it.
+	 */
+	shared_option_c( const T &default_value
+			, const option_descriptor_c &descriptor )
+	: option_value_c< T >( default_value )
+	, m_descriptor( descriptor )
+	{}
+
+	virtual char usage_character() const
+	{
+		return m_descriptor.usage_character();
+	}
 	virtual const std::string & option_name() const
 	{
-		return m_option_name;
+		return m_descriptor.name_string();
+	}
+	virtual std::string_view option_name_view() const
+	{
+		return m_descriptor.option_name();
 	}
 	virtual const std::string & description() const
 	{
-		return m_description;
+		return m_descriptor.description_string();
+	}
+	virtual std::string_view description_view() const
+	{
+		return m_descriptor.description();
 	}
 
 	virtual bool requires_param() const
 	{
 		return usage_option_i::type_requires_param< T >();
 	}
-	virtual bool config_required() const { return m_config_required; }
+	virtual bool config_required() const
+	{
+		return m_descriptor.config_required();
+	}
+
+	/**
+	 * Get the bytes held by the option, including its owned name and
+	 * description.
+	 */
+	virtual option_memory_c memory() const
+	{
+		option_memory_c bytes( option_value_c< T >::memory() );
+		bytes.inline_bytes = sizeof( *this );
+		bytes.heap_bytes += m_descriptor.heap_bytes();
+		return bytes;
+	}
 
 private:
-	std::string m_option_name;
-	std::string m_description;
+	descriptor_ref_c m_descriptor;
+};
 
-	char m_option_char;
-	bool m_config_required;
+template < typename T >
+class typed_option_traits_c< shared_option_c< T > >
+: public std::true_type
+{};
+
+
+/**
+ * The functions to call an option through when all that's kept of it
+ * is a void pointer.  There's one static table for each option type.
+ */
+class option_handler_c
+{
+public:
+	bool ( *merge_value )( void *option, const std::string &
+			, option_source );
+	bool ( *requires_param )( const void *option );
+	config_option_i * ( *config_option )( void *option );
+	usage_option_i * ( *usage_option )( void *option );
+};
+
+/**
+ * The handler table for an Option type.  Typed options parse straight
+ * into their values, anything else goes through merge_value.
+ */
+template < typename Option
+	, bool Typed = typed_option_traits_c< Option >::value >
+class option_handler_table_c
+{
+public:
+	static const option_handler_c handler;
+
+private:
+	static bool merge_value( void *option, const std::string &str_value
+			, option_source src )
+	{
+		if constexpr ( Typed ) {
+			return static_cast< Option * >( option )->merge_typed_value(
+					str_value, src );
+		} else {
+			return static_cast< Option * >( option )->merge_value(
+					str_value, src );
+		}
+	}
+
+	static bool requires_param( const void *option )
+	{
+		if constexpr ( std::is_base_of< usage_option_i, Option >::value ) {
+			return static_cast< const Option * >( option )
+				->requires_param();
+		} else {
+			return true;
+		}
+	}
+
+	static config_option_i * config_option( void *option )
+	{
+		if constexpr ( std::is_base_of< config_option_i, Option >::value ) {
+			return static_cast< Option * >( option );
+		} else {
+			return NULL;
+		}
+	}
+
+	static usage_option_i * usage_option( void *option )
+	{
+		if constexpr ( std::is_base_of< usage_option_i, Option >::value ) {
+			return static_cast< Option * >( option );
+		} else {
+			return NULL;
+		}
+	}
+};
+
+template < typename Option, bool Typed >
+const option_handler_c option_handler_table_c< Option, Typed >::handler =
+{
+	&option_handler_table_c::merge_value,
+	&option_handler_table_c::requires_param,
+	&option_handler_table_c::config_option,
+	&option_handler_table_c::usage_option
+};
+
+
+/**
+ * One option in the flat array that usage_c and configuration_c keep.
+ * It holds the option, its type's handler table and a copy of the
+ * name and character that lookups compare against, so searching
+ * doesn't touch the options themselves.
+ */
+class option_record_c
+{
+public:
+	template < typename Option >
+	explicit option_record_c( Option &option )
+	: m_option( &option )
+	, m_handler( select_handler( option ) )
+	, m_option_name( option.option_name_view() )
+	, m_usage_char( 0 )
+	{
+		if constexpr ( std::is_base_of< usage_option_i, Option >::value ) {
+			m_usage_char = option.usage_character();
+		}
+	}
+
+	std::string_view option_name() const { return m_option_name; }
+	char usage_character() const { return m_usage_char; }
+
+	/**
+	 * Merge a value into the option.  It's traced as a parse_value
+	 * event keyed by the option name, so the value itself is never
+	 * recorded.
+	 */
+	bool merge_value( const std::string &str_value, option_source src ) const
+	{
+		STDOPT_EVENT_START( parse_value, trace_timer, m_option_name
+				, str_value.size() );
+		bool merged( m_handler->merge_value( m_option, str_value, src ) );
+		STDOPT_EVENT_END( parse_value, trace_timer, m_option_name
+				, str_value.size() );
+		return merged;
+	}
+	bool requires_param() const
+	{
+		return m_handler->requires_param( m_option );
+	}
+
+	/**
+	 * Get the option's config interface or NULL if it isn't a
+	 * config option.
+	 */
+	config_option_i * config_option() const
+	{
+		return m_handler->config_option( m_option );
+	}
+	/**
+	 * Get the option's usage interface or NULL if it isn't a
+	 * usage option.
+	 */
+	usage_option_i * usage_option() const
+	{
+		return m_handler->usage_option( m_option );
+	}
+
+private:
+	/**
+	 * Use the typed handler only if the option really is the typed
+	 * class.  A subclass added through a reference to it may override
+	 * parse_value, so it goes through the virtual interface.
+	 */
+	template < typename Option >
+	static const option_handler_c * select_handler( Option &option )
+	{
+		if constexpr ( typed_option_traits_c< Option >::value ) {
+			if ( typeid( option ) != typeid( Option ) ) {
+				return &option_handler_table_c< Option, false >::handler;
+			}
+		}
+		return &option_handler_table_c< Option >::handler;
+	}
+
+	void *m_option;
+	const option_handler_c *m_handler;
+	std::string_view m_option_name;
+	char m_usage_char;
 };
 
 
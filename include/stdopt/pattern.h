@@ -0,0 +1,110 @@
+#ifndef STDOPT_PATTERN_H
+#define STDOPT_PATTERN_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "option.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stdopt {
+
+
+/**
+ * A set of dotted key patterns compiled into one trie over the key
+ * segments.  A segment of * or <name> matches any one segment of a key
+ * and captures it:
+ *   backend.<name>.weight
+ *   route.*.timeout
+ * Keys are matched in a single pass over their segments, following
+ * every trie branch that can still match at the same time.  When more
+ * than one pattern matches, the one with the fewest wildcards wins,
+ * then the one inserted first.  match() reuses scratch space, so
+ * only one thread can match at a time.
+ */
+class pattern_trie_c
+{
+public:
+	pattern_trie_c();
+
+	/**
+	 * Insert a pattern.
+	 * @return the id for the pattern, the existing one if it was
+	 * already inserted
+	 */
+	int insert( std::string_view pattern );
+
+	/**
+	 * Match a key against the patterns.  The segments the matching
+	 * pattern's wildcards matched are put in captures, in order.
+	 * @return the pattern id or -1 if no pattern matches
+	 */
+	int match( std::string_view key
+			, std::vector< std::string_view > &captures ) const;
+
+	/**
+	 * Get the number of patterns.
+	 */
+	int size() const { return m_pattern.size(); }
+
+	/**
+	 * Get the bytes allocated for the trie.
+	 */
+	std::size_t heap_bytes() const;
+
+	/**
+	 * Check if a pattern segment is a wildcard.
+	 */
+	static bool wildcard( std::string_view segment );
+
+private:
+	struct edge
+	{
+		std::string segment;
+		int child;
+	};
+
+	struct node
+	{
+		// sorted by segment
+		std::vector< edge > literal;
+		int wildcard;
+		int pattern;
+	};
+
+	struct pattern_entry
+	{
+		// the indexes of the wildcard segments
+		std::vector< int > wildcard_segment;
+	};
+
+	static bool edge_before( const edge &e, std::string_view segment );
+
+	int find_literal( int node_id, std::string_view segment ) const;
+	int add_node();
+	bool better_match( int pattern, int best ) const;
+
+	std::vector< node > m_node;
+	std::vector< pattern_entry > m_pattern;
+	// the branches still matching, kept to not allocate on each key
+	mutable std::vector< int > m_active;
+	mutable std::vector< int > m_next;
+};
+
+
+} // end namespace
+
+#endif
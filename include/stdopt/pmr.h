@@ -0,0 +1,73 @@
+#ifndef STDOPT_PMR_H
+#define STDOPT_PMR_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/configuration.h>
+#include <stdopt/usage.h>
+#include <memory_resource>
+#include <string>
+
+namespace stdopt {
+
+
+/**
+ * pmr::string values take the whole value, including any whitespace,
+ * and allocate from the option's memory resource.
+ */
+template <>
+class value_parser_c< std::pmr::string >
+{
+public:
+	static bool parse( const std::string &str_value
+			, std::pmr::string &value )
+	{
+		value.assign( str_value.data(), str_value.size() );
+		return true;
+	}
+};
+
+
+/**
+ * Options that keep their values in a caller supplied
+ * std::pmr::memory_resource.  Use std::pmr::string for string values
+ * so the strings are allocated from the resource too.  ie.
+ *
+ *   configuration_c config( &tenant_resource );
+ *   pmr::config_option_c< std::pmr::string > host( "host", "Host."
+ *       , config.resource() );
+ *
+ * Releasing the resource releases everything parsed for the tenant.
+ */
+namespace pmr {
+
+template < typename T >
+using option_value_c = stdopt::option_value_c< T
+	, std::pmr::polymorphic_allocator< T > >;
+
+template < typename T >
+using config_option_c = stdopt::config_option_c< T
+	, std::pmr::polymorphic_allocator< T > >;
+
+template < typename T >
+using usage_option_c = stdopt::usage_option_c< T
+	, std::pmr::polymorphic_allocator< T > >;
+
+} // end namespace pmr
+
+
+} // end namespace
+
+#endif
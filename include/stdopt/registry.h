@@ -0,0 +1,121 @@
+#ifndef STDOPT_REGISTRY_H
+#define STDOPT_REGISTRY_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/configuration.h>
+#include <stdopt/usage.h>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stdopt {
+
+
+/**
+ * A registry for options that can be set on the command line, in the
+ * environment or in the configuration file.  Each option is added once
+ * and indexed for both the usage and the configuration.
+ *
+ * Values are taken from the highest precedence source that set them:
+ *   1. command line args
+ *   2. environment variables
+ *   3. the configuration file
+ *   4. the option's default value
+ * Values from a higher precedence source replace any values from a
+ * lower precedence source, whatever order the sources are parsed in,
+ * so value() returns the winning value directly.
+ */
+class option_registry_c
+{
+public:
+	/**
+	 * Construct an empty registry.  Environment variables are named
+	 * by the prefix followed by the upper case option name with any
+	 * '-' or '.' replaced by '_'.  ie. "MYAPP_" + "log-level" is
+	 * MYAPP_LOG_LEVEL.
+	 */
+	option_registry_c( const std::string &env_prefix = std::string() );
+
+	/**
+	 * Add a shared option to the usage, the configuration and the
+	 * environment.
+	 */
+	template < typename T >
+	void add( shared_option_c< T > &option )
+	{
+		add_shared( option, option );
+	}
+
+	/**
+	 * Parse all the sources in one pass.  The options are left with
+	 * the values from the highest precedence source that set them.
+	 * @return true if all the sources were parsed successfully
+	 */
+	bool parse( int argc, const char **argv, std::istream &config );
+
+	/**
+	 * Parse only the configuration file.
+	 */
+	void parse_config( std::istream &config );
+	/**
+	 * Parse only the environment variables.
+	 */
+	void parse_environment();
+	/**
+	 * Parse only the command line args.
+	 */
+	bool parse_args( int argc, const char **argv );
+
+	/**
+	 * Check if there was an error parsing any of the sources.  A bad
+	 * value is only an error if no higher precedence source replaced
+	 * it, so a bad value in the configuration file can be fixed on
+	 * the command line.
+	 */
+	bool error() const;
+
+	/**
+	 * Get the environment variable name for an option.
+	 */
+	std::string environment_name( std::string_view option_name ) const;
+
+	/**
+	 * Get the usage for the registered options.  Useful for writing
+	 * documentation with usage_doc_c.
+	 */
+	const usage_c & usage() const { return m_usage; }
+	/**
+	 * Get the configuration for the registered options.
+	 */
+	const configuration_c & configuration() const { return m_config; }
+
+private:
+	typedef std::pair< std::string, config_option_i * > environment_option;
+	typedef std::vector< environment_option > environment_list;
+
+	void add_shared( usage_option_i &, config_option_i & );
+
+	usage_c m_usage;
+	configuration_c m_config;
+	environment_list m_environment;
+	std::string m_env_prefix;
+};
+
+
+} // end namespace
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef STDOPT_SCANNER_H
+#define STDOPT_SCANNER_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/option.h>
+#include <istream>
+#include <string>
+#include <string_view>
+
+namespace stdopt {
+
+
+/**
+ * Interface for the front-ends that split configuration text into key
+ * and value spans for configuration_c.
+ */
+class config_tokenizer_i
+{
+public:
+	virtual ~config_tokenizer_i() {}
+
+	/**
+	 * Move to the next key and value.  The spans are valid until the
+	 * next call.
+	 * @return false at the end of the text or on a syntax error
+	 */
+	virtual bool next( std::string_view &key, std::string_view &value ) = 0;
+
+	/**
+	 * Get the line number of the last key returned, starting at 1.
+	 */
+	virtual int line() const = 0;
+
+	/**
+	 * Check if the text had a syntax error.
+	 */
+	virtual bool error() const = 0;
+};
+
+
+/**
+ * Splits configuration text into key and value spans without copying.
+ * Each line is "key = value".  The key is the first word before the
+ * first '=' and the value is the first word after it.  Lines without
+ * both a key and a value are skipped.
+ */
+class config_scanner_c final
+: public config_tokenizer_i
+{
+public:
+	/**
+	 * Construct a scanner over the given text.  The text must outlive
+	 * the scanner and the spans it returns.
+	 */
+	config_scanner_c( const char *begin, const char *end );
+
+	/**
+	 * Move to the next line with both a key and a value.
+	 * @return false at the end of the text
+	 */
+	virtual bool next( std::string_view &key, std::string_view &value );
+
+	/**
+	 * Get the line number of the last key returned, starting at 1.
+	 */
+	virtual int line() const { return m_line; }
+
+	/**
+	 * Every line is valid, lines that don't fit are just skipped.
+	 */
+	virtual bool error() const { return false; }
+
+private:
+	const char *m_pos;
+	const char *m_end;
+	int m_line;
+	int m_next_line;
+};
+
+
+/**
+ * Scans a flat JSON object, like {"port": 80, "host": "example.com"}.
+ * Strings, numbers and true are values.  An array of them gives the key
+ * once for each element.  false and null leave the key unset, since
+ * options are set just by being given.  Nested objects are a syntax
+ * error.  Values are spans of the text, except strings with escapes,
+ * which are decoded into a buffer.
+ */
+class json_scanner_c final
+: public config_tokenizer_i
+{
+public:
+	/**
+	 * Construct a scanner over the given text.  The text must outlive
+	 * the scanner.
+	 */
+	json_scanner_c( const char *begin, const char *end );
+
+	virtual bool next( std::string_view &key, std::string_view &value );
+	virtual int line() const { return m_line; }
+	virtual bool error() const { return m_state == ERROR_STATE; }
+
+private:
+	enum scan_state
+	{
+		BEGIN_STATE,
+		MEMBER_STATE,
+		AFTER_MEMBER_STATE,
+		ELEMENT_STATE,
+		AFTER_ELEMENT_STATE,
+		END_STATE,
+		DONE_STATE,
+		ERROR_STATE
+	};
+
+	void skip_space();
+	bool consume( char c );
+	bool scan_value( std::string_view &value, bool &set );
+	bool fail();
+
+	const char *m_pos;
+	const char *m_end;
+	int m_line;
+	scan_state m_state;
+	std::string_view m_key;
+	std::string m_key_buffer;
+	std::string m_value_buffer;
+};
+
+
+/**
+ * Scans the TOML subset that fits configuration options: key = value
+ * lines, # comments and [table] headers, which prefix the keys that
+ * follow them as "table.key".  Values are basic and literal strings,
+ * numbers, dates, true and single line arrays of them, which give the
+ * key once for each element.  false leaves the key unset.  Multi-line
+ * strings and arrays, inline tables and arrays of tables are syntax
+ * errors.
+ */
+class toml_scanner_c final
+: public config_tokenizer_i
+{
+public:
+	/**
+	 * Construct a scanner over the given text.  The text must outlive
+	 * the scanner.
+	 */
+	toml_scanner_c( const char *begin, const char *end );
+
+	virtual bool next( std::string_view &key, std::string_view &value );
+	virtual int line() const { return m_line; }
+	virtual bool error() const { return m_error; }
+
+	/**
+	 * Get the table set by the last [table] header.
+	 */
+	const std::string & table() const { return m_table; }
+
+private:
+	bool scan_line( std::string_view &key, std::string_view &value
+			, bool &set );
+	bool scan_value( std::string_view &value, bool &set );
+	bool scan_element( std::string_view &value, bool &set );
+	bool end_of_line();
+	bool fail();
+
+	const char *m_pos;
+	const char *m_line_end;
+	const char *m_end;
+	int m_line;
+	bool m_in_array;
+	bool m_error;
+	std::string m_table;
+	std::string_view m_key;
+	std::string m_key_buffer;
+	std::string m_value_buffer;
+};
+
+
+/**
+ * Splits a command line into args the way a shell does, for
+ * usage_c::parse_command.  Args are separated by whitespace.  Single
+ * quotes keep everything up to the next single quote.  Double quotes
+ * do the same, except \" and \\ are escapes inside them.  Outside of
+ * quotes a backslash escapes any character and a backslash newline is
+ * dropped.  Unescaped args are never longer than the line, so they're
+ * written either back over the line or into one arena the size of the
+ * line, and stay valid as long as that buffer does.
+ */
+class command_scanner_c final
+{
+public:
+	/**
+	 * Construct a scanner that unescapes args in place over
+	 * [begin, end).
+	 */
+	command_scanner_c( char *begin, char *end );
+
+	/**
+	 * Construct a scanner that unescapes args into the arena.  The
+	 * arena only grows, so reusing it for each line stops allocating
+	 * once it fits the longest line.
+	 */
+	command_scanner_c( std::string_view line, std::string &arena );
+
+	/**
+	 * Move to the next arg.
+	 * @return false at the end of the line or on an unclosed quote
+	 */
+	bool next( std::string_view &arg );
+
+	/**
+	 * Check if the line ended inside quotes or after a backslash.
+	 */
+	bool error() const { return m_error; }
+
+private:
+	bool fail();
+
+	const char *m_pos;
+	const char *m_end;
+	char *m_out;
+	bool m_error;
+};
+
+
+/**
+ * Read the rest of the input stream onto the end of the text.
+ */
+template < typename String >
+void read_text( std::istream &input, String &text )
+{
+	char chunk[ 4096 ];
+	while ( input.read( chunk, sizeof( chunk ) ) || input.gcount() ) {
+		text.append( chunk, input.gcount() );
+	}
+}
+
+
+} // end namespace
+
+#endif
@@ -0,0 +1,433 @@
+#ifndef STDOPT_SCHEMA_H
+#define STDOPT_SCHEMA_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/key_index.h>
+#include <stdopt/option.h>
+#include <stdopt/scanner.h>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace stdopt {
+
+
+/**
+ * A typed handle for an option in a config_schema_c.
+ */
+template < typename T >
+class schema_key_c
+{
+	friend class config_schema_c;
+
+public:
+	schema_key_c()
+	: m_id( -1 )
+	{}
+
+	/**
+	 * Get the id of the option in the schema.
+	 */
+	int id() const { return m_id; }
+
+private:
+	explicit schema_key_c( int id )
+	: m_id( id )
+	{}
+
+	int m_id;
+};
+
+
+/**
+ * Description of one option in a config_schema_c.
+ */
+class schema_entry_i
+{
+public:
+	virtual ~schema_entry_i() {}
+
+	/**
+	 * Get the name of this option.
+	 */
+	virtual const std::string & option_name() const = 0;
+	/**
+	 * Get the description for this option.
+	 */
+	virtual const std::string & description() const = 0;
+
+	/**
+	 * Create empty storage for values of this option.  typed is set
+	 * to the option_value_c< T > for the option's type.
+	 */
+	virtual option_value_i * create_value( void *&typed ) const = 0;
+};
+
+
+/**
+ * The schema entry for an option of type T.
+ */
+template < typename T >
+class schema_entry_c
+: public schema_entry_i
+{
+public:
+	schema_entry_c( const T &default_value, const std::string &name
+			, const std::string &desc )
+	: m_option_name( name )
+	, m_description( desc )
+	, m_default( default_value )
+	{}
+
+	virtual const std::string & option_name() const
+	{
+		return m_option_name;
+	}
+	virtual const std::string & description() const
+	{
+		return m_description;
+	}
+
+	virtual option_value_i * create_value( void *&typed ) const
+	{
+		option_value_c< T > *value( new option_value_c< T >() );
+		typed = value;
+		return value;
+	}
+
+	/**
+	 * Get the default value for this option.
+	 */
+	const T & default_value() const { return m_default; }
+
+private:
+	std::string m_option_name;
+	std::string m_description;
+	const T m_default;
+};
+
+
+/**
+ * The names, types, defaults and key index for a set of configuration
+ * options.  Options are added once while setting up.  After that the
+ * schema doesn't change and can be shared, by any number of threads,
+ * between all the config_values_c that are parsed against it.
+ */
+class config_schema_c
+{
+public:
+	config_schema_c();
+	~config_schema_c();
+
+	/**
+	 * Add an option with _no_ default value.
+	 * @return the key for reading the option's values
+	 */
+	template < typename T >
+	schema_key_c< T > add( const std::string &name, const std::string &desc )
+	{
+		return add( T(), name, desc );
+	}
+
+	/**
+	 * Add an option with a default value.
+	 * @return the key for reading the option's values
+	 */
+	template < typename T >
+	schema_key_c< T > add( const T &default_value, const std::string &name
+			, const std::string &desc )
+	{
+		return schema_key_c< T >( add_entry(
+					new schema_entry_c< T >( default_value, name
+						, desc ) ) );
+	}
+
+	/**
+	 * Find the id for an option name.
+	 * @return the id or -1 if there's no option with that name
+	 */
+	int find( std::string_view name ) const;
+
+	/**
+	 * Get the number of options in the schema.
+	 */
+	int size() const { return m_entry.size(); }
+
+	/**
+	 * Get the entry for an option id.
+	 */
+	const schema_entry_i & entry( int id ) const { return *m_entry[ id ]; }
+
+	/**
+	 * Get the default value for an option.
+	 */
+	template < typename T >
+	const T & default_value( schema_key_c< T > key ) const
+	{
+		return static_cast< const schema_entry_c< T > * >(
+				m_entry[ key.id() ] )->default_value();
+	}
+
+private:
+	config_schema_c( const config_schema_c & );
+	config_schema_c & operator = ( const config_schema_c & );
+
+	int add_entry( schema_entry_i * );
+
+	typedef std::unordered_map< std::string_view, int > index_map;
+
+	std::vector< schema_entry_i * > m_entry;
+	// views of the names owned by the entries
+	index_map m_index;
+};
+
+
+/**
+ * A problem found while parsing a configuration file.
+ */
+class config_diagnostic_c
+{
+public:
+	config_diagnostic_c( int line, std::string_view key, const char *message )
+	: m_line( line )
+	, m_key( key )
+	, m_message( message )
+	{}
+
+	/**
+	 * Get the line number of the problem, starting at 1.  It's 0 if
+	 * the problem isn't on a particular line.
+	 */
+	int line() const { return m_line; }
+	/**
+	 * Get the key on the line with the problem.
+	 */
+	const std::string & key() const { return m_key; }
+	/**
+	 * Get a description of the problem.
+	 */
+	const char * message() const { return m_message; }
+
+private:
+	int m_line;
+	std::string m_key;
+	const char *m_message;
+};
+
+
+/**
+ * One option that differs between two config_values_c.
+ */
+class config_change_c
+{
+public:
+	enum change_type
+	{
+		ADDED,
+		REMOVED,
+		CHANGED
+	};
+
+	config_change_c( change_type type, int id, std::string_view key
+			, const option_value_i *old_value
+			, const option_value_i *new_value )
+	: m_type( type )
+	, m_id( id )
+	, m_key( key )
+	, m_old_value( old_value )
+	, m_new_value( new_value )
+	{}
+
+	change_type type() const { return m_type; }
+	/**
+	 * Get the id of the option in the schema.
+	 */
+	int id() const { return m_id; }
+	/**
+	 * Get the option's name.  It points into the schema.
+	 */
+	std::string_view key() const { return m_key; }
+	/**
+	 * Get the values before the change, NULL if the option was added.
+	 */
+	const option_value_i * old_value() const { return m_old_value; }
+	/**
+	 * Get the values after the change, NULL if the option was removed.
+	 */
+	const option_value_i * new_value() const { return m_new_value; }
+
+private:
+	change_type m_type;
+	int m_id;
+	std::string_view m_key;
+	const option_value_i *m_old_value;
+	const option_value_i *m_new_value;
+};
+
+
+/**
+ * The values from one configuration file parsed against a shared
+ * config_schema_c.  Only options that were set take any memory.
+ * Options that weren't set return the schema's default.
+ */
+class config_values_c
+{
+public:
+	explicit config_values_c( const config_schema_c & );
+	config_values_c( config_values_c && );
+	~config_values_c();
+
+	/**
+	 * Parse the input from the given input stream.
+	 * @return true if the configuration was parsed successfully
+	 */
+	bool parse( std::istream &input );
+
+	/**
+	 * Parse the configuration text in [begin, end).  Unknown keys and
+	 * invalid values are errors, but parsing continues past them.
+	 * @return true if the configuration was parsed successfully
+	 */
+	bool parse( const char *begin, const char *end );
+
+	/**
+	 * Check if there was an error parsing the configuration.
+	 */
+	bool error() const { return m_error; }
+
+	/**
+	 * Get the problems found while parsing, in the order they were
+	 * found.
+	 */
+	const std::vector< config_diagnostic_c > & diagnostics() const
+	{
+		return m_diagnostic;
+	}
+
+	/**
+	 * Record a problem that wasn't found by parsing, like the file
+	 * not being readable.  Marks the values as having an error.
+	 */
+	void add_diagnostic( const config_diagnostic_c & );
+
+	/**
+	 * Forget every value and diagnostic so the values can be parsed
+	 * again.
+	 */
+	void clear();
+
+	/**
+	 * Get the schema these values were parsed against.
+	 */
+	const config_schema_c & schema() const { return *m_schema; }
+
+	/**
+	 * Get the number of options that were set.
+	 */
+	int size() const { return m_value.size(); }
+
+	/**
+	 * Check if an option was set.
+	 */
+	template < typename T >
+	bool set( schema_key_c< T > key ) const
+	{
+		const option_value_c< T > *v( values( key ) );
+		return v && v->set();
+	}
+
+	/**
+	 * Get the first value set for an option, or its default if it
+	 * wasn't set.
+	 */
+	template < typename T >
+	const T & value( schema_key_c< T > key ) const
+	{
+		const option_value_c< T > *v( values( key ) );
+		if ( ! v || ! v->set() ) {
+			return m_schema->default_value( key );
+		}
+		return v->value();
+	}
+
+	/**
+	 * Find the options that differ in updated, which must be parsed
+	 * against the same schema.  Options are compared by a hash of
+	 * their values taken while parsing, so unchanged options are
+	 * skipped without looking at their values.  Changes are appended
+	 * in id order and point into both value sets.
+	 * @return the number of changes
+	 */
+	int diff( const config_values_c &updated
+			, std::vector< config_change_c > &changes ) const;
+
+	/**
+	 * Get all the values set for an option.
+	 * @return NULL if the option wasn't set
+	 */
+	template < typename T >
+	const option_value_c< T > * values( schema_key_c< T > key ) const
+	{
+		const value_slot *slot( find_slot( key.id() ) );
+		return slot ? static_cast< const option_value_c< T > * >(
+				slot->typed ) : NULL;
+	}
+
+private:
+	config_values_c( const config_values_c & );
+	config_values_c & operator = ( const config_values_c & );
+
+	/**
+	 * Storage for an option that was set.  typed points to the
+	 * option_value_c< T > for the option's type.  hash covers the
+	 * text of every value parsed for the option, in order.
+	 */
+	struct value_slot
+	{
+		int id;
+		option_value_i *value;
+		void *typed;
+		uint64_t hash;
+	};
+	typedef std::vector< value_slot > slot_list;
+
+	/**
+	 * Order value slots by id for lower_bound.
+	 */
+	static bool slot_before( const value_slot &slot, int id )
+	{
+		return slot.id < id;
+	}
+
+	const value_slot * find_slot( int id ) const;
+	value_slot & slot_value( int id );
+	static bool same_values( const option_value_i &, const option_value_i & );
+
+	const config_schema_c *m_schema;
+	// sorted by id
+	slot_list m_value;
+	std::vector< config_diagnostic_c > m_diagnostic;
+	bool m_error;
+};
+
+
+} // end namespace
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef STDOPT_SEGMENT_H
+#define STDOPT_SEGMENT_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/configuration.h>
+#include <stdopt/usage.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace stdopt {
+
+
+/**
+ * Writes the values of parsed options into a read-only segment that
+ * other processes can map and read in place.  The segment only holds
+ * offsets, so it can be mapped at any address.  Values are copied with
+ * value_codec_c, so only trivially copyable types and strings can be
+ * exported.
+ *
+ * Write the segment once in the parent, then pass the memfd to the
+ * workers or have them open the file in /dev/shm.
+ */
+class segment_writer_c
+{
+public:
+	segment_writer_c();
+
+	/**
+	 * Add the values of one option under the given name.  An option
+	 * that wasn't set is added with its default, if it has one.
+	 * @return false if the option's type can't be exported
+	 */
+	bool add( std::string_view name, const option_value_i & );
+
+	/**
+	 * Add the values of every option in the configuration.
+	 * @return false if any option's type can't be exported
+	 */
+	bool add( const configuration_c & );
+
+	/**
+	 * Add the values of every named option in the usage.  Positional
+	 * values aren't exported.
+	 * @return false if any option's type can't be exported
+	 */
+	bool add( const usage_c & );
+
+	/**
+	 * Build the segment in a sealed memfd that can't be changed.
+	 * @return the file descriptor or -1 on error
+	 */
+	int create_memfd( const char *name ) const;
+
+	/**
+	 * Write the segment to a file, like one in /dev/shm.  The file
+	 * is written to a unique temporary name next to it and renamed
+	 * so readers never see part of it.
+	 * @return false on error
+	 */
+	bool write_file( const std::string &path ) const;
+
+	/**
+	 * Build the segment in memory.
+	 */
+	std::string build() const;
+
+private:
+	class option_entry
+	{
+	public:
+		std::string name;
+		// the byte ranges of each value in m_bytes
+		std::vector< std::pair< std::size_t, std::size_t > > values;
+	};
+
+	std::vector< option_entry > m_option;
+	std::string m_bytes;
+};
+
+
+/**
+ * Maps a segment written by segment_writer_c and reads option values
+ * straight out of it.  Option ids are the positions of the options in
+ * the segment, sorted by name.
+ */
+class segment_reader_c
+{
+public:
+	segment_reader_c();
+	~segment_reader_c();
+
+	/**
+	 * Map the segment in the file descriptor.  The descriptor can be
+	 * closed after.
+	 * @return false if it isn't a valid segment
+	 */
+	bool attach( int fd );
+
+	/**
+	 * Map the segment in the file at path.
+	 * @return false if the file can't be opened or isn't a valid segment
+	 */
+	bool attach( const std::string &path );
+
+	/**
+	 * Unmap the segment.
+	 */
+	void detach();
+
+	/**
+	 * Get the number of options in the segment.
+	 */
+	int size() const;
+
+	/**
+	 * Find the id of an option.
+	 * @return the id or -1 if the option isn't in the segment
+	 */
+	int find( std::string_view name ) const;
+
+	/**
+	 * Get the name of an option.
+	 */
+	std::string_view option_name( int id ) const;
+
+	/**
+	 * Get the number of values set for an option.
+	 */
+	int size( int id ) const;
+
+	/**
+	 * Get the bytes of the ith value of an option.
+	 */
+	std::string_view bytes( int id, int i ) const;
+
+	/**
+	 * Get the ith value of a string option.
+	 */
+	std::string_view text( int id, int i = 0 ) const { return bytes( id, i ); }
+
+	/**
+	 * Get the ith value of an option of a trivially copyable type.
+	 * @return the value in the segment or NULL if it's the wrong size
+	 */
+	template < typename T >
+	const T * value( int id, int i = 0 ) const
+	{
+		static_assert( std::is_trivially_copyable< T >::value
+				, "only trivially copyable values are read in place" );
+		std::string_view data( bytes( id, i ) );
+		if ( data.size() != sizeof( T ) ) {
+			return NULL;
+		}
+		return reinterpret_cast< const T * >( data.data() );
+	}
+
+private:
+	segment_reader_c( const segment_reader_c & );
+	segment_reader_c & operator = ( const segment_reader_c & );
+
+	const char *m_base;
+	std::size_t m_size;
+};
+
+
+} // end namespace
+
+#endif
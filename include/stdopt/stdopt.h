@@ -15,8 +15,18 @@
  * limitations under the License.
  */
 
+#include <stdopt/option.h>
+#include <stdopt/constraint.h>
+#include <stdopt/units.h>
+#include <stdopt/intern.h>
+#include <stdopt/configuration.h>
+#include <stdopt/loader.h>
 #include <stdopt/usage.h>
-#include <stdopt/config.h>
+#include <stdopt/pmr.h>
+#include <stdopt/registry.h>
+#include <stdopt/schema.h>
+#include <stdopt/segment.h>
+#include <stdopt/batch.h>
 
 #endif
 
@@ -0,0 +1,246 @@
+#ifndef STDOPT_TRACE_H
+#define STDOPT_TRACE_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+/**
+ * Tracing of the parsers' internals.  Both kinds compile to nothing
+ * unless they're turned on when building the library.
+ *
+ * With STDOPT_USDT defined, and sys/sdt.h available, USDT probes in
+ * the stdopt provider mark the start and end of each parse_args,
+ * configuration parse, configuration line and parse_value, so perf or
+ * bpftrace can attach to a running program:
+ *   bpftrace -e 'usdt:./prog:stdopt:config_line_start
+ *       { printf( "%s\n", str( arg0, arg1 ) ); }'
+ *
+ * With STDOPT_TRACE defined, the same events are timed and recorded in
+ * trace_recorder_c::global() to be dumped by the program itself.
+ */
+#if defined( STDOPT_USDT ) && defined( __has_include )
+#if __has_include( <sys/sdt.h> )
+#include <sys/sdt.h>
+#define STDOPT_USDT_ENABLED
+#endif
+#endif
+
+#ifdef STDOPT_USDT_ENABLED
+#define STDOPT_PROBE( name, key, bytes ) \
+	DTRACE_PROBE3( stdopt, name, ( key ).data(), ( key ).size(), bytes )
+#else
+#define STDOPT_PROBE( name, key, bytes )
+#endif
+
+#ifdef STDOPT_TRACE
+#define STDOPT_TRACE_START( timer ) \
+	const std::uint64_t timer( stdopt::trace_clock() )
+#define STDOPT_TRACE_RECORD( timer, event, key, bytes ) \
+	stdopt::trace_recorder_c::global().record( event, key, bytes \
+			, stdopt::trace_clock() - timer )
+#else
+#define STDOPT_TRACE_START( timer )
+#define STDOPT_TRACE_RECORD( timer, event, key, bytes )
+#endif
+
+/**
+ * Mark the start of a traced event.  key is a std::string_view and
+ * bytes is the size of the input the event covers.
+ */
+#define STDOPT_EVENT_START( name, timer, key, bytes ) \
+	STDOPT_PROBE( name##_start, key, bytes ); \
+	STDOPT_TRACE_START( timer )
+
+/**
+ * Mark the end of a traced event started with STDOPT_EVENT_START.
+ */
+#define STDOPT_EVENT_END( name, timer, key, bytes ) \
+	STDOPT_PROBE( name##_end, key, bytes ); \
+	STDOPT_TRACE_RECORD( timer, #name, key, bytes )
+
+namespace stdopt {
+
+
+/**
+ * Get a monotonic time in nanoseconds for timing trace events.
+ */
+inline std::uint64_t trace_clock()
+{
+	return std::chrono::duration_cast< std::chrono::nanoseconds >(
+			std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+/**
+ * One recorded trace event.  Keys longer than the event can hold are
+ * cut short.
+ */
+class trace_event_c
+{
+public:
+	static constexpr std::size_t MAX_KEY = 47;
+
+	trace_event_c();
+
+	/**
+	 * Fill in the event.  event must be a string literal.
+	 */
+	void set( const char *event, std::string_view key, std::size_t bytes
+			, std::uint64_t nanoseconds );
+
+	const char * event() const { return m_event; }
+	std::string_view key() const
+	{
+		return std::string_view( m_key, m_key_length );
+	}
+	std::size_t bytes() const { return m_bytes; }
+	std::uint64_t nanoseconds() const { return m_nanoseconds; }
+
+private:
+	const char *m_event;
+	std::size_t m_bytes;
+	std::uint64_t m_nanoseconds;
+	unsigned char m_key_length;
+	char m_key[ MAX_KEY ];
+};
+
+
+/**
+ * A fixed size ring buffer of trace events.  Recording never
+ * allocates and, once the ring is full, overwrites the oldest events.
+ *
+ * Every method can be called from any number of threads at once.
+ * Each slot in the ring has a sequence number, seqlock style: a
+ * recording thread claims the slot before writing it, and readers
+ * copy an event out and check the sequence didn't move.  An event
+ * that's being written or overwritten while it's read is skipped
+ * instead of read torn.  When two threads wrap onto the same slot,
+ * the newer event wins.
+ */
+class trace_recorder_c
+{
+public:
+	/**
+	 * Construct a recorder that keeps the last capacity events.
+	 */
+	explicit trace_recorder_c( std::size_t capacity = 4096 );
+
+	/**
+	 * Get the recorder the parsers record to when built with
+	 * STDOPT_TRACE.
+	 */
+	static trace_recorder_c & global();
+
+	/**
+	 * Record an event.  event must be a string literal.
+	 */
+	void record( const char *event, std::string_view key, std::size_t bytes
+			, std::uint64_t nanoseconds );
+
+	/**
+	 * Get the number of events kept, at most the capacity.
+	 */
+	std::size_t size() const;
+
+	/**
+	 * Get the total number of events recorded since the last clear,
+	 * including the ones that were overwritten.
+	 */
+	std::uint64_t recorded() const
+	{
+		return m_next.load( std::memory_order_acquire )
+			- m_first.load( std::memory_order_acquire );
+	}
+
+	/**
+	 * Get a copy of a kept event, oldest first.  An event that's
+	 * being written or was overwritten since size() was called comes
+	 * back empty, with an event name of "".
+	 */
+	trace_event_c event( std::size_t i ) const;
+
+	/**
+	 * Write the kept events, oldest first, one per line as
+	 *   event key bytes nanoseconds
+	 * with a - for an empty key.  Events that are being written are
+	 * left out.
+	 */
+	void dump( std::ostream & ) const;
+
+	/**
+	 * Forget all the events.  Events recorded before the clear
+	 * aren't kept, even if they're still being written.
+	 */
+	void clear()
+	{
+		m_first.store( m_next.load( std::memory_order_acquire )
+				, std::memory_order_release );
+	}
+
+private:
+	trace_recorder_c( const trace_recorder_c & );
+	trace_recorder_c & operator = ( const trace_recorder_c & );
+
+	// the key and its length, packed in words so they can be copied
+	// with atomic loads and stores
+	static constexpr std::size_t KEY_WORDS = ( trace_event_c::MAX_KEY + 1 )
+		/ sizeof( std::uint64_t );
+
+	/**
+	 * One event in the ring.  Its sequence is 2 * ( n + 1 ) once event
+	 * n is written to it, one more while event n is being written, or
+	 * 0 if nothing has been written to it.
+	 */
+	class slot
+	{
+	public:
+		slot();
+
+		std::atomic< std::uint64_t > sequence;
+		std::atomic< const char * > event;
+		std::atomic< std::uint64_t > bytes;
+		std::atomic< std::uint64_t > nanoseconds;
+		std::atomic< std::uint64_t > key[ KEY_WORDS ];
+	};
+
+	/**
+	 * Copy the event numbered n out of its slot.
+	 * @return false if the slot holds a different event or it was
+	 * being written
+	 */
+	bool read( std::uint64_t n, trace_event_c & ) const;
+	/**
+	 * Get the number of the oldest event still kept.
+	 */
+	std::uint64_t oldest() const;
+
+	std::vector< slot > m_slot;
+	// the number of the next event to record
+	std::atomic< std::uint64_t > m_next;
+	// the number of the first event since the last clear
+	std::atomic< std::uint64_t > m_first;
+};
+
+
+} // end namespace
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef STDOPT_UNITS_H
+#define STDOPT_UNITS_H
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdopt/option.h>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <ostream>
+#include <stdint.h>
+
+namespace stdopt {
+
+
+/**
+ * A size in bytes.  Parsed from a number with an optional unit suffix.
+ * Suffixes are case insensitive.
+ *   b           bytes
+ *   k, kib      1024 bytes
+ *   kb          1000 bytes
+ * and likewise for m, g, t and p.  ie. 4GiB, 512k, 1.5MB
+ */
+class byte_size_c
+{
+public:
+	byte_size_c()
+	: m_bytes( 0 )
+	{}
+
+	explicit byte_size_c( uint64_t bytes )
+	: m_bytes( bytes )
+	{}
+
+	/**
+	 * Get the number of bytes.
+	 */
+	uint64_t bytes() const { return m_bytes; }
+
+	bool operator == ( const byte_size_c &s ) const
+	{
+		return m_bytes == s.m_bytes;
+	}
+	bool operator != ( const byte_size_c &s ) const
+	{
+		return m_bytes != s.m_bytes;
+	}
+	bool operator < ( const byte_size_c &s ) const
+	{
+		return m_bytes < s.m_bytes;
+	}
+
+private:
+	uint64_t m_bytes;
+};
+
+/**
+ * A rate of events per second.  Parsed from a count with an optional
+ * k, M or G multiplier and an optional /unit time period using the
+ * duration units.  With no period it's per second.
+ * ie. 10k/s, 500/ms, 3M/h
+ */
+class rate_c
+{
+public:
+	rate_c()
+	: m_per_second( 0 )
+	{}
+
+	explicit rate_c( double per_second )
+	: m_per_second( per_second )
+	{}
+
+	/**
+	 * Get the number of events per second.
+	 */
+	double per_second() const { return m_per_second; }
+
+	bool operator == ( const rate_c &r ) const
+	{
+		return m_per_second == r.m_per_second;
+	}
+	bool operator != ( const rate_c &r ) const
+	{
+		return m_per_second != r.m_per_second;
+	}
+	bool operator < ( const rate_c &r ) const
+	{
+		return m_per_second < r.m_per_second;
+	}
+
+private:
+	double m_per_second;
+};
+
+
+/**
+ * Parse a byte size such as "4GiB".  These parsers work directly on
+ * the characters and don't allocate.
+ * @return false if it's not a valid byte size
+ */
+bool parse_byte_size( const char *begin, const char *end, uint64_t &bytes );
+
+/**
+ * Parse a duration such as "250ms" into a count of units that are
+ * unit_ns nanoseconds long.  A number without a suffix is already a
+ * count of units.  The duration suffixes are
+ *   ns, us, ms, s, m or min, h, d
+ * @return false if it's not a valid duration
+ */
+bool parse_duration( const char *begin, const char *end, long double unit_ns
+		, long double &count );
+
+/**
+ * Parse a rate such as "10k/s" into events per second.
+ * @return false if it's not a valid rate
+ */
+bool parse_rate( const char *begin, const char *end, double &per_second );
+
+
+template <>
+class value_parser_c< byte_size_c >
+{
+public:
+	static bool parse( const std::string &str_value, byte_size_c &value );
+};
+
+template <>
+class value_parser_c< rate_c >
+{
+public:
+	static bool parse( const std::string &str_value, rate_c &value );
+};
+
+/**
+ * Parse any std::chrono::duration.  Values with a suffix are converted
+ * to the duration's period and must be a whole number of its ticks
+ * if it counts with an integer.  ie. "1500us" is an error for
+ * std::chrono::milliseconds.
+ */
+template < typename Rep, typename Period >
+class value_parser_c< std::chrono::duration< Rep, Period > >
+{
+public:
+	static bool parse( const std::string &str_value
+			, std::chrono::duration< Rep, Period > &value )
+	{
+		const long double unit_ns( 1e9L * Period::num / Period::den );
+		const char *begin( str_value.data() );
+		long double count;
+		if ( ! parse_duration( begin, begin + str_value.size(), unit_ns
+					, count ) ) {
+			return false;
+		}
+
+		if ( std::numeric_limits< Rep >::is_integer ) {
+			long double whole( std::floor( count + 0.5L ) );
+			if ( std::fabs( count - whole ) > 1e-9L * ( whole + 1 ) ) {
+				// not a whole number of ticks
+				return false;
+			}
+			count = whole;
+		}
+		if ( count > (long double) std::numeric_limits< Rep >::max() ) {
+			return false;
+		}
+
+		value = std::chrono::duration< Rep, Period >(
+				static_cast< Rep >( count ) );
+		return true;
+	}
+};
+
+
+/**
+ * Write the byte size with the largest binary unit that divides it.
+ */
+std::ostream & operator << ( std::ostream &, const byte_size_c & );
+
+/**
+ * Write the rate as events per second.
+ */
+std::ostream & operator << ( std::ostream &, const rate_c & );
+
+
+} // end namespace
+
+#endif
@@ -16,8 +16,13 @@
  */
 
 #include <stdopt/option.h>
+#include <stdopt/scanner.h>
+#include <cstdint>
 #include <list>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace stdopt {
 
@@ -25,55 +30,85 @@ namespace stdopt {
 /**
  * An option that can be set on the command line.
  */
-template < typename T >
+template < typename T, typename Alloc = std::allocator< T > >
 class usage_option_c
-: public option_value_c< T >
+: public option_value_c< T, Alloc >
 , virtual public usage_option_i
 {
 public:
 	/**
-	 * Construct the config option.  The name is the key in the
-	 * configuration file.
+	 * Construct the usage option.  The name is the long option on the
+	 * command line.
 	 */
 	usage_option_c( char short_opt, const std::string &name
-			, const std::string &desc = std::string() )
-	: option_value_c< T >()
-	, m_option_name( name )
-	, m_description( desc )
-	, m_usage_char( short_opt )
+			, const std::string &desc = std::string()
+			, const Alloc &alloc = Alloc() )
+	: option_value_c< T, Alloc >( alloc )
+	, m_descriptor( short_opt, name, desc )
 	{}
 
 	/**
-	 * Construct the config option with a default value.  The name
-	 * is the key in the configuration file.
+	 * Construct the usage option with a default value.  The name is
+	 * the long option on the command line.
 	 */
 	usage_option_c( const T &default_value, char short_opt
 			, const std::string &name
-			, const std::string &desc = std::string() )
-	: option_value_c< T >( default_value )
-	, m_option_name( name )
-	, m_description( desc )
-	, m_usage_char( short_opt )
+			, const std::string &desc = std::string()
+			, const Alloc &alloc = Alloc() )
+	: option_value_c< T, Alloc >( default_value, alloc )
+	, m_descriptor( short_opt, name, desc )
+	{}
+
+	/**
+	 * Construct the usage option from a descriptor that outlives it,
+	 * usually a static constexpr one.
+	 */
+	explicit usage_option_c( const option_descriptor_c &descriptor
+			, const Alloc &alloc = Alloc() )
+	: option_value_c< T, Alloc >( alloc )
+	, m_descriptor( descriptor )
+	{}
+
+	/**
+	 * Construct the usage option with a default value from a
+	 * descriptor that outlives it.
+	 */
+	usage_option_c( const T &default_value
+			, const option_descriptor_c &descriptor
+			, const Alloc &alloc = Alloc() )
+	: option_value_c< T, Alloc >( default_value, alloc )
+	, m_descriptor( descriptor )
 	{}
 
 
 	/**
 	 * Get the character value for this option.
 	 */
-	virtual char usage_character() const { return m_usage_char; }
+	virtual char usage_character() const
+	{
+		return m_descriptor.usage_character();
+	}
 	/**
 	 * Get the name of this option.
 	 */
 	virtual const std::string & option_name() const
 	{
-		return m_option_name;
+		return m_descriptor.name_string();
+	}
+	virtual std::string_view option_name_view() const
+	{
+		return m_descriptor.option_name();
 	}
 	/**
 	 * Get the description for this option.
 	 */
 	virtual const std::string & description() const
 	{
-		return m_description;
+		return m_descriptor.description_string();
+	}
+	virtual std::string_view description_view() const
+	{
+		return m_descriptor.description();
 	}
 
 	/**
@@ -85,13 +120,27 @@ public:
 		return usage_option_i::type_requires_param< T >();
 	}
 
-private:
-	std::string m_option_name;
-	std::string m_description;
+	/**
+	 * Get the bytes held by the option, including its owned name and
+	 * description.
+	 */
+	virtual option_memory_c memory() const
+	{
+		option_memory_c bytes( option_value_c< T, Alloc >::memory() );
+		bytes.inline_bytes = sizeof( *this );
+		bytes.heap_bytes += m_descriptor.heap_bytes();
+		return bytes;
+	}
 
-	char m_usage_char;
+private:
+	descriptor_ref_c m_descriptor;
 };
 
+template < typename T, typename Alloc >
+class typed_option_traits_c< usage_option_c< T, Alloc > >
+: public std::true_type
+{};
+
 
 template < typename T >
 class positional_value_c
@@ -114,19 +163,50 @@ public:
 class usage_c
 {
 	friend class usage_doc_c;
-	typedef std::list< usage_option_i * > option_list;
-	typedef std::list< option_value_i * > positional_list;
+	friend class segment_writer_c;
+	typedef std::pmr::vector< option_record_c > option_list;
+	typedef std::pmr::list< option_value_i * > positional_list;
 
 public:
 	/**
 	 * Construct an empty arg parser
 	 */
-	usage_c() {}
+	usage_c();
+
+	/**
+	 * Construct an empty arg parser that allocates from the given
+	 * memory resource.
+	 */
+	explicit usage_c( std::pmr::memory_resource * );
+
+	/**
+	 * Get the memory resource the usage allocates from.
+	 * Pass it to pmr options to keep their values in it as well.
+	 */
+	std::pmr::memory_resource * resource() const
+	{
+		return m_option.get_allocator().resource();
+	}
 
 	/**
 	 * Add a usage option.
 	 */
-	void add( usage_option_i & );
+	void add( usage_option_i &option )
+	{
+		add_record( option_record_c( option ) );
+	}
+
+	/**
+	 * Add one of this library's option classes.  Its values are
+	 * parsed without going through the virtual option interface.
+	 */
+	template < typename Option >
+	typename std::enable_if< typed_option_traits_c< Option >::value
+		&& std::is_base_of< usage_option_i, Option >::value >::type
+	add( Option &option )
+	{
+		add_record( option_record_c( option ) );
+	}
 
 	/**
 	 * Add a positional option.
@@ -143,48 +223,184 @@ public:
 	 */
 	bool parse_args( int argc, const char **argv );
 
+	/**
+	 * Parse the args in a command line, split the way a shell splits
+	 * them by command_scanner_c.  The first arg is the command, same
+	 * as argv[0].  Args are unescaped into a buffer the usage keeps,
+	 * so parsing lines no longer than earlier ones doesn't allocate.
+	 * @return true if the line was split and parsed successfully
+	 */
+	bool parse_command( std::string_view line );
+
+	/**
+	 * Parse the args in the command line in [begin, end), unescaping
+	 * them in place over the line.
+	 */
+	bool parse_command( char *begin, char *end );
+
 	/**
 	 * Check if there was an error parsing the options.
 	 */
 	bool error() const { return m_error; }
 
+	/**
+	 * Check if the error was a long option given as a prefix of more
+	 * than one option's name, as opposed to an unknown option.
+	 */
+	bool ambiguous() const { return m_ambiguous; }
+
+	/**
+	 * Clear the error and the values parsed from args, so the usage
+	 * can parse another set of args.  The options stay added and
+	 * their storage, the lookup index and the parse buffers are all
+	 * kept, so parsing similar args again doesn't allocate.
+	 */
+	void reset();
+
+	/**
+	 * Get the bytes held by all the options and positional values,
+	 * plus the usage object and its own tables and buffers.
+	 */
+	option_memory_c memory() const;
+
+	/**
+	 * Write the bytes held by each option and the totals in the
+	 * Prometheus text format, with metric names starting with prefix:
+	 *   stdopt_usage_option_bytes{option="port",storage="inline"} 96
+	 *   stdopt_usage_bytes{storage="heap"} 512
+	 * Options without a long name are labeled with their short
+	 * character and positional values with #1, #2 and so on.
+	 */
+	void write_memory( std::ostream &
+			, std::string_view prefix = "stdopt_usage" ) const;
+
+	/**
+	 * Find all options with a long name starting with the given prefix.
+	 * Matches are appended in sorted order.
+	 * @return the number of matching options
+	 */
+	int complete( const std::string &prefix
+			, std::vector< const usage_option_i * > &matches ) const;
+
+	/**
+	 * Answer a shell completion query if the args are of the form
+	 *   program --complete <prefix>
+	 * Each matching long option is written to the output on its
+	 * own line.
+	 * @return true if the args were a completion query
+	 */
+	bool complete_args( int argc, const char **argv
+			, std::ostream &output ) const;
+
 private:
-	static bool short_style_arg( const char *arg );
-	static bool long_style_arg( const char *arg );
+	class argv_scanner_c;
+
+	void add_record( const option_record_c & );
+	/**
+	 * Get a generation no other usage has had, so documents know when
+	 * to render again.
+	 */
+	static uint64_t next_generation();
+	/**
+	 * Get the bytes held by the usage object, its tables and
+	 * buffers, without the options.
+	 */
+	option_memory_c table_memory() const;
 
-	void parse_short_args( const std::string &args
-			, const std::string &param, bool &consumed_param );
-	void parse_long_arg( const std::string &arg );
+	static bool short_style_arg( std::string_view arg );
+	static bool long_style_arg( std::string_view arg );
+
+	/**
+	 * Parse the args from any scanner with next( std::string_view & ).
+	 */
+	template < typename Args >
+	bool parse_tokens( Args & );
+	void parse_short_args( std::string_view args, std::string_view param
+			, bool &consumed_param );
+	void parse_long_arg( std::string_view arg );
 
 	/**
 	 * search for an option given a short style character
 	 */
-	usage_option_i * find_short_option( char short_opt );
+	const option_record_c * find_short_option( char short_opt ) const;
+	/**
+	 * search for an option given a long style string.  Unique prefixes
+	 * of an option's long name are accepted.  Ambiguous prefixes
+	 * return NULL, same as unknown options, and set ambiguous.
+	 */
+	const option_record_c * find_long_option( std::string_view long_opt
+			, bool &ambiguous ) const;
+
 	/**
-	 * search for an option given a long style string
+	 * Get the options with long names, sorted by long name.
 	 */
-	usage_option_i * find_long_option( const std::string &long_opt );
+	const option_list & long_index() const;
 
 	option_list m_option;
 	positional_list m_positional;
+	// copies of the records with long names
+	mutable option_list m_long_index;
+	mutable bool m_long_index_sorted;
+	// holds each value while it's parsed, reused between args
+	std::string m_value_buffer;
+	// the unescaped args of the last command line
+	std::string m_command_buffer;
+	// changes whenever options are added
+	uint64_t m_generation;
 	bool m_error;
+	bool m_ambiguous;
 };
 
 
 /**
  * Class for formating usage options into a usable online document.
- * Consider modifying it to write a man page as well.
+ * The plain text document is laid out once and cached so writing it
+ * again is a single write to the stream.
  */
 class usage_doc_c
 {
 public:
 	/**
-	 * Build a usage document for all options.
-	 * This should be a separate class.
+	 * Construct a usage document for the given program name.
+	 */
+	usage_doc_c( const std::string &program = std::string() );
+
+	/**
+	 * Write the plain text usage document for all options.
 	 */
 	void write( const usage_c &, std::ostream & ) const;
 
+	/**
+	 * Write the usage document for all options as a roff man page.
+	 */
+	void write_man( const usage_c &, std::ostream & ) const;
+
+	/**
+	 * Write a bash completion script for the program.  The script
+	 * gets long options from the program's --complete query.
+	 */
+	void write_bash_completion( std::ostream & ) const;
+
+	/**
+	 * Write a zsh completion script for the program.  The script
+	 * gets long options from the program's --complete query.
+	 */
+	void write_zsh_completion( std::ostream & ) const;
+
+	/**
+	 * Get the rendered plain text document.  It's only rendered again
+	 * when a different usage is given or options have been added.
+	 */
+	const std::string & text( const usage_c & ) const;
+
 private:
+	void render_text( const usage_c & ) const;
+
+	std::string m_program;
+
+	mutable std::string m_text;
+	// the generation of the usage the text was rendered from
+	mutable uint64_t m_rendered_generation;
 };
 
 
@@ -0,0 +1,160 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/intern.h"
+#include <cstring>
+
+using namespace stdopt;
+
+
+STDOPT_INLINE
+interned_string_c::interned_string_c()
+: m_pool( NULL )
+, m_data( string_pool_c::EMPTY )
+, m_size( 0 )
+{}
+
+STDOPT_INLINE
+interned_string_c::interned_string_c( string_pool_c &pool )
+: m_pool( &pool )
+, m_data( string_pool_c::EMPTY )
+, m_size( 0 )
+{}
+
+STDOPT_INLINE
+string_pool_c & interned_string_c::pool() const
+{
+	return m_pool ? *m_pool : string_pool_c::global();
+}
+
+
+STDOPT_INLINE
+string_pool_c::string_pool_c( std::size_t block_size )
+: m_mutex()
+, m_entry()
+, m_slot()
+, m_block()
+, m_block_size( block_size ? block_size : 1 )
+, m_block_used( block_size )
+, m_block_bytes( 0 )
+{}
+
+STDOPT_INLINE
+string_pool_c & string_pool_c::global()
+{
+	static string_pool_c pool;
+	return pool;
+}
+
+STDOPT_INLINE
+interned_string_c string_pool_c::intern( std::string_view str )
+{
+	if ( str.empty() ) {
+		return interned_string_c( *this );
+	}
+	uint64_t hash( key_index_c::hash( str ) );
+
+	std::lock_guard< std::mutex > lock( m_mutex );
+	if ( ( m_entry.size() + 1 ) * 2 > m_slot.size() ) {
+		rehash( m_slot.empty() ? 64 : m_slot.size() * 2 );
+	}
+	std::size_t mask( m_slot.size() - 1 );
+	std::size_t slot( hash & mask );
+	for ( ; m_slot[ slot ] >= 0; slot = ( slot + 1 ) & mask ) {
+		const entry &e( m_entry[ m_slot[ slot ] ] );
+		if ( e.hash == hash && std::string_view( e.data, e.size ) == str ) {
+			return interned_string_c( this, e.data, e.size );
+		}
+	}
+
+	entry e;
+	e.data = copy( str );
+	e.size = str.size();
+	e.hash = hash;
+	m_slot[ slot ] = m_entry.size();
+	m_entry.push_back( e );
+	return interned_string_c( this, e.data, e.size );
+}
+
+STDOPT_INLINE
+std::size_t string_pool_c::size() const
+{
+	std::lock_guard< std::mutex > lock( m_mutex );
+	return m_entry.size();
+}
+
+STDOPT_INLINE
+std::size_t string_pool_c::heap_bytes() const
+{
+	std::lock_guard< std::mutex > lock( m_mutex );
+	return m_block_bytes + m_entry.capacity() * sizeof( entry )
+		+ m_slot.capacity() * sizeof( int )
+		+ m_block.capacity() * sizeof( std::unique_ptr< char[] > );
+}
+
+STDOPT_INLINE
+const char * string_pool_c::copy( std::string_view str )
+{
+	char *chars;
+	if ( str.size() > m_block_size / 4 ) {
+		// long strings get their own block, so they don't waste the
+		// rest of the current one
+		chars = new char[ str.size() ];
+		m_block.insert( m_block.end() - ( m_block.empty() ? 0 : 1 )
+				, std::unique_ptr< char[] >( chars ) );
+		m_block_bytes += str.size();
+	} else {
+		if ( m_block_used + str.size() > m_block_size ) {
+			m_block.push_back( std::unique_ptr< char[] >(
+						new char[ m_block_size ] ) );
+			m_block_used = 0;
+			m_block_bytes += m_block_size;
+		}
+		chars = m_block.back().get() + m_block_used;
+		m_block_used += str.size();
+	}
+	memcpy( chars, str.data(), str.size() );
+	return chars;
+}
+
+STDOPT_INLINE
+void string_pool_c::rehash( std::size_t slots )
+{
+	m_slot.assign( slots, -1 );
+	std::size_t mask( slots - 1 );
+	for ( std::size_t id(0); id<m_entry.size(); ++id ) {
+		std::size_t slot( m_entry[ id ].hash & mask );
+		while ( m_slot[ slot ] >= 0 ) {
+			slot = ( slot + 1 ) & mask;
+		}
+		m_slot[ slot ] = id;
+	}
+}
+
+
+STDOPT_INLINE
+bool value_parser_c< interned_string_c >::parse( const std::string &str_value
+		, interned_string_c &value )
+{
+	value = value.pool().intern( str_value );
+	return true;
+}
+
+STDOPT_INLINE
+std::ostream & stdopt::operator << ( std::ostream &out
+		, const interned_string_c &value )
+{
+	return out.write( value.data(), value.size() );
+}
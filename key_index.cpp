@@ -0,0 +1,98 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/key_index.h"
+
+using namespace stdopt;
+
+
+STDOPT_INLINE
+key_index_c::key_index_c()
+: m_key()
+, m_slot()
+{}
+
+STDOPT_INLINE
+key_index_c::key_index_c( std::pmr::memory_resource *resource )
+: m_key( resource )
+, m_slot( resource )
+{}
+
+STDOPT_INLINE
+int key_index_c::insert( std::string_view key )
+{
+	if ( ( m_key.size() + 1 ) * 2 > m_slot.size() ) {
+		rehash( m_slot.empty() ? 16 : m_slot.size() * 2 );
+	}
+
+	std::size_t slot( find_slot( key ) );
+	if ( m_slot[ slot ] < 0 ) {
+		m_slot[ slot ] = m_key.size();
+		m_key.emplace_back( key );
+	}
+	return m_slot[ slot ];
+}
+
+STDOPT_INLINE
+int key_index_c::find( std::string_view key ) const
+{
+	if ( m_slot.empty() ) {
+		return -1;
+	}
+	return m_slot[ find_slot( key ) ];
+}
+
+STDOPT_INLINE
+std::size_t key_index_c::heap_bytes() const
+{
+	std::size_t bytes( m_key.capacity() * sizeof( std::pmr::string )
+			+ m_slot.capacity() * sizeof( int ) );
+	for ( std::size_t i(0); i<m_key.size(); ++i ) {
+		bytes += value_footprint_c< std::pmr::string >::heap_bytes(
+				m_key[ i ] );
+	}
+	return bytes;
+}
+
+STDOPT_INLINE
+uint64_t key_index_c::hash( std::string_view key )
+{
+	uint64_t h( 14695981039346656037ull );
+	for ( std::size_t i(0); i<key.size(); ++i ) {
+		h ^= static_cast< unsigned char >( key[i] );
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+STDOPT_INLINE
+std::size_t key_index_c::find_slot( std::string_view key ) const
+{
+	std::size_t mask( m_slot.size() - 1 );
+	std::size_t slot( hash( key ) & mask );
+	while ( m_slot[ slot ] >= 0 && m_key[ m_slot[ slot ] ] != key ) {
+		slot = ( slot + 1 ) & mask;
+	}
+	return slot;
+}
+
+STDOPT_INLINE
+void key_index_c::rehash( std::size_t slots )
+{
+	m_slot.assign( slots, -1 );
+	for ( std::size_t id(0); id<m_key.size(); ++id ) {
+		m_slot[ find_slot( m_key[ id ] ) ] = id;
+	}
+}
@@ -0,0 +1,516 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/loader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined( __linux__ ) && __has_include( <linux/io_uring.h> )
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define STDOPT_IO_URING
+#endif
+
+using namespace stdopt;
+
+
+#ifdef STDOPT_IO_URING
+/**
+ * Just enough of an io_uring to queue reads and wait for them, using
+ * the raw system calls so there's no dependency on liburing.
+ */
+class io_uring_ring_c
+{
+public:
+	explicit io_uring_ring_c( unsigned entries )
+	: m_fd( -1 )
+	, m_sq( MAP_FAILED )
+	, m_cq( MAP_FAILED )
+	, m_sqes( MAP_FAILED )
+	, m_sq_size( 0 )
+	, m_cq_size( 0 )
+	, m_sqes_size( 0 )
+	{
+		io_uring_params params;
+		memset( &params, 0, sizeof( params ) );
+		m_fd = syscall( __NR_io_uring_setup, entries, &params );
+		if ( m_fd < 0 ) {
+			return;
+		}
+
+		m_sq_size = params.sq_off.array
+			+ params.sq_entries * sizeof( unsigned );
+		m_cq_size = params.cq_off.cqes
+			+ params.cq_entries * sizeof( io_uring_cqe );
+		bool single_mmap( params.features & IORING_FEAT_SINGLE_MMAP );
+		if ( single_mmap && m_cq_size > m_sq_size ) {
+			m_sq_size = m_cq_size;
+		}
+		m_sq = mmap( 0, m_sq_size, PROT_READ | PROT_WRITE
+				, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING );
+		if ( m_sq == MAP_FAILED ) {
+			return;
+		}
+		if ( single_mmap ) {
+			m_cq = m_sq;
+		} else {
+			m_cq = mmap( 0, m_cq_size, PROT_READ | PROT_WRITE
+					, MAP_SHARED | MAP_POPULATE, m_fd
+					, IORING_OFF_CQ_RING );
+			if ( m_cq == MAP_FAILED ) {
+				return;
+			}
+		}
+		m_sqes_size = params.sq_entries * sizeof( io_uring_sqe );
+		m_sqes = mmap( 0, m_sqes_size, PROT_READ | PROT_WRITE
+				, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES );
+		if ( m_sqes == MAP_FAILED ) {
+			return;
+		}
+
+		char *sq( static_cast< char * >( m_sq ) );
+		m_sq_tail = reinterpret_cast< unsigned * >( sq
+				+ params.sq_off.tail );
+		m_sq_mask = *reinterpret_cast< unsigned * >( sq
+				+ params.sq_off.ring_mask );
+		m_sq_array = reinterpret_cast< unsigned * >( sq
+				+ params.sq_off.array );
+		char *cq( static_cast< char * >( m_cq ) );
+		m_cq_head = reinterpret_cast< unsigned * >( cq
+				+ params.cq_off.head );
+		m_cq_tail = reinterpret_cast< unsigned * >( cq
+				+ params.cq_off.tail );
+		m_cq_mask = *reinterpret_cast< unsigned * >( cq
+				+ params.cq_off.ring_mask );
+		m_cqes = reinterpret_cast< io_uring_cqe * >( cq
+				+ params.cq_off.cqes );
+	}
+
+	~io_uring_ring_c()
+	{
+		if ( m_sqes != MAP_FAILED ) {
+			munmap( m_sqes, m_sqes_size );
+		}
+		if ( m_cq != MAP_FAILED && m_cq != m_sq ) {
+			munmap( m_cq, m_cq_size );
+		}
+		if ( m_sq != MAP_FAILED ) {
+			munmap( m_sq, m_sq_size );
+		}
+		if ( m_fd >= 0 ) {
+			close( m_fd );
+		}
+	}
+
+	/**
+	 * Check if the ring was set up.
+	 */
+	bool ready() const { return m_sqes != MAP_FAILED; }
+
+	/**
+	 * Queue a read.  It's not submitted until enter() is called.
+	 */
+	void queue_read( int fd, char *buffer, unsigned size, uint64_t offset
+			, uint64_t user_data )
+	{
+		unsigned tail( *m_sq_tail );
+		unsigned index( tail & m_sq_mask );
+		io_uring_sqe &sqe( static_cast< io_uring_sqe * >( m_sqes )[ index ] );
+		memset( &sqe, 0, sizeof( sqe ) );
+		sqe.opcode = IORING_OP_READ;
+		sqe.fd = fd;
+		sqe.addr = reinterpret_cast< uint64_t >( buffer );
+		sqe.len = size;
+		sqe.off = offset;
+		sqe.user_data = user_data;
+		m_sq_array[ index ] = index;
+		__atomic_store_n( m_sq_tail, tail + 1, __ATOMIC_RELEASE );
+	}
+
+	/**
+	 * Submit the queued reads and wait for at least one completion.
+	 * @return false if the kernel rejected the call
+	 */
+	bool enter( unsigned submit )
+	{
+		for ( ;; ) {
+			int result( syscall( __NR_io_uring_enter, m_fd, submit, 1
+						, IORING_ENTER_GETEVENTS, NULL, 0 ) );
+			if ( result >= 0 ) {
+				return true;
+			}
+			if ( errno != EINTR ) {
+				return false;
+			}
+		}
+	}
+
+	/**
+	 * Take the next completion if there is one.
+	 */
+	bool next_completion( uint64_t &user_data, int &result )
+	{
+		unsigned head( *m_cq_head );
+		if ( head == __atomic_load_n( m_cq_tail, __ATOMIC_ACQUIRE ) ) {
+			return false;
+		}
+		const io_uring_cqe &cqe( m_cqes[ head & m_cq_mask ] );
+		user_data = cqe.user_data;
+		result = cqe.res;
+		__atomic_store_n( m_cq_head, head + 1, __ATOMIC_RELEASE );
+		return true;
+	}
+
+private:
+	int m_fd;
+	void *m_sq;
+	void *m_cq;
+	void *m_sqes;
+	std::size_t m_sq_size;
+	std::size_t m_cq_size;
+	std::size_t m_sqes_size;
+
+	unsigned *m_sq_tail;
+	unsigned m_sq_mask;
+	unsigned *m_sq_array;
+	unsigned *m_cq_head;
+	unsigned *m_cq_tail;
+	unsigned m_cq_mask;
+	io_uring_cqe *m_cqes;
+};
+#endif
+
+/**
+ * The threads that run loads.  Workers are started as loads are queued
+ * while none is idle, up to MAX_WORKERS, and kept until the program
+ * exits.  Loads mostly wait for I/O, so the limit doesn't follow the
+ * number of cores.
+ */
+class config_loader_c::worker_pool_c
+{
+public:
+	worker_pool_c()
+	: m_job()
+	, m_worker()
+	, m_mutex()
+	, m_ready()
+	, m_idle( 0 )
+	, m_stop( false )
+	{}
+
+	/**
+	 * Run the queued loads and join the workers.
+	 */
+	~worker_pool_c()
+	{
+		{
+			std::lock_guard< std::mutex > lock( m_mutex );
+			m_stop = true;
+		}
+		m_ready.notify_all();
+		for ( std::size_t i(0); i<m_worker.size(); ++i ) {
+			m_worker[ i ].join();
+		}
+	}
+
+	/**
+	 * Queue a job for the next free worker.
+	 */
+	void post( std::function< void () > job )
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_job.push_back( std::move( job ) );
+		if ( m_idle == 0 && m_worker.size() < MAX_WORKERS ) {
+			m_worker.emplace_back( &worker_pool_c::run, this );
+		} else {
+			m_ready.notify_one();
+		}
+	}
+
+private:
+	static const std::size_t MAX_WORKERS = 4;
+
+	void run()
+	{
+		std::function< void () > job;
+		std::unique_lock< std::mutex > lock( m_mutex );
+		for ( ;; ) {
+			++m_idle;
+			m_ready.wait( lock, [ this ]()
+					{ return m_stop || ! m_job.empty(); } );
+			--m_idle;
+			if ( m_job.empty() ) {
+				return;
+			}
+			job = std::move( m_job.front() );
+			m_job.pop_front();
+			lock.unlock();
+			job();
+			job = nullptr;
+			lock.lock();
+		}
+	}
+
+	std::deque< std::function< void () > > m_job;
+	std::vector< std::thread > m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::size_t m_idle;
+	bool m_stop;
+};
+
+
+STDOPT_INLINE
+config_loader_c::worker_pool_c & config_loader_c::pool()
+{
+	static worker_pool_c workers;
+	return workers;
+}
+
+STDOPT_INLINE
+config_loader_c::config_loader_c( configuration_c &config
+		, const std::string &path, std::size_t chunk_size )
+: m_config( config )
+, m_path( path )
+, m_chunk_size( chunk_size ? chunk_size : 1 )
+, m_text()
+, m_parsed( 0 )
+, m_parse_stopped( false )
+, m_mutex()
+, m_done_cond()
+, m_started( false )
+, m_done( false )
+, m_finished( false )
+, m_callback_thread()
+, m_destroyed( NULL )
+, m_ok( false )
+, m_read_error( false )
+, m_use_io_uring( true )
+, m_used_io_uring( false )
+{}
+
+STDOPT_INLINE
+config_loader_c::~config_loader_c()
+{
+	std::unique_lock< std::mutex > lock( m_mutex );
+	if ( m_destroyed && m_callback_thread == std::this_thread::get_id() ) {
+		// destroyed by whatever the callback called into
+		*m_destroyed = true;
+		return;
+	}
+	m_done_cond.wait( lock, [ this ]() { return ! m_started || m_finished; } );
+}
+
+STDOPT_INLINE
+bool config_loader_c::start( const callback &done )
+{
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		if ( m_started ) {
+			return false;
+		}
+		m_started = true;
+	}
+	pool().post( [ this, done ]() { run( done ); } );
+	return true;
+}
+
+STDOPT_INLINE
+bool config_loader_c::wait()
+{
+	std::unique_lock< std::mutex > lock( m_mutex );
+	if ( ! m_started ) {
+		return false;
+	}
+	m_done_cond.wait( lock, [ this ]() { return m_done; } );
+	return m_ok;
+}
+
+STDOPT_INLINE
+bool config_loader_c::done() const
+{
+	std::lock_guard< std::mutex > lock( m_mutex );
+	return m_done;
+}
+
+STDOPT_INLINE
+void config_loader_c::run( callback done )
+{
+	int fd( open( m_path.c_str(), O_RDONLY | O_CLOEXEC ) );
+	struct stat file_stat;
+	bool read_ok( fd >= 0 && fstat( fd, &file_stat ) == 0 );
+	// observers hear about the whole file at once
+	m_config.begin_update();
+	if ( read_ok ) {
+		m_text.resize( file_stat.st_size );
+		read_ok = false;
+#ifdef STDOPT_IO_URING
+		if ( m_use_io_uring ) {
+			read_ok = read_io_uring( fd );
+		}
+#endif
+		if ( ! m_used_io_uring ) {
+			read_ok = read_pread( fd );
+		}
+	}
+	if ( fd >= 0 ) {
+		close( fd );
+	}
+	m_config.end_update();
+
+	bool ok( read_ok && ! m_parse_stopped && ! m_config.error() );
+	bool destroyed( false );
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_read_error = ! read_ok;
+		m_ok = ok;
+		m_done = true;
+		m_callback_thread = std::this_thread::get_id();
+		m_destroyed = &destroyed;
+		m_done_cond.notify_all();
+	}
+	if ( done ) {
+		done( ok );
+	}
+	if ( destroyed ) {
+		return;
+	}
+	std::lock_guard< std::mutex > lock( m_mutex );
+	m_destroyed = NULL;
+	m_finished = true;
+	m_done_cond.notify_all();
+}
+
+#ifdef STDOPT_IO_URING
+STDOPT_INLINE
+bool config_loader_c::read_io_uring( int fd )
+{
+	// up to depth chunk reads are submitted together so they overlap
+	const unsigned depth( 32 );
+	io_uring_ring_c ring( depth );
+	if ( ! ring.ready() ) {
+		return false;
+	}
+	m_used_io_uring = true;
+
+	const std::size_t size( m_text.size() );
+	const std::size_t chunks( ( size + m_chunk_size - 1 ) / m_chunk_size );
+	// bytes read so far for each chunk
+	std::vector< std::size_t > chunk_read( chunks, 0 );
+	std::size_t next_chunk( 0 );
+	std::size_t ready_chunks( 0 );
+	unsigned in_flight( 0 );
+	unsigned queued( 0 );
+
+	while ( ready_chunks < chunks ) {
+		while ( next_chunk < chunks && in_flight < depth ) {
+			std::size_t offset( next_chunk * m_chunk_size );
+			std::size_t length( std::min( m_chunk_size, size - offset ) );
+			ring.queue_read( fd, &m_text[ offset ], length, offset
+					, next_chunk );
+			++next_chunk;
+			++in_flight;
+			++queued;
+		}
+		if ( ! ring.enter( queued ) ) {
+			return false;
+		}
+		queued = 0;
+
+		uint64_t chunk;
+		int result;
+		while ( ring.next_completion( chunk, result ) ) {
+			--in_flight;
+			if ( result == -EINTR || result == -EAGAIN ) {
+				result = 0;
+			} else if ( result <= 0 ) {
+				// an error or the file got shorter
+				return false;
+			}
+			std::size_t offset( chunk * m_chunk_size );
+			std::size_t length( std::min( m_chunk_size, size - offset ) );
+			chunk_read[ chunk ] += result;
+			if ( chunk_read[ chunk ] < length ) {
+				// short read, queue the rest
+				std::size_t done( chunk_read[ chunk ] );
+				ring.queue_read( fd, &m_text[ offset + done ]
+						, length - done, offset + done, chunk );
+				++in_flight;
+				++queued;
+			}
+		}
+
+		while ( ready_chunks < chunks ) {
+			std::size_t offset( ready_chunks * m_chunk_size );
+			std::size_t length( std::min( m_chunk_size, size - offset ) );
+			if ( chunk_read[ ready_chunks ] < length ) {
+				break;
+			}
+			++ready_chunks;
+		}
+		parse_ready( std::min( ready_chunks * m_chunk_size, size ) );
+	}
+	parse_ready( size );
+	return true;
+}
+#endif
+
+STDOPT_INLINE
+bool config_loader_c::read_pread( int fd )
+{
+	const std::size_t size( m_text.size() );
+	std::size_t offset( 0 );
+	while ( offset < size ) {
+		std::size_t length( std::min( m_chunk_size, size - offset ) );
+		ssize_t result( pread( fd, &m_text[ offset ], length, offset ) );
+		if ( result < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( result <= 0 ) {
+			return false;
+		}
+		offset += result;
+		parse_ready( offset );
+	}
+	parse_ready( size );
+	return true;
+}
+
+STDOPT_INLINE
+void config_loader_c::parse_ready( std::size_t ready )
+{
+	if ( m_parse_stopped || ready <= m_parsed ) {
+		return;
+	}
+	std::size_t end( ready );
+	if ( ready < m_text.size() ) {
+		std::size_t newline( m_text.rfind( '\n', ready - 1 ) );
+		if ( newline == std::string::npos || newline < m_parsed ) {
+			// no complete line yet
+			return;
+		}
+		end = newline + 1;
+	}
+	const char *text( m_text.data() );
+	m_parse_stopped = ! m_config.parse( text + m_parsed, text + end );
+	m_parsed = end;
+}
@@ -19,22 +19,70 @@ using namespace stdopt;
 
 
 template <>
+STDOPT_INLINE
 bool usage_option_i::type_requires_param< bool >()
 {
 	return false;
 }
 
-template <>
-bool option_value_c< bool >::parse_value( const std::string &str_value )
+STDOPT_INLINE
+bool value_parser_c< bool >::parse( const std::string &str_value
+		, bool &value )
 {
-	m_values.push_back( true );
-	m_set = true;
+	value = true;
+	return true;
 }
 
-template <>
-bool option_value_c< std::string >::parse_value( const std::string &str_value )
+STDOPT_INLINE
+bool value_parser_c< std::string >::parse( const std::string &str_value
+		, std::string &value )
 {
-	m_values.push_back( str_value );
-	m_set = true;
+	value = str_value;
+	return true;
 }
 
+/**
+ * Append a Prometheus label value, escaping the characters the text
+ * format needs escaped.
+ */
+static void append_label_value( std::string &text, std::string_view value )
+{
+	for ( std::size_t i(0); i<value.size(); ++i ) {
+		switch ( value[ i ] ) {
+			case '\\':
+				text += "\\\\";
+				break;
+			case '"':
+				text += "\\\"";
+				break;
+			case '\n':
+				text += "\\n";
+				break;
+			default:
+				text += value[ i ];
+				break;
+		}
+	}
+}
+
+STDOPT_INLINE
+void option_memory_c::append_metrics( std::string &text
+		, std::string_view metric, std::string_view option ) const
+{
+	const char *storage[] = { "inline", "values", "heap" };
+	const std::size_t bytes[] = { inline_bytes, value_bytes, heap_bytes };
+	for ( int i(0); i<3; ++i ) {
+		text += metric;
+		text += '{';
+		if ( ! option.empty() ) {
+			text += "option=\"";
+			append_label_value( text, option );
+			text += "\",";
+		}
+		text += "storage=\"";
+		text += storage[ i ];
+		text += "\"} ";
+		text += std::to_string( bytes[ i ] );
+		text += '\n';
+	}
+}
@@ -0,0 +1,214 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/pattern.h"
+#include <algorithm>
+
+using namespace stdopt;
+
+
+/**
+ * Split the next dotted segment off the front of a key.
+ * @return false if there are no segments left
+ */
+static bool next_key_segment( std::string_view &rest, bool &done
+		, std::string_view &segment )
+{
+	if ( done ) {
+		return false;
+	}
+	std::size_t dot( rest.find( '.' ) );
+	if ( dot == std::string_view::npos ) {
+		segment = rest;
+		done = true;
+	} else {
+		segment = rest.substr( 0, dot );
+		rest.remove_prefix( dot + 1 );
+	}
+	return true;
+}
+
+
+STDOPT_INLINE
+pattern_trie_c::pattern_trie_c()
+: m_node()
+, m_pattern()
+, m_active()
+, m_next()
+{}
+
+STDOPT_INLINE
+bool pattern_trie_c::wildcard( std::string_view segment )
+{
+	return segment == "*" || ( segment.size() >= 2 && segment.front() == '<'
+			&& segment.back() == '>' );
+}
+
+STDOPT_INLINE
+int pattern_trie_c::insert( std::string_view pattern )
+{
+	std::vector< int > wildcard_segment;
+	if ( m_node.empty() ) {
+		// the root, added with the first pattern
+		add_node();
+	}
+	int node_id( 0 );
+	std::string_view rest( pattern );
+	std::string_view segment;
+	bool done( false );
+	for ( int i(0); next_key_segment( rest, done, segment ); ++i ) {
+		if ( wildcard( segment ) ) {
+			wildcard_segment.push_back( i );
+			if ( m_node[ node_id ].wildcard < 0 ) {
+				int child( add_node() );
+				m_node[ node_id ].wildcard = child;
+			}
+			node_id = m_node[ node_id ].wildcard;
+			continue;
+		}
+
+		int child( find_literal( node_id, segment ) );
+		if ( child < 0 ) {
+			child = add_node();
+			std::vector< edge > &literal( m_node[ node_id ].literal );
+			edge e;
+			e.segment.assign( segment.data(), segment.size() );
+			e.child = child;
+			literal.insert( std::lower_bound( literal.begin()
+						, literal.end(), segment, edge_before ), e );
+		}
+		node_id = child;
+	}
+
+	if ( m_node[ node_id ].pattern < 0 ) {
+		m_node[ node_id ].pattern = m_pattern.size();
+		pattern_entry entry;
+		entry.wildcard_segment.swap( wildcard_segment );
+		m_pattern.push_back( entry );
+	}
+	return m_node[ node_id ].pattern;
+}
+
+STDOPT_INLINE
+int pattern_trie_c::match( std::string_view key
+		, std::vector< std::string_view > &captures ) const
+{
+	if ( m_node.empty() ) {
+		return -1;
+	}
+	m_active.assign( 1, 0 );
+	std::string_view rest( key );
+	std::string_view segment;
+	bool done( false );
+	while ( ! m_active.empty() && next_key_segment( rest, done, segment ) ) {
+		m_next.clear();
+		for ( std::size_t i(0); i<m_active.size(); ++i ) {
+			const node &n( m_node[ m_active[ i ] ] );
+			int child( find_literal( m_active[ i ], segment ) );
+			if ( child >= 0 ) {
+				m_next.push_back( child );
+			}
+			if ( n.wildcard >= 0 ) {
+				m_next.push_back( n.wildcard );
+			}
+		}
+		m_active.swap( m_next );
+	}
+
+	int best( -1 );
+	for ( std::size_t i(0); i<m_active.size(); ++i ) {
+		int pattern( m_node[ m_active[ i ] ].pattern );
+		if ( pattern >= 0 && better_match( pattern, best ) ) {
+			best = pattern;
+		}
+	}
+	if ( best < 0 ) {
+		return -1;
+	}
+
+	// the wildcards of the winning pattern say which segments to capture
+	captures.clear();
+	const std::vector< int > &wild( m_pattern[ best ].wildcard_segment );
+	std::vector< int >::const_iterator w( wild.begin() );
+	rest = key;
+	done = false;
+	for ( int i(0); w!=wild.end() && next_key_segment( rest, done, segment )
+			; ++i ) {
+		if ( i == *w ) {
+			captures.push_back( segment );
+			++w;
+		}
+	}
+	return best;
+}
+
+STDOPT_INLINE
+std::size_t pattern_trie_c::heap_bytes() const
+{
+	std::size_t bytes( m_node.capacity() * sizeof( node )
+			+ m_pattern.capacity() * sizeof( pattern_entry )
+			+ ( m_active.capacity() + m_next.capacity() ) * sizeof( int ) );
+	for ( std::size_t i(0); i<m_node.size(); ++i ) {
+		const std::vector< edge > &literal( m_node[ i ].literal );
+		bytes += literal.capacity() * sizeof( edge );
+		for ( std::size_t j(0); j<literal.size(); ++j ) {
+			bytes += value_footprint_c< std::string >::heap_bytes(
+					literal[ j ].segment );
+		}
+	}
+	for ( std::size_t i(0); i<m_pattern.size(); ++i ) {
+		bytes += m_pattern[ i ].wildcard_segment.capacity() * sizeof( int );
+	}
+	return bytes;
+}
+
+STDOPT_INLINE
+bool pattern_trie_c::edge_before( const edge &e, std::string_view segment )
+{
+	return std::string_view( e.segment ) < segment;
+}
+
+STDOPT_INLINE
+int pattern_trie_c::find_literal( int node_id, std::string_view segment ) const
+{
+	const std::vector< edge > &literal( m_node[ node_id ].literal );
+	std::vector< edge >::const_iterator it( std::lower_bound( literal.begin()
+				, literal.end(), segment, edge_before ) );
+	if ( it == literal.end() || it->segment != segment ) {
+		return -1;
+	}
+	return it->child;
+}
+
+STDOPT_INLINE
+int pattern_trie_c::add_node()
+{
+	node n;
+	n.wildcard = -1;
+	n.pattern = -1;
+	m_node.push_back( n );
+	return m_node.size() - 1;
+}
+
+STDOPT_INLINE
+bool pattern_trie_c::better_match( int pattern, int best ) const
+{
+	if ( best < 0 ) {
+		return true;
+	}
+	std::size_t wild( m_pattern[ pattern ].wildcard_segment.size() );
+	std::size_t best_wild( m_pattern[ best ].wildcard_segment.size() );
+	return wild < best_wild || ( wild == best_wild && pattern < best );
+}
@@ -0,0 +1,110 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/registry.h"
+#include <cctype>
+#include <cstdlib>
+
+using namespace stdopt;
+
+
+STDOPT_INLINE
+option_registry_c::option_registry_c( const std::string &env_prefix )
+: m_usage()
+, m_config()
+, m_environment()
+, m_env_prefix( env_prefix )
+{
+	// bad values are errors on their options until a higher
+	// precedence source replaces them
+	m_config.keep_parsing( true );
+}
+
+STDOPT_INLINE
+void option_registry_c::add_shared( usage_option_i &usage_opt
+		, config_option_i &config_opt )
+{
+	m_usage.add( usage_opt );
+	m_config.add( config_opt );
+	m_environment.push_back( environment_option(
+				environment_name( config_opt.option_name_view() )
+				, &config_opt ) );
+}
+
+STDOPT_INLINE
+bool option_registry_c::parse( int argc, const char **argv
+		, std::istream &config )
+{
+	parse_config( config );
+	parse_environment();
+	parse_args( argc, argv );
+	return ! error();
+}
+
+STDOPT_INLINE
+void option_registry_c::parse_config( std::istream &config )
+{
+	m_config.parse( config );
+}
+
+STDOPT_INLINE
+void option_registry_c::parse_environment()
+{
+	environment_list::const_iterator it;
+	for ( it=m_environment.begin(); it!=m_environment.end(); ++it ) {
+		const char *value( getenv( it->first.c_str() ) );
+		if ( ! value ) {
+			continue;
+		}
+		it->second->merge_value( value, ENVIRONMENT_SOURCE );
+	}
+}
+
+STDOPT_INLINE
+bool option_registry_c::parse_args( int argc, const char **argv )
+{
+	return m_usage.parse_args( argc, argv );
+}
+
+STDOPT_INLINE
+bool option_registry_c::error() const
+{
+	if ( m_usage.error() || m_config.error() ) {
+		return true;
+	}
+	environment_list::const_iterator it;
+	for ( it=m_environment.begin(); it!=m_environment.end(); ++it ) {
+		if ( it->second->error() ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+STDOPT_INLINE
+std::string option_registry_c::environment_name(
+		std::string_view option_name ) const
+{
+	std::string name( m_env_prefix );
+	std::string_view::const_iterator it( option_name.begin() );
+	for ( ; it!=option_name.end(); ++it ) {
+		if ( *it == '-' || *it == '.' ) {
+			name += '_';
+		} else {
+			name += toupper( *it );
+		}
+	}
+	return name;
+}
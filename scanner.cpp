@@ -0,0 +1,694 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/scanner.h"
+#include <cstring>
+
+using namespace stdopt;
+
+
+/**
+ * Check for the same whitespace that istream >> skips.
+ */
+static bool is_space( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v'
+		|| c == '\f';
+}
+
+/**
+ * Get the first word in [begin, end).
+ */
+static std::string_view first_word( const char *begin, const char *end )
+{
+	while ( begin != end && is_space( *begin ) ) {
+		++begin;
+	}
+	const char *word_end( begin );
+	while ( word_end != end && ! is_space( *word_end ) ) {
+		++word_end;
+	}
+	return std::string_view( begin, word_end - begin );
+}
+
+
+STDOPT_INLINE
+config_scanner_c::config_scanner_c( const char *begin, const char *end )
+: m_pos( begin )
+, m_end( end )
+, m_line( 0 )
+, m_next_line( 1 )
+{}
+
+STDOPT_INLINE
+bool config_scanner_c::next( std::string_view &key, std::string_view &value )
+{
+	while ( m_pos != m_end ) {
+		const char *line( m_pos );
+		const char *line_end( static_cast< const char * >(
+					memchr( line, '\n', m_end - line ) ) );
+		if ( line_end ) {
+			m_pos = line_end + 1;
+		} else {
+			line_end = m_end;
+			m_pos = m_end;
+		}
+		int line_number( m_next_line++ );
+
+		const char *equal( static_cast< const char * >(
+					memchr( line, '=', line_end - line ) ) );
+		if ( ! equal ) {
+			continue;
+		}
+
+		key = first_word( line, equal );
+		value = first_word( equal + 1, line_end );
+		if ( ! ( key.empty() || value.empty() ) ) {
+			m_line = line_number;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/**
+ * Append a code point to a string as UTF-8.
+ */
+static void append_utf8( std::string &text, unsigned long code )
+{
+	if ( code < 0x80 ) {
+		text += char( code );
+	} else if ( code < 0x800 ) {
+		text += char( 0xc0 | ( code >> 6 ) );
+		text += char( 0x80 | ( code & 0x3f ) );
+	} else if ( code < 0x10000 ) {
+		text += char( 0xe0 | ( code >> 12 ) );
+		text += char( 0x80 | ( ( code >> 6 ) & 0x3f ) );
+		text += char( 0x80 | ( code & 0x3f ) );
+	} else {
+		text += char( 0xf0 | ( code >> 18 ) );
+		text += char( 0x80 | ( ( code >> 12 ) & 0x3f ) );
+		text += char( 0x80 | ( ( code >> 6 ) & 0x3f ) );
+		text += char( 0x80 | ( code & 0x3f ) );
+	}
+}
+
+/**
+ * Read a hex code point of the given number of digits at pos.
+ */
+static bool scan_hex( const char *&pos, const char *end, int digits
+		, unsigned long &code )
+{
+	if ( end - pos < digits ) {
+		return false;
+	}
+	code = 0;
+	for ( int i(0); i<digits; ++i, ++pos ) {
+		char c( *pos );
+		code <<= 4;
+		if ( c >= '0' && c <= '9' ) {
+			code |= c - '0';
+		} else if ( c >= 'a' && c <= 'f' ) {
+			code |= c - 'a' + 10;
+		} else if ( c >= 'A' && c <= 'F' ) {
+			code |= c - 'A' + 10;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Scan the double quoted string starting at pos, which JSON and TOML
+ * both escape the same way.  The text is a span of the input unless
+ * the string has escapes, in which case it's decoded into the buffer.
+ * pos is left after the closing quote.
+ */
+static bool scan_quoted( const char *&pos, const char *end
+		, std::string_view &text, std::string &buffer )
+{
+	const char *begin( ++pos );
+	while ( pos != end && *pos != '"' && *pos != '\\' && *pos != '\n' ) {
+		++pos;
+	}
+	if ( pos == end || *pos == '\n' ) {
+		return false;
+	}
+	if ( *pos == '"' ) {
+		text = std::string_view( begin, pos - begin );
+		++pos;
+		return true;
+	}
+
+	buffer.assign( begin, pos );
+	while ( pos != end && *pos != '"' ) {
+		char c( *pos++ );
+		if ( c == '\n' ) {
+			return false;
+		}
+		if ( c != '\\' ) {
+			buffer += c;
+			continue;
+		}
+		if ( pos == end ) {
+			return false;
+		}
+		unsigned long code;
+		switch ( *pos++ ) {
+			case '"': buffer += '"'; break;
+			case '\\': buffer += '\\'; break;
+			case '/': buffer += '/'; break;
+			case 'b': buffer += '\b'; break;
+			case 'f': buffer += '\f'; break;
+			case 'n': buffer += '\n'; break;
+			case 'r': buffer += '\r'; break;
+			case 't': buffer += '\t'; break;
+			case 'u':
+				if ( ! scan_hex( pos, end, 4, code ) ) {
+					return false;
+				}
+				if ( code >= 0xd800 && code < 0xdc00 ) {
+					// the high half of a surrogate pair
+					unsigned long low;
+					if ( end - pos < 2 || pos[0] != '\\' || pos[1] != 'u' ) {
+						return false;
+					}
+					pos += 2;
+					if ( ! scan_hex( pos, end, 4, low )
+							|| low < 0xdc00 || low >= 0xe000 ) {
+						return false;
+					}
+					code = 0x10000 + ( ( code - 0xd800 ) << 10 )
+						+ ( low - 0xdc00 );
+				}
+				append_utf8( buffer, code );
+				break;
+			case 'U':
+				if ( ! scan_hex( pos, end, 8, code ) ) {
+					return false;
+				}
+				append_utf8( buffer, code );
+				break;
+			default:
+				return false;
+		}
+	}
+	if ( pos == end ) {
+		return false;
+	}
+	++pos;
+	text = buffer;
+	return true;
+}
+
+
+STDOPT_INLINE
+json_scanner_c::json_scanner_c( const char *begin, const char *end )
+: m_pos( begin )
+, m_end( end )
+, m_line( 1 )
+, m_state( BEGIN_STATE )
+, m_key()
+, m_key_buffer()
+, m_value_buffer()
+{}
+
+STDOPT_INLINE
+bool json_scanner_c::next( std::string_view &key, std::string_view &value )
+{
+	bool set( false );
+	for (;;) {
+		skip_space();
+		switch ( m_state ) {
+			case BEGIN_STATE:
+				if ( m_pos == m_end ) {
+					// an empty file sets nothing
+					m_state = DONE_STATE;
+					return false;
+				}
+				if ( ! consume( '{' ) ) {
+					return fail();
+				}
+				skip_space();
+				m_state = consume( '}' ) ? END_STATE : MEMBER_STATE;
+				break;
+			case MEMBER_STATE:
+				if ( m_pos == m_end || *m_pos != '"'
+						|| ! scan_quoted( m_pos, m_end, m_key
+							, m_key_buffer ) ) {
+					return fail();
+				}
+				skip_space();
+				if ( ! consume( ':' ) ) {
+					return fail();
+				}
+				skip_space();
+				if ( consume( '[' ) ) {
+					skip_space();
+					m_state = consume( ']' ) ? AFTER_MEMBER_STATE
+						: ELEMENT_STATE;
+					break;
+				}
+				m_state = AFTER_MEMBER_STATE;
+				if ( ! scan_value( value, set ) ) {
+					return fail();
+				}
+				if ( set ) {
+					key = m_key;
+					return true;
+				}
+				break;
+			case ELEMENT_STATE:
+				m_state = AFTER_ELEMENT_STATE;
+				if ( ! scan_value( value, set ) ) {
+					return fail();
+				}
+				if ( set ) {
+					key = m_key;
+					return true;
+				}
+				break;
+			case AFTER_ELEMENT_STATE:
+				if ( consume( ',' ) ) {
+					m_state = ELEMENT_STATE;
+				} else if ( consume( ']' ) ) {
+					m_state = AFTER_MEMBER_STATE;
+				} else {
+					return fail();
+				}
+				break;
+			case AFTER_MEMBER_STATE:
+				if ( consume( ',' ) ) {
+					m_state = MEMBER_STATE;
+				} else if ( consume( '}' ) ) {
+					m_state = END_STATE;
+				} else {
+					return fail();
+				}
+				break;
+			case END_STATE:
+				if ( m_pos != m_end ) {
+					return fail();
+				}
+				m_state = DONE_STATE;
+				return false;
+			case DONE_STATE:
+			case ERROR_STATE:
+				return false;
+		}
+	}
+}
+
+STDOPT_INLINE
+void json_scanner_c::skip_space()
+{
+	while ( m_pos != m_end && is_space( *m_pos ) ) {
+		if ( *m_pos == '\n' ) {
+			++m_line;
+		}
+		++m_pos;
+	}
+}
+
+STDOPT_INLINE
+bool json_scanner_c::consume( char c )
+{
+	if ( m_pos == m_end || *m_pos != c ) {
+		return false;
+	}
+	++m_pos;
+	return true;
+}
+
+STDOPT_INLINE
+bool json_scanner_c::scan_value( std::string_view &value, bool &set )
+{
+	if ( m_pos == m_end ) {
+		return false;
+	}
+	set = true;
+	if ( *m_pos == '"' ) {
+		return scan_quoted( m_pos, m_end, value, m_value_buffer );
+	}
+
+	const char *begin( m_pos );
+	while ( m_pos != m_end && ( ( *m_pos >= 'a' && *m_pos <= 'z' )
+				|| ( *m_pos >= '0' && *m_pos <= '9' ) || *m_pos == '-'
+				|| *m_pos == '+' || *m_pos == '.' || *m_pos == 'E' ) ) {
+		++m_pos;
+	}
+	value = std::string_view( begin, m_pos - begin );
+	if ( value == "false" || value == "null" ) {
+		set = false;
+		return true;
+	}
+	if ( value == "true" ) {
+		return true;
+	}
+	// anything else has to be a number
+	return ! value.empty() && ( value[0] == '-'
+			|| ( value[0] >= '0' && value[0] <= '9' ) );
+}
+
+STDOPT_INLINE
+bool json_scanner_c::fail()
+{
+	m_state = ERROR_STATE;
+	return false;
+}
+
+
+/**
+ * Check for a space within a TOML line.
+ */
+static bool is_blank( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * Check for a character allowed in a bare TOML key, including the dots
+ * of dotted keys.
+ */
+static bool is_bare_key_char( char c )
+{
+	return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' )
+		|| ( c >= '0' && c <= '9' ) || c == '_' || c == '-' || c == '.';
+}
+
+
+STDOPT_INLINE
+toml_scanner_c::toml_scanner_c( const char *begin, const char *end )
+: m_pos( begin )
+, m_line_end( begin )
+, m_end( end )
+, m_line( 0 )
+, m_in_array( false )
+, m_error( false )
+, m_table()
+, m_key()
+, m_key_buffer()
+, m_value_buffer()
+{}
+
+STDOPT_INLINE
+bool toml_scanner_c::next( std::string_view &key, std::string_view &value )
+{
+	while ( ! m_error ) {
+		bool set( false );
+		if ( m_in_array ) {
+			if ( ! scan_element( value, set ) ) {
+				return fail();
+			}
+		} else {
+			if ( m_pos == m_end ) {
+				return false;
+			}
+			m_line_end = static_cast< const char * >(
+					memchr( m_pos, '\n', m_end - m_pos ) );
+			if ( ! m_line_end ) {
+				m_line_end = m_end;
+			}
+			++m_line;
+			if ( ! scan_line( key, value, set ) ) {
+				return fail();
+			}
+		}
+		if ( set ) {
+			key = m_key;
+			return true;
+		}
+	}
+	return false;
+}
+
+STDOPT_INLINE
+bool toml_scanner_c::scan_line( std::string_view &key
+		, std::string_view &value, bool &set )
+{
+	while ( m_pos != m_line_end && is_blank( *m_pos ) ) {
+		++m_pos;
+	}
+	if ( m_pos == m_line_end || *m_pos == '#' ) {
+		return end_of_line();
+	}
+
+	if ( *m_pos == '[' ) {
+		const char *name( ++m_pos );
+		while ( m_pos != m_line_end && is_bare_key_char( *m_pos ) ) {
+			++m_pos;
+		}
+		if ( m_pos == name || m_pos == m_line_end || *m_pos != ']' ) {
+			// empty, quoted and [[array]] tables aren't supported
+			return false;
+		}
+		m_table.assign( name, m_pos );
+		++m_pos;
+		return end_of_line();
+	}
+
+	if ( *m_pos == '"' ) {
+		if ( ! scan_quoted( m_pos, m_line_end, key, m_value_buffer ) ) {
+			return false;
+		}
+	} else {
+		const char *begin( m_pos );
+		while ( m_pos != m_line_end && is_bare_key_char( *m_pos ) ) {
+			++m_pos;
+		}
+		key = std::string_view( begin, m_pos - begin );
+	}
+	if ( key.empty() ) {
+		return false;
+	}
+	if ( m_table.empty() ) {
+		m_key_buffer.assign( key.data(), key.size() );
+	} else {
+		m_key_buffer.assign( m_table );
+		m_key_buffer += '.';
+		m_key_buffer.append( key.data(), key.size() );
+	}
+	m_key = m_key_buffer;
+
+	while ( m_pos != m_line_end && is_blank( *m_pos ) ) {
+		++m_pos;
+	}
+	if ( m_pos == m_line_end || *m_pos != '=' ) {
+		return false;
+	}
+	++m_pos;
+	while ( m_pos != m_line_end && is_blank( *m_pos ) ) {
+		++m_pos;
+	}
+	if ( m_pos != m_line_end && *m_pos == '[' ) {
+		++m_pos;
+		m_in_array = true;
+		return scan_element( value, set );
+	}
+	return scan_value( value, set ) && end_of_line();
+}
+
+STDOPT_INLINE
+bool toml_scanner_c::scan_element( std::string_view &value, bool &set )
+{
+	while ( m_pos != m_line_end && is_blank( *m_pos ) ) {
+		++m_pos;
+	}
+	if ( m_pos != m_line_end && *m_pos == ']' ) {
+		++m_pos;
+		m_in_array = false;
+		set = false;
+		return end_of_line();
+	}
+	if ( ! scan_value( value, set ) ) {
+		return false;
+	}
+	while ( m_pos != m_line_end && is_blank( *m_pos ) ) {
+		++m_pos;
+	}
+	if ( m_pos != m_line_end && *m_pos == ',' ) {
+		++m_pos;
+	} else if ( m_pos == m_line_end || *m_pos != ']' ) {
+		// arrays have to close on the same line
+		return false;
+	}
+	return true;
+}
+
+STDOPT_INLINE
+bool toml_scanner_c::scan_value( std::string_view &value, bool &set )
+{
+	if ( m_pos == m_line_end ) {
+		return false;
+	}
+	set = true;
+	if ( *m_pos == '"' ) {
+		if ( m_line_end - m_pos >= 3 && m_pos[1] == '"' && m_pos[2] == '"' ) {
+			return false;
+		}
+		return scan_quoted( m_pos, m_line_end, value, m_value_buffer );
+	}
+	if ( *m_pos == '\'' ) {
+		const char *begin( m_pos + 1 );
+		const char *quote( static_cast< const char * >(
+					memchr( begin, '\'', m_line_end - begin ) ) );
+		if ( ! quote || ( quote == begin && m_line_end - quote >= 2
+					&& quote[1] == '\'' ) ) {
+			return false;
+		}
+		value = std::string_view( begin, quote - begin );
+		m_pos = quote + 1;
+		return true;
+	}
+	if ( *m_pos == '{' ) {
+		return false;
+	}
+
+	const char *begin( m_pos );
+	while ( m_pos != m_line_end && ! is_blank( *m_pos ) && *m_pos != ','
+			&& *m_pos != ']' && *m_pos != '#' ) {
+		++m_pos;
+	}
+	value = std::string_view( begin, m_pos - begin );
+	if ( value.empty() ) {
+		return false;
+	}
+	if ( value == "false" ) {
+		set = false;
+	} else if ( value.find( '_' ) != std::string_view::npos ) {
+		// numbers can be split up with underscores, like 1_000
+		m_value_buffer.clear();
+		for ( std::size_t i(0); i<value.size(); ++i ) {
+			if ( value[i] != '_' ) {
+				m_value_buffer += value[i];
+			}
+		}
+		value = m_value_buffer;
+	}
+	return true;
+}
+
+STDOPT_INLINE
+bool toml_scanner_c::end_of_line()
+{
+	while ( m_pos != m_line_end && is_blank( *m_pos ) ) {
+		++m_pos;
+	}
+	if ( m_pos != m_line_end && *m_pos != '#' ) {
+		return false;
+	}
+	m_pos = m_line_end == m_end ? m_end : m_line_end + 1;
+	return true;
+}
+
+STDOPT_INLINE
+bool toml_scanner_c::fail()
+{
+	m_error = true;
+	return false;
+}
+
+
+STDOPT_INLINE
+command_scanner_c::command_scanner_c( char *begin, char *end )
+: m_pos( begin )
+, m_end( end )
+, m_out( begin )
+, m_error( false )
+{}
+
+STDOPT_INLINE
+command_scanner_c::command_scanner_c( std::string_view line
+		, std::string &arena )
+: m_pos( line.data() )
+, m_end( line.data() + line.size() )
+, m_out( NULL )
+, m_error( false )
+{
+	if ( arena.size() < line.size() ) {
+		arena.resize( line.size() );
+	}
+	m_out = &arena[0];
+}
+
+STDOPT_INLINE
+bool command_scanner_c::next( std::string_view &arg )
+{
+	for (;;) {
+		while ( m_pos != m_end && is_space( *m_pos ) ) {
+			++m_pos;
+		}
+		if ( m_pos == m_end ) {
+			return false;
+		}
+
+		// writing never gets ahead of reading, so in place is safe
+		char *start( m_out );
+		bool quoted( false );
+		while ( m_pos != m_end && ! is_space( *m_pos ) ) {
+			char c( *m_pos++ );
+			if ( c == '\'' ) {
+				while ( m_pos != m_end && *m_pos != '\'' ) {
+					*m_out++ = *m_pos++;
+				}
+				if ( m_pos == m_end ) {
+					return fail();
+				}
+				++m_pos;
+				quoted = true;
+			} else if ( c == '"' ) {
+				while ( m_pos != m_end && *m_pos != '"' ) {
+					if ( *m_pos == '\\' && m_pos + 1 != m_end
+							&& ( m_pos[1] == '"' || m_pos[1] == '\\' ) ) {
+						++m_pos;
+					}
+					*m_out++ = *m_pos++;
+				}
+				if ( m_pos == m_end ) {
+					return fail();
+				}
+				++m_pos;
+				quoted = true;
+			} else if ( c == '\\' ) {
+				if ( m_pos == m_end ) {
+					return fail();
+				}
+				if ( *m_pos == '\n' ) {
+					++m_pos;
+				} else {
+					*m_out++ = *m_pos++;
+				}
+			} else {
+				*m_out++ = c;
+			}
+		}
+
+		// a lone backslash newline isn't an arg, but "" is
+		if ( m_out != start || quoted ) {
+			arg = std::string_view( start, m_out - start );
+			return true;
+		}
+	}
+}
+
+STDOPT_INLINE
+bool command_scanner_c::fail()
+{
+	m_error = true;
+	m_pos = m_end;
+	return false;
+}
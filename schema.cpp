@@ -0,0 +1,213 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/schema.h"
+#include <algorithm>
+
+using namespace stdopt;
+
+
+STDOPT_INLINE
+config_schema_c::config_schema_c()
+: m_entry()
+, m_index()
+{}
+
+STDOPT_INLINE
+config_schema_c::~config_schema_c()
+{
+	std::vector< schema_entry_i * >::iterator it;
+	for ( it=m_entry.begin(); it!=m_entry.end(); ++it ) {
+		delete *it;
+	}
+}
+
+STDOPT_INLINE
+int config_schema_c::add_entry( schema_entry_i *entry )
+{
+	int id( m_entry.size() );
+	m_entry.push_back( entry );
+	m_index[ entry->option_name() ] = id;
+	return id;
+}
+
+STDOPT_INLINE
+int config_schema_c::find( std::string_view name ) const
+{
+	index_map::const_iterator it( m_index.find( name ) );
+	return it == m_index.end() ? -1 : it->second;
+}
+
+
+STDOPT_INLINE
+config_values_c::config_values_c( const config_schema_c &schema )
+: m_schema( &schema )
+, m_value()
+, m_diagnostic()
+, m_error( false )
+{}
+
+STDOPT_INLINE
+config_values_c::config_values_c( config_values_c &&other )
+: m_schema( other.m_schema )
+, m_value( std::move( other.m_value ) )
+, m_diagnostic( std::move( other.m_diagnostic ) )
+, m_error( other.m_error )
+{
+	other.m_value.clear();
+}
+
+STDOPT_INLINE
+config_values_c::~config_values_c()
+{
+	clear();
+}
+
+STDOPT_INLINE
+void config_values_c::clear()
+{
+	slot_list::iterator it;
+	for ( it=m_value.begin(); it!=m_value.end(); ++it ) {
+		delete it->value;
+	}
+	m_value.clear();
+	m_diagnostic.clear();
+	m_error = false;
+}
+
+STDOPT_INLINE
+bool config_values_c::parse( std::istream &input )
+{
+	std::string text;
+	read_text( input, text );
+	return parse( text.data(), text.data() + text.size() );
+}
+
+STDOPT_INLINE
+bool config_values_c::parse( const char *begin, const char *end )
+{
+	config_scanner_c scanner( begin, end );
+	std::string_view key;
+	std::string_view value;
+	std::string value_str;
+
+	while ( scanner.next( key, value ) ) {
+		int id( m_schema->find( key ) );
+		if ( id < 0 ) {
+			add_diagnostic( config_diagnostic_c( scanner.line(), key
+						, "unknown option" ) );
+			continue;
+		}
+
+		value_slot &slot( slot_value( id ) );
+		slot.hash = ( slot.hash * 1099511628211ull )
+			^ key_index_c::hash( value );
+		value_str.assign( value.data(), value.size() );
+		if ( ! slot.value->parse_value( value_str ) ) {
+			add_diagnostic( config_diagnostic_c( scanner.line(), key
+						, "invalid value" ) );
+		}
+	}
+	return ! m_error;
+}
+
+STDOPT_INLINE
+int config_values_c::diff( const config_values_c &updated
+		, std::vector< config_change_c > &changes ) const
+{
+	std::size_t start( changes.size() );
+	slot_list::const_iterator old_it( m_value.begin() );
+	slot_list::const_iterator new_it( updated.m_value.begin() );
+	while ( old_it != m_value.end() || new_it != updated.m_value.end() ) {
+		if ( new_it == updated.m_value.end() || ( old_it != m_value.end()
+					&& old_it->id < new_it->id ) ) {
+			const value_slot &slot( *old_it );
+			changes.push_back( config_change_c( config_change_c::REMOVED
+						, slot.id, m_schema->entry( slot.id ).option_name()
+						, slot.value, NULL ) );
+			++old_it;
+		} else if ( old_it == m_value.end() || new_it->id < old_it->id ) {
+			const value_slot &slot( *new_it );
+			changes.push_back( config_change_c( config_change_c::ADDED
+						, slot.id, m_schema->entry( slot.id ).option_name()
+						, NULL, slot.value ) );
+			++new_it;
+		} else {
+			// differently written values, like 1 and 01, can still be
+			// the same once they're parsed
+			const value_slot &slot( *old_it );
+			if ( slot.hash != new_it->hash
+					&& ! same_values( *slot.value, *new_it->value ) ) {
+				changes.push_back( config_change_c( config_change_c::CHANGED
+							, slot.id, m_schema->entry( slot.id ).option_name()
+							, slot.value, new_it->value ) );
+			}
+			++old_it;
+			++new_it;
+		}
+	}
+	return changes.size() - start;
+}
+
+STDOPT_INLINE
+bool config_values_c::same_values( const option_value_i &a
+		, const option_value_i &b )
+{
+	if ( a.error() != b.error() || a.size() != b.size() ) {
+		return false;
+	}
+	std::string a_bytes;
+	for ( int i(0); i<a.size(); ++i ) {
+		a_bytes.clear();
+		if ( ! a.encode_value( i, a_bytes )
+				|| ! b.value_equals( i, a_bytes ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+STDOPT_INLINE
+void config_values_c::add_diagnostic( const config_diagnostic_c &diag )
+{
+	m_diagnostic.push_back( diag );
+	m_error = true;
+}
+
+STDOPT_INLINE
+const config_values_c::value_slot * config_values_c::find_slot( int id ) const
+{
+	slot_list::const_iterator it( std::lower_bound( m_value.begin()
+				, m_value.end(), id, slot_before ) );
+	if ( it == m_value.end() || it->id != id ) {
+		return NULL;
+	}
+	return &*it;
+}
+
+STDOPT_INLINE
+config_values_c::value_slot & config_values_c::slot_value( int id )
+{
+	slot_list::iterator it( std::lower_bound( m_value.begin()
+				, m_value.end(), id, slot_before ) );
+	if ( it == m_value.end() || it->id != id ) {
+		value_slot slot;
+		slot.id = id;
+		slot.value = m_schema->entry( id ).create_value( slot.typed );
+		slot.hash = 0;
+		it = m_value.insert( it, slot );
+	}
+	return *it;
+}
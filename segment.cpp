@@ -0,0 +1,414 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/segment.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace stdopt;
+
+
+namespace {
+
+/**
+ * The segment starts with a header, then a table of options sorted by
+ * name, then a table of value ranges for each option, then the names
+ * and then the values.  Every offset is from the start of the segment
+ * and values start on 16 byte boundaries so they can be read in place.
+ */
+class segment_header
+{
+public:
+	char magic[ 8 ];
+	uint64_t size;
+	uint64_t option_count;
+	uint64_t option_offset;
+};
+
+class segment_option
+{
+public:
+	uint64_t name_offset;
+	uint64_t name_size;
+	uint64_t value_count;
+	uint64_t value_offset;
+};
+
+class segment_value
+{
+public:
+	uint64_t offset;
+	uint64_t size;
+};
+
+const char SEGMENT_MAGIC[ 8 ] = { 's', 't', 'd', 'o', 'p', 't'
+	, 'S', '1' };
+
+} // end namespace
+
+/**
+ * Round an offset up to a 16 byte boundary.
+ */
+static std::size_t segment_align( std::size_t offset )
+{
+	return ( offset + 15 ) & ~std::size_t( 15 );
+}
+
+/**
+ * Write all the bytes to a file descriptor.
+ */
+static bool write_all( int fd, const std::string &data )
+{
+	std::size_t written( 0 );
+	while ( written < data.size() ) {
+		ssize_t result( write( fd, data.data() + written
+					, data.size() - written ) );
+		if ( result < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( result <= 0 ) {
+			return false;
+		}
+		written += result;
+	}
+	return true;
+}
+
+
+STDOPT_INLINE
+segment_writer_c::segment_writer_c()
+: m_option()
+, m_bytes()
+{}
+
+STDOPT_INLINE
+bool segment_writer_c::add( std::string_view name
+		, const option_value_i &option )
+{
+	option_entry entry;
+	entry.name = name;
+	int count( option.size() );
+	if ( count == 0 ) {
+		// export the default the option would read as
+		std::size_t begin( m_bytes.size() );
+		if ( option.encode_default( m_bytes ) ) {
+			entry.values.push_back( std::make_pair( begin
+						, m_bytes.size() - begin ) );
+		} else {
+			m_bytes.resize( begin );
+		}
+	}
+	for ( int i(0); i<count; ++i ) {
+		std::size_t begin( m_bytes.size() );
+		if ( ! option.encode_value( i, m_bytes ) ) {
+			m_bytes.resize( begin );
+			return false;
+		}
+		entry.values.push_back( std::make_pair( begin
+					, m_bytes.size() - begin ) );
+	}
+	m_option.push_back( entry );
+	return true;
+}
+
+STDOPT_INLINE
+bool segment_writer_c::add( const configuration_c &config )
+{
+	bool ok( true );
+	for ( int id(0); id<config.size(); ++id ) {
+		const config_option_i &option( config.option( id ) );
+		ok = add( option.option_name_view(), option ) && ok;
+	}
+	return ok;
+}
+
+STDOPT_INLINE
+bool segment_writer_c::add( const usage_c &usage )
+{
+	bool ok( true );
+	usage_c::option_list::const_iterator it;
+	for ( it=usage.m_option.begin(); it!=usage.m_option.end(); ++it ) {
+		ok = add( it->option_name(), *it->usage_option() ) && ok;
+	}
+	return ok;
+}
+
+STDOPT_INLINE
+std::string segment_writer_c::build() const
+{
+	// sort by name, keeping the last option added for each name
+	std::vector< const option_entry * > sorted;
+	for ( std::size_t i(0); i<m_option.size(); ++i ) {
+		sorted.push_back( &m_option[ i ] );
+	}
+	std::stable_sort( sorted.begin(), sorted.end()
+			, []( const option_entry *a, const option_entry *b )
+			{ return a->name < b->name; } );
+	std::vector< const option_entry * > unique;
+	for ( std::size_t i(0); i<sorted.size(); ++i ) {
+		if ( ! unique.empty() && unique.back()->name == sorted[i]->name ) {
+			unique.back() = sorted[i];
+		} else {
+			unique.push_back( sorted[i] );
+		}
+	}
+
+	std::size_t value_count( 0 );
+	std::size_t name_size( 0 );
+	for ( std::size_t i(0); i<unique.size(); ++i ) {
+		value_count += unique[i]->values.size();
+		name_size += unique[i]->name.size();
+	}
+
+	std::size_t option_offset( sizeof( segment_header ) );
+	std::size_t value_offset( option_offset
+			+ unique.size() * sizeof( segment_option ) );
+	std::size_t name_offset( value_offset
+			+ value_count * sizeof( segment_value ) );
+	std::size_t data_offset( segment_align( name_offset + name_size ) );
+	std::size_t size( data_offset );
+	for ( std::size_t i(0); i<unique.size(); ++i ) {
+		for ( std::size_t j(0); j<unique[i]->values.size(); ++j ) {
+			size = segment_align( size ) + unique[i]->values[j].second;
+		}
+	}
+
+	std::string segment( size, '\0' );
+	char *base( &segment[0] );
+	segment_header header;
+	memcpy( header.magic, SEGMENT_MAGIC, sizeof( header.magic ) );
+	header.size = size;
+	header.option_count = unique.size();
+	header.option_offset = option_offset;
+	memcpy( base, &header, sizeof( header ) );
+
+	for ( std::size_t i(0); i<unique.size(); ++i ) {
+		const option_entry &entry( *unique[i] );
+		segment_option option;
+		option.name_offset = name_offset;
+		option.name_size = entry.name.size();
+		option.value_count = entry.values.size();
+		option.value_offset = value_offset;
+		memcpy( base + option_offset + i * sizeof( option ), &option
+				, sizeof( option ) );
+		memcpy( base + name_offset, entry.name.data(), entry.name.size() );
+		name_offset += entry.name.size();
+
+		for ( std::size_t j(0); j<entry.values.size(); ++j ) {
+			data_offset = segment_align( data_offset );
+			segment_value value;
+			value.offset = data_offset;
+			value.size = entry.values[j].second;
+			memcpy( base + value_offset, &value, sizeof( value ) );
+			value_offset += sizeof( value );
+			memcpy( base + data_offset, m_bytes.data()
+					+ entry.values[j].first, value.size );
+			data_offset += value.size;
+		}
+	}
+	return segment;
+}
+
+STDOPT_INLINE
+int segment_writer_c::create_memfd( const char *name ) const
+{
+#if defined( __linux__ ) && defined( MFD_ALLOW_SEALING )
+	int fd( memfd_create( name, MFD_CLOEXEC | MFD_ALLOW_SEALING ) );
+	if ( fd < 0 ) {
+		return -1;
+	}
+	if ( ! write_all( fd, build() ) || fcntl( fd, F_ADD_SEALS
+				, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE
+				| F_SEAL_SEAL ) < 0 ) {
+		close( fd );
+		return -1;
+	}
+	return fd;
+#else
+	return -1;
+#endif
+}
+
+STDOPT_INLINE
+bool segment_writer_c::write_file( const std::string &path ) const
+{
+	// a unique name, so writers of the same path don't collide
+	std::string tmp_path( path + ".XXXXXX" );
+	int fd( mkstemp( &tmp_path[0] ) );
+	if ( fd < 0 ) {
+		return false;
+	}
+	bool ok( fchmod( fd, 0644 ) == 0 && write_all( fd, build() ) );
+	ok = close( fd ) == 0 && ok;
+	if ( ! ok || rename( tmp_path.c_str(), path.c_str() ) != 0 ) {
+		unlink( tmp_path.c_str() );
+		return false;
+	}
+	return true;
+}
+
+
+STDOPT_INLINE
+segment_reader_c::segment_reader_c()
+: m_base( NULL )
+, m_size( 0 )
+{}
+
+STDOPT_INLINE
+segment_reader_c::~segment_reader_c()
+{
+	detach();
+}
+
+STDOPT_INLINE
+bool segment_reader_c::attach( int fd )
+{
+	detach();
+	struct stat file_stat;
+	if ( fstat( fd, &file_stat ) != 0
+			|| std::size_t( file_stat.st_size ) < sizeof( segment_header ) ) {
+		return false;
+	}
+	std::size_t size( file_stat.st_size );
+	void *base( mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 ) );
+	if ( base == MAP_FAILED ) {
+		return false;
+	}
+	m_base = static_cast< const char * >( base );
+	m_size = size;
+
+	// check every offset once so reads don't have to
+	segment_header header;
+	memcpy( &header, m_base, sizeof( header ) );
+	bool valid( memcmp( header.magic, SEGMENT_MAGIC
+				, sizeof( header.magic ) ) == 0
+			&& header.size <= size
+			&& header.option_offset <= size
+			&& header.option_offset % 8 == 0
+			&& header.option_count <= ( size - header.option_offset )
+				/ sizeof( segment_option ) );
+	for ( uint64_t i(0); valid && i<header.option_count; ++i ) {
+		const segment_option &option( reinterpret_cast<
+				const segment_option * >( m_base
+					+ header.option_offset )[ i ] );
+		valid = option.name_offset <= size
+			&& option.name_size <= size - option.name_offset
+			&& option.value_offset <= size
+			&& option.value_offset % 8 == 0
+			&& option.value_count <= ( size - option.value_offset )
+				/ sizeof( segment_value );
+		for ( uint64_t j(0); valid && j<option.value_count; ++j ) {
+			const segment_value &value( reinterpret_cast<
+					const segment_value * >( m_base
+						+ option.value_offset )[ j ] );
+			valid = value.offset <= size
+				&& value.size <= size - value.offset;
+		}
+	}
+	if ( ! valid ) {
+		detach();
+	}
+	return valid;
+}
+
+STDOPT_INLINE
+bool segment_reader_c::attach( const std::string &path )
+{
+	int fd( open( path.c_str(), O_RDONLY | O_CLOEXEC ) );
+	if ( fd < 0 ) {
+		return false;
+	}
+	bool attached( attach( fd ) );
+	close( fd );
+	return attached;
+}
+
+STDOPT_INLINE
+void segment_reader_c::detach()
+{
+	if ( m_base ) {
+		munmap( const_cast< char * >( m_base ), m_size );
+	}
+	m_base = NULL;
+	m_size = 0;
+}
+
+STDOPT_INLINE
+int segment_reader_c::size() const
+{
+	if ( ! m_base ) {
+		return 0;
+	}
+	return reinterpret_cast< const segment_header * >( m_base )
+		->option_count;
+}
+
+STDOPT_INLINE
+int segment_reader_c::find( std::string_view name ) const
+{
+	int low( 0 );
+	int high( size() );
+	while ( low < high ) {
+		int mid( low + ( high - low ) / 2 );
+		if ( option_name( mid ) < name ) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low < size() && option_name( low ) == name ? low : -1;
+}
+
+STDOPT_INLINE
+std::string_view segment_reader_c::option_name( int id ) const
+{
+	const segment_header &header( *reinterpret_cast<
+			const segment_header * >( m_base ) );
+	const segment_option &option( reinterpret_cast<
+			const segment_option * >( m_base
+				+ header.option_offset )[ id ] );
+	return std::string_view( m_base + option.name_offset
+			, option.name_size );
+}
+
+STDOPT_INLINE
+int segment_reader_c::size( int id ) const
+{
+	const segment_header &header( *reinterpret_cast<
+			const segment_header * >( m_base ) );
+	return reinterpret_cast< const segment_option * >( m_base
+			+ header.option_offset )[ id ].value_count;
+}
+
+STDOPT_INLINE
+std::string_view segment_reader_c::bytes( int id, int i ) const
+{
+	const segment_header &header( *reinterpret_cast<
+			const segment_header * >( m_base ) );
+	const segment_option &option( reinterpret_cast<
+			const segment_option * >( m_base
+				+ header.option_offset )[ id ] );
+	const segment_value &value( reinterpret_cast<
+			const segment_value * >( m_base
+				+ option.value_offset )[ i ] );
+	return std::string_view( m_base + value.offset, value.size );
+}
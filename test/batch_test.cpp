@@ -0,0 +1,103 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/batch.h"
+#include <testpp/test.h>
+#include <cstring>
+#include <sstream>
+
+using namespace stdopt;
+
+
+/**
+ * Test that a batch of buffers parses each one into its own values.
+ */
+TESTPP( test_batch_buffers )
+{
+	config_schema_c schema;
+	schema_key_c< int > port( schema.add( 80, "port", "Port." ) );
+
+	std::vector< std::string > text;
+	for ( int i(0); i<50; ++i ) {
+		std::ostringstream line;
+		line << "port=" << ( 1000 + i ) << "\n";
+		text.push_back( line.str() );
+	}
+
+	config_batch_c batch( schema, 4 );
+	for ( std::size_t i(0); i<text.size(); ++i ) {
+		batch.add_buffer( "tenant", text[i].data()
+				, text[i].data() + text[i].size() );
+	}
+	assertpp( batch.parse() ).t();
+
+	assertpp( batch.size() ) == 50;
+	for ( int i(0); i<batch.size(); ++i ) {
+		assertpp( batch.result( i ).error() ).f();
+		assertpp( batch.result( i ).values().value( port ) ) == 1000 + i;
+	}
+}
+
+/**
+ * Test that a bad buffer or a missing file is reported in its own
+ * result without affecting the rest of the batch.
+ */
+TESTPP( test_batch_errors )
+{
+	config_schema_c schema;
+	schema_key_c< int > port( schema.add( 80, "port", "Port." ) );
+
+	const char good[] = "port=90\n";
+	const char bad[] = "port=abc\n";
+	config_batch_c batch( schema );
+	batch.add_buffer( "good", good, good + strlen( good ) );
+	batch.add_buffer( "bad", bad, bad + strlen( bad ) );
+	batch.add_file( "/nonexistent/stdopt.conf" );
+	assertpp( batch.parse() ).f();
+
+	assertpp( batch.result( 0 ).error() ).f();
+	assertpp( batch.result( 0 ).values().value( port ) ) == 90;
+	assertpp( batch.result( 1 ).error() ).t();
+	assertpp( batch.result( 1 ).diagnostics().size() ) == 1;
+	assertpp( batch.result( 2 ).name() ) == "/nonexistent/stdopt.conf";
+	assertpp( batch.result( 2 ).error() ).t();
+	assertpp( batch.result( 2 ).diagnostics()[0].line() ) == 0;
+}
+
+/**
+ * Test that parsing a batch again rereads its buffers on the same
+ * workers and replaces the earlier values and diagnostics.
+ */
+TESTPP( test_batch_parse_again )
+{
+	config_schema_c schema;
+	schema_key_c< int > port( schema.add( 80, "port", "Port." ) );
+
+	char first[] = "port=91\n";
+	char second[] = "port=x2\n";
+	config_batch_c batch( schema, 3 );
+	batch.add_buffer( "first", first, first + strlen( first ) );
+	batch.add_buffer( "second", second, second + strlen( second ) );
+	assertpp( batch.threads() ) == 3;
+	assertpp( batch.parse() ).f();
+	assertpp( batch.result( 1 ).diagnostics().size() ) == 1;
+
+	second[5] = '9';
+	assertpp( batch.parse() ).t();
+	assertpp( batch.result( 0 ).values().value( port ) ) == 91;
+	assertpp( batch.result( 0 ).values().values( port )->size() ) == 1;
+	assertpp( batch.result( 1 ).values().value( port ) ) == 92;
+	assertpp( batch.result( 1 ).diagnostics().size() ) == 0;
+}
@@ -15,6 +15,7 @@
 
 #include "stdopt/configuration.h"
 #include <testpp/test.h>
+#include <cstring>
 #include <sstream>
 
 using namespace stdopt;
@@ -287,3 +288,358 @@ TESTPP( test_non_integer )
 	assertpp( config.error() ).t();
 }
 
+/**
+ * Test that option names are interned into dense key ids that can be
+ * used to get the option back.
+ */
+TESTPP( test_config_key_ids )
+{
+	config_option_c< int > port( "port", "Port." );
+	config_option_c< std::string > host( "host", "Host." );
+	config_option_c< int > port2( "port", "Port again." );
+
+	configuration_c config;
+	assertpp( config.add( port ) ) == 0;
+	assertpp( config.add( host ) ) == 1;
+	assertpp( config.add( port2 ) ) == 0;
+	assertpp( config.size() ) == 2;
+	assertpp( config.find( "host" ) ) == 1;
+	assertpp( config.find( "dog" ) ) == -1;
+
+	std::stringstream input( "port=90\nhost=example.com\n" );
+	config.parse( input );
+	assertpp( &config.option( 0 ) == &port2 ).t();
+	assertpp( port.set() ).f();
+	assertpp( port2.value() ) == 90;
+	assertpp( config.option( config.find( "host" ) ).set() ).t();
+}
+
+/**
+ * Test that the key index finds every key after it grows.
+ */
+TESTPP( test_key_index_grow )
+{
+	key_index_c index;
+	std::vector< std::string > keys;
+	for ( int i(0); i<100; ++i ) {
+		std::ostringstream key;
+		key << "key-" << i;
+		keys.push_back( key.str() );
+		assertpp( index.insert( keys.back() ) ) == i;
+	}
+
+	assertpp( index.size() ) == 100;
+	for ( int i(0); i<100; ++i ) {
+		assertpp( index.find( keys[i] ) ) == i;
+		assertpp( index.key( i ) ) == keys[i];
+	}
+	assertpp( index.find( "key-100" ) ) == -1;
+	assertpp( index.find( "" ) ) == -1;
+}
+
+/**
+ * Test that a flat JSON object sets options, with arrays setting an
+ * option more than once.
+ */
+TESTPP( test_parse_json )
+{
+	config_option_c< int > port( "port", "Port." );
+	config_option_c< std::string > host( "host", "Host." );
+	config_option_c< bool > debug( "debug", "Debug." );
+	config_option_c< bool > quiet( "quiet", "Quiet." );
+	config_option_c< double > ratio( "ratio", "Ratio." );
+	const char text[] = "{\n \"port\": [80, 8080],\n"
+		" \"host\": \"a\\\"b\\u00e9\",\n \"debug\": true,\n"
+		" \"quiet\": false, \"ratio\": -1.5e2 }\n";
+
+	configuration_c config;
+	config.add( port );
+	config.add( host );
+	config.add( debug );
+	config.add( quiet );
+	config.add( ratio );
+	json_scanner_c scanner( text, text + sizeof( text ) - 1 );
+	assertpp( config.parse( scanner ) ).t();
+
+	assertpp( port.size() ) == 2;
+	assertpp( port.value( 1 ) ) == 8080;
+	assertpp( host.value() ) == "a\"b\xc3\xa9";
+	assertpp( debug.set() ).t();
+	assertpp( quiet.set() ).f();
+	assertpp( ratio.value() ) == -150.0;
+}
+
+/**
+ * Test that JSON the scanner doesn't support is a configuration error.
+ */
+TESTPP( test_parse_json_syntax_error )
+{
+	config_option_c< int > port( "port", "Port." );
+	const char text[] = "{ \"port\": 80, \"tls\": { \"port\": 443 } }";
+
+	configuration_c config;
+	config.add( port );
+	json_scanner_c scanner( text, text + sizeof( text ) - 1 );
+	assertpp( config.parse( scanner ) ).f();
+	assertpp( scanner.error() ).t();
+	assertpp( config.error() ).t();
+	assertpp( port.value() ) == 80;
+}
+
+/**
+ * Test that the TOML subset sets options, with tables prefixing keys.
+ */
+TESTPP( test_parse_toml )
+{
+	config_option_c< int > port( "port", "Port." );
+	config_option_c< std::string > name( "name", "Name." );
+	config_option_c< std::string > host( "server.host", "Host." );
+	config_option_c< int > limit( "server.limit", "Limit." );
+	config_option_c< std::string > path( "server.path", "Path." );
+	const char text[] = "# ports\nport = [ 80, 8080, ]\n"
+		"name = \"tab\\there\" # comment\n\n"
+		"[server]\r\nhost = 'example.com'\nlimit = 1_000\n"
+		"path = 'C:\\dir'\n";
+
+	configuration_c config;
+	config.add( port );
+	config.add( name );
+	config.add( host );
+	config.add( limit );
+	config.add( path );
+	toml_scanner_c scanner( text, text + sizeof( text ) - 1 );
+	assertpp( config.parse( scanner ) ).t();
+
+	assertpp( port.size() ) == 2;
+	assertpp( port.value( 0 ) ) == 80;
+	assertpp( port.value( 1 ) ) == 8080;
+	assertpp( name.value() ) == "tab\there";
+	assertpp( scanner.table() ) == "server";
+	assertpp( host.value() ) == "example.com";
+	assertpp( limit.value() ) == 1000;
+	assertpp( path.value() ) == "C:\\dir";
+}
+
+/**
+ * Test that TOML the scanner doesn't support is a configuration error
+ * reported at its line.
+ */
+TESTPP( test_parse_toml_syntax_error )
+{
+	config_option_c< int > port( "port", "Port." );
+	const char text[] = "port = 80\nport = [ 1,\n 2 ]\n";
+
+	configuration_c config;
+	config.add( port );
+	toml_scanner_c scanner( text, text + sizeof( text ) - 1 );
+	assertpp( config.parse( scanner ) ).f();
+	assertpp( scanner.error() ).t();
+	assertpp( scanner.line() ) == 2;
+	assertpp( port.size() ) == 2;
+}
+
+/**
+ * Test that observers hear once about the options that changed.
+ */
+TESTPP( test_config_observe )
+{
+	config_option_c< int > port( 80, "port", "Port." );
+	config_option_c< std::string > host( "host", "Host." );
+	config_option_c< int > timeout( "timeout", "Timeout." );
+	configuration_c config;
+	int port_id( config.add( port ) );
+	int host_id( config.add( host ) );
+	int timeout_id( config.add( timeout ) );
+
+	std::vector< std::vector< int > > all_calls;
+	std::vector< std::vector< int > > host_calls;
+	config.observe( [ &all_calls ]( const std::vector< int > &ids )
+			{ all_calls.push_back( ids ); } );
+	config.observe( std::vector< int >( 1, host_id )
+			, [ &host_calls ]( const std::vector< int > &ids )
+			{ host_calls.push_back( ids ); } );
+
+	std::stringstream input( "timeout=5\nport=8080\nhost=a\n" );
+	config.parse( input );
+	assertpp( all_calls.size() ) == 1;
+	assertpp( all_calls[0].size() ) == 3;
+	assertpp( all_calls[0][0] ) == port_id;
+	assertpp( all_calls[0][2] ) == timeout_id;
+	assertpp( host_calls.size() ) == 1;
+
+	// the same values again don't change anything
+	std::stringstream same( "port=8080\nhost=a\ntimeout=5\n" );
+	config.reload( same );
+	assertpp( all_calls.size() ) == 1;
+
+	// only the port changed and the timeout was dropped
+	std::stringstream changed( "port=9000\nhost=a\n" );
+	config.reload( changed );
+	assertpp( all_calls.size() ) == 2;
+	assertpp( all_calls[1].size() ) == 2;
+	assertpp( all_calls[1][0] ) == port_id;
+	assertpp( all_calls[1][1] ) == timeout_id;
+	assertpp( host_calls.size() ) == 1;
+	assertpp( port.size() ) == 1;
+	assertpp( port.value() ) == 9000;
+	assertpp( timeout.set() ).f();
+}
+
+
+/**
+ * A value with padding after its flag.
+ */
+class padded_value_c
+{
+public:
+	char flag;
+	int64_t count;
+
+	bool operator == ( const padded_value_c &v ) const
+	{
+		return flag == v.flag && count == v.count;
+	}
+};
+
+namespace stdopt {
+
+/**
+ * Parse a padded value, leaving different garbage in the padding
+ * each time.
+ */
+template <>
+class value_parser_c< padded_value_c >
+{
+public:
+	static bool parse( const std::string &str_value, padded_value_c &value )
+	{
+		static unsigned char garbage( 0 );
+		memset( static_cast< void * >( &value ), ++garbage
+				, sizeof( value ) );
+		value.flag = str_value[0];
+		value.count = str_value.size();
+		return true;
+	}
+};
+
+}
+
+/**
+ * Test that observers don't hear about values that only differ in
+ * their padding.
+ */
+TESTPP( test_config_observe_padding )
+{
+	config_option_c< padded_value_c > padded( "padded", "Padded." );
+	configuration_c config;
+	config.add( padded );
+
+	int calls( 0 );
+	config.observe( [ &calls ]( const std::vector< int > & )
+			{ ++calls; } );
+
+	std::stringstream input( "padded=abc\n" );
+	config.parse( input );
+	assertpp( calls ) == 1;
+
+	std::stringstream same( "padded=abc\n" );
+	config.reload( same );
+	assertpp( calls ) == 1;
+
+	std::stringstream changed( "padded=abcd\n" );
+	config.reload( changed );
+	assertpp( calls ) == 2;
+}
+
+/**
+ * Test that a reload doesn't replace values from a higher precedence
+ * source.
+ */
+TESTPP( test_config_reload_keeps_args )
+{
+	config_option_c< int > port( "port", "Port." );
+	configuration_c config;
+	config.add( port );
+	port.merge_value( "22", ARGS_SOURCE );
+
+	std::stringstream input( "port=80\n" );
+	config.reload( input );
+	assertpp( port.size() ) == 1;
+	assertpp( port.value() ) == 22;
+	assertpp( port.source() ) == ARGS_SOURCE;
+}
+
+
+/**
+ * An option that remembers its reserve hint.
+ */
+class hinted_option_c
+: public config_option_c< std::string >
+{
+public:
+	hinted_option_c( const std::string &name )
+	: config_option_c< std::string >( name, "" )
+	, hint( 0 )
+	{}
+
+	virtual void reserve_values( int count )
+	{
+		hint = count;
+		config_option_c< std::string >::reserve_values( count );
+	}
+
+	int hint;
+};
+
+/**
+ * Test that the pre-scan hints how many values each repeated
+ * option is going to get.
+ */
+TESTPP( test_config_reserve_values )
+{
+	hinted_option_c deny( "deny" );
+	hinted_option_c host( "host" );
+	configuration_c config;
+	config.add( deny );
+	config.add( host );
+
+	std::string text( "host = a\ndeny = x\ndeny = y\nother = 1\ndeny = z\n" );
+	config.reserve_values( text.data(), text.data() + text.size() );
+	assertpp( deny.hint ) == 3;
+	assertpp( host.hint ) == 0;
+	assertpp( deny.size() ) == 0;
+}
+
+/**
+ * Test the memory totals and the metrics written for each option.
+ */
+TESTPP( test_config_memory )
+{
+	config_option_c< int > port( "port", "The port." );
+	config_option_c< std::string > name( "name", "The name." );
+	configuration_c config;
+	int port_id( config.add( port ) );
+	config.add( name );
+
+	std::string text( "port = 80\nname = "
+			+ std::string( 64, 'n' ) + "\n" );
+	config.parse( text.data(), text.data() + text.size() );
+	assertpp( config.memory( port_id ).values ) == 1;
+
+	option_memory_c total( config.memory() );
+	assertpp( total.values ) == 2;
+	assertpp( total.inline_bytes ) == sizeof( config ) + sizeof( port )
+		+ sizeof( name );
+	assertpp( total.heap_bytes >= 65 ).t();
+
+	std::ostringstream out;
+	config.write_memory( out );
+	std::string metrics( out.str() );
+	assertpp( metrics.find(
+			"stdopt_config_option_bytes{option=\"port\",storage=\"inline\"} "
+			+ std::to_string( sizeof( port ) ) + "\n" ) != std::string::npos
+		).t();
+	assertpp( metrics.find( "stdopt_config_bytes{storage=\"heap\"} "
+			+ std::to_string( total.heap_bytes ) + "\n" )
+		!= std::string::npos ).t();
+}
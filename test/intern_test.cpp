@@ -0,0 +1,85 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "stdopt/intern.h"
+#include "stdopt/configuration.h"
+#include <testpp/test.h>
+#include <string>
+
+using namespace stdopt;
+
+
+/**
+ * Test that each distinct string is stored once and equal strings get
+ * the same handle.
+ */
+TESTPP( test_string_pool_intern )
+{
+	string_pool_c pool( 64 );
+	interned_string_c a( pool.intern( "us-east-1" ) );
+	std::string copy( "us-east-1" );
+	interned_string_c b( pool.intern( copy ) );
+	interned_string_c c( pool.intern( "eu-west-1" ) );
+	assertpp( a == b ).t();
+	assertpp( a.data() == b.data() ).t();
+	assertpp( a != c ).t();
+	assertpp( a.view() == "us-east-1" ).t();
+	assertpp( pool.size() ) == 2;
+
+	// long strings and enough strings to grow the table
+	std::string path( 200, 'p' );
+	interned_string_c long_path( pool.intern( path ) );
+	for ( int i(0); i<100; ++i ) {
+		pool.intern( "host" + std::to_string( i ) );
+	}
+	assertpp( pool.size() ) == 103;
+	assertpp( pool.intern( path ) == long_path ).t();
+	assertpp( pool.intern( "us-east-1" ) == a ).t();
+	assertpp( a.view() == "us-east-1" ).t();
+	assertpp( long_path.view() == path ).t();
+
+	assertpp( pool.intern( "" ) == interned_string_c() ).t();
+	assertpp( pool.intern( "" ).empty() ).t();
+	assertpp( &pool.intern( "" ).pool() == &pool ).t();
+	assertpp( &interned_string_c().pool() == &string_pool_c::global() ).t();
+}
+
+/**
+ * Test that options intern their values in the pool of their default,
+ * so the same value in different configurations is stored once.
+ */
+TESTPP( test_config_interned_values )
+{
+	string_pool_c regions;
+	config_option_c< interned_string_c > first( interned_string_c( regions )
+			, "region", "The region." );
+	config_option_c< interned_string_c > second( interned_string_c( regions )
+			, "region", "The region." );
+	configuration_c first_config;
+	configuration_c second_config;
+	first_config.add( first );
+	second_config.add( second );
+
+	std::string text( "region = us-east-1\n" );
+	first_config.parse( text.data(), text.data() + text.size() );
+	second_config.parse( text.data(), text.data() + text.size() );
+	assertpp( first.value() == second.value() ).t();
+	assertpp( first.value().view() == "us-east-1" ).t();
+	assertpp( &first.value().pool() == &regions ).t();
+	assertpp( regions.size() ) == 1;
+
+	std::string bytes;
+	assertpp( first.encode_value( 0, bytes ) ).t();
+	assertpp( bytes ) == "us-east-1";
+}
@@ -0,0 +1,108 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "stdopt_single.h"
+#include <testpp/test.h>
+#include <coroutine>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <unistd.h>
+
+using namespace stdopt;
+
+#ifndef STDOPT_COROUTINES
+#error "build this test as C++20 so the loader's awaiter is compiled"
+#endif
+
+
+/**
+ * The least a coroutine needs to run straight away and finish on its
+ * own.
+ */
+class load_task_c
+{
+public:
+	class promise_type
+	{
+	public:
+		load_task_c get_return_object() { return load_task_c(); }
+		std::suspend_never initial_suspend() { return std::suspend_never(); }
+		std::suspend_never final_suspend() noexcept
+		{
+			return std::suspend_never();
+		}
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+static load_task_c await_load( config_loader_c &loader
+		, std::promise< bool > &result )
+{
+	bool ok( co_await loader );
+	result.set_value( ok );
+}
+
+static std::string write_port_file( const char *text )
+{
+	std::ostringstream path;
+	path << "/tmp/stdopt_loader_coroutine_test_" << getpid() << ".conf";
+	std::ofstream file( path.str().c_str() );
+	file << text;
+	return path.str();
+}
+
+
+/**
+ * Test that co_await starts the load and resumes with its result.
+ */
+TESTPP( test_loader_co_await )
+{
+	std::string path( write_port_file( "port = 80\n" ) );
+	config_option_c< int > port( "port", "Port." );
+	configuration_c config;
+	config.add( port );
+
+	config_loader_c loader( config, path );
+	std::promise< bool > result;
+	std::future< bool > ok( result.get_future() );
+	await_load( loader, result );
+	assertpp( ok.get() ).t();
+	assertpp( loader.wait() ).t();
+	unlink( path.c_str() );
+	assertpp( port.value() ) == 80;
+}
+
+/**
+ * Test that awaiting a load that was already started waits for it
+ * instead of suspending forever.
+ */
+TESTPP( test_loader_co_await_started )
+{
+	std::string path( write_port_file( "port = abc\n" ) );
+	config_option_c< int > port( "port", "Port." );
+	configuration_c config;
+	config.add( port );
+
+	config_loader_c loader( config, path );
+	assertpp( loader.start() ).t();
+	std::promise< bool > result;
+	std::future< bool > ok( result.get_future() );
+	await_load( loader, result );
+	assertpp( ok.get() ).f();
+	unlink( path.c_str() );
+	assertpp( config.error() ).t();
+}
@@ -0,0 +1,190 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/loader.h"
+#include <testpp/test.h>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+using namespace stdopt;
+
+
+/**
+ * Write a config file with a port line for each port from 0 up to
+ * count and a host line at the end.
+ */
+static std::string write_config_file( int count )
+{
+	std::ostringstream path;
+	path << "/tmp/stdopt_loader_test_" << getpid() << ".conf";
+	std::ofstream file( path.str().c_str() );
+	for ( int i(0); i<count; ++i ) {
+		file << "port = " << i << "\n";
+	}
+	file << "host=example.com";
+	return path.str();
+}
+
+/**
+ * Load a file in small chunks so lines span chunk boundaries.
+ */
+static void check_chunked_load( bool use_io_uring )
+{
+	std::string path( write_config_file( 500 ) );
+	config_option_c< int > port( "port", "Port." );
+	config_option_c< std::string > host( "host", "Host." );
+	configuration_c config;
+	config.add( port );
+	config.add( host );
+
+	std::atomic< int > called( 0 );
+	config_loader_c loader( config, path, 7 );
+	loader.use_io_uring( use_io_uring );
+	assertpp( loader.start( [ &called ]( bool ok ) { called = ok ? 1 : 2; } )
+		).t();
+	assertpp( loader.wait() ).t();
+	unlink( path.c_str() );
+
+	assertpp( loader.done() ).t();
+	assertpp( loader.read_error() ).f();
+	assertpp( port.size() ) == 500;
+	assertpp( port.value( 0 ) ) == 0;
+	assertpp( port.value( 123 ) ) == 123;
+	assertpp( port.last_value() ) == 499;
+	assertpp( host.value() ) == "example.com";
+	if ( ! use_io_uring ) {
+		assertpp( loader.used_io_uring() ).f();
+	}
+}
+
+TESTPP( test_loader_chunks )
+{
+	check_chunked_load( true );
+}
+
+TESTPP( test_loader_pread_chunks )
+{
+	check_chunked_load( false );
+}
+
+/**
+ * Test that more loads than there are pool workers all finish, and
+ * that a loader can be destroyed by its own callback.
+ */
+TESTPP( test_loader_many_loads )
+{
+	std::string path( write_config_file( 50 ) );
+	const int count( 12 );
+	std::vector< config_option_c< int > * > port;
+	std::vector< configuration_c * > config;
+	std::vector< config_loader_c * > loader;
+	for ( int i(0); i<count; ++i ) {
+		port.push_back( new config_option_c< int >( "port", "Port." ) );
+		config.push_back( new configuration_c() );
+		config.back()->add( *port.back() );
+		loader.push_back( new config_loader_c( *config.back(), path, 64 ) );
+	}
+	for ( int i(0); i<count; ++i ) {
+		assertpp( loader[i]->start() ).t();
+	}
+	for ( int i(0); i<count; ++i ) {
+		loader[i]->wait();
+		assertpp( port[i]->size() ) == 50;
+		assertpp( port[i]->last_value() ) == 49;
+		delete loader[i];
+	}
+
+	config_option_c< int > self_port( "port", "Port." );
+	configuration_c self_config;
+	self_config.add( self_port );
+	config_loader_c *self( new config_loader_c( self_config, path ) );
+	std::promise< bool > result;
+	std::future< bool > finished( result.get_future() );
+	self->start( [ self, &result ]( bool ok )
+			{ delete self; result.set_value( ok ); } );
+	finished.get();
+	unlink( path.c_str() );
+	assertpp( self_port.size() ) == 50;
+
+	for ( int i(0); i<count; ++i ) {
+		delete config[i];
+		delete port[i];
+	}
+}
+
+/**
+ * Test that waiting on a loader that wasn't started doesn't block and
+ * a loader can't be started twice.
+ */
+TESTPP( test_loader_misuse )
+{
+	std::string path( write_config_file( 1 ) );
+	config_option_c< int > port( "port", "Port." );
+	config_option_c< std::string > host( "host", "Host." );
+	configuration_c config;
+	config.add( port );
+	config.add( host );
+
+	config_loader_c loader( config, path );
+	assertpp( loader.wait() ).f();
+	assertpp( loader.done() ).f();
+	assertpp( loader.start() ).t();
+	assertpp( loader.start() ).f();
+	assertpp( loader.wait() ).t();
+	unlink( path.c_str() );
+	assertpp( port.size() ) == 1;
+}
+
+/**
+ * Test that a missing file is reported to the callback.
+ */
+TESTPP( test_loader_missing_file )
+{
+	configuration_c config;
+	std::atomic< int > called( 0 );
+	config_loader_c loader( config, "/nonexistent/stdopt.conf" );
+	loader.start( [ &called ]( bool ok ) { called = ok ? 1 : 2; } );
+	assertpp( loader.wait() ).f();
+	assertpp( loader.read_error() ).t();
+}
+
+/**
+ * Test that parsing stops at a bad value, same as parsing a stream.
+ */
+TESTPP( test_loader_parse_error )
+{
+	std::string path( write_config_file( 0 ) );
+	{
+		std::ofstream file( path.c_str() );
+		file << "port=abc\nport=80\n";
+	}
+	config_option_c< int > port( "port", "Port." );
+	configuration_c config;
+	config.add( port );
+
+	config_loader_c loader( config, path );
+	loader.start();
+	assertpp( loader.wait() ).f();
+	unlink( path.c_str() );
+
+	assertpp( loader.read_error() ).f();
+	assertpp( config.error() ).t();
+	assertpp( port.size() ) == 0;
+}
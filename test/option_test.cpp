@@ -15,6 +15,7 @@
 
 #include <testpp/test.h>
 #include "stdopt/option.h"
+#include "stdopt/constraint.h"
 
 using namespace stdopt;
 
@@ -133,3 +134,260 @@ TESTPP( test_option_value_parse_invalid_value_after_valid )
 	assertpp( num.error() ).t();
 }
 
+
+/**
+ * Test that values outside a range are errors.
+ */
+TESTPP( test_option_value_range )
+{
+	option_value_c< int > port;
+	port.range( 1, 65535 );
+
+	assertpp( port.parse_value( "80" ) ).t();
+	assertpp( port.parse_value( "65536" ) ).f();
+	assertpp( port.error() ).t();
+	assertpp( port.size() ) == 1;
+
+	option_value_c< int > low;
+	low.min( 10 ).max( 20 );
+	assertpp( low.parse_value( "9" ) ).f();
+}
+
+/**
+ * Test the range with bounds known at compile time.
+ */
+TESTPP( test_option_value_static_range )
+{
+	option_value_c< int > port;
+	port.range< 1, 65535 >();
+
+	assertpp( port.parse_value( "1" ) ).t();
+	assertpp( port.parse_value( "65535" ) ).t();
+	assertpp( port.parse_value( "0" ) ).f();
+
+	// bounds narrow each other and still run with other constraints
+	option_value_c< int > narrowed;
+	narrowed.range< 1, 100 >().range< 10, 1000 >().allowed( { 10, 50, 500 } );
+	assertpp( narrowed.parse_value( "10" ) ).t();
+	assertpp( narrowed.parse_value( "50" ) ).t();
+	assertpp( narrowed.parse_value( "500" ) ).f();
+
+	option_value_c< long > count;
+	count.range< 0, 10 >();
+	option_value_c< long > copy( count );
+	assertpp( copy.parse_value( "10" ) ).t();
+	assertpp( copy.parse_value( "11" ) ).f();
+}
+
+/**
+ * Test constraints on the allowed values, length and pattern.
+ */
+TESTPP( test_option_value_allowed )
+{
+	option_value_c< std::string > format;
+	format.allowed( { "xml", "json" } );
+	assertpp( format.parse_value( "json" ) ).t();
+	assertpp( format.parse_value( "yaml" ) ).f();
+
+	option_value_c< std::string > name;
+	name.max_length( 4 );
+	assertpp( name.parse_value( "dogs" ) ).t();
+	assertpp( name.parse_value( "kitty" ) ).f();
+
+	option_value_c< std::string > host;
+	host.constrain( pattern_constraint_c( "[a-z0-9.-]+" ) );
+	assertpp( host.parse_value( "example.com" ) ).t();
+	assertpp( host.parse_value( "Example.com" ) ).f();
+	assertpp( host.size() ) == 1;
+}
+
+/**
+ * Test that options point at a static descriptor.
+ */
+TESTPP( test_shared_option_descriptor )
+{
+	static constexpr option_descriptor_c PORT( 'p', "port", "Port." );
+	shared_option_c< int > port( 80, PORT );
+
+	assertpp( port.usage_character() ) == 'p';
+	assertpp( port.option_name_view() == "port" ).t();
+	assertpp( port.description_view().data()
+			== PORT.description().data() ).t();
+	assertpp( port.value() ) == 80;
+
+	shared_option_c< int > copy( port );
+	assertpp( copy.option_name_view().data()
+			== PORT.option_name().data() ).t();
+
+	shared_option_c< int > named( 'n', "name" );
+	shared_option_c< int > named_copy( named );
+	assertpp( named_copy.option_name_view() == "name" ).t();
+	assertpp( named_copy.option_name_view().data()
+			!= named.option_name_view().data() ).t();
+	assertpp( named_copy.usage_character() ) == 'n';
+
+	// too long to keep inline
+	std::string long_desc( 100, 'd' );
+	shared_option_c< int > described( 'd', "described", long_desc );
+	shared_option_c< int > described_copy( described );
+	assertpp( described_copy.option_name_view() == "described" ).t();
+	assertpp( described_copy.description_view() == long_desc ).t();
+	assertpp( described.memory().heap_bytes ) == 109;
+	assertpp( named.memory().heap_bytes ) == 0;
+
+	// string copies are only made when they're asked for
+	const std::string &name( port.option_name() );
+	assertpp( name ) == "port";
+	assertpp( std::string( port.description().c_str() ) ) == "Port.";
+	assertpp( &port.option_name() == &name ).t();
+	assertpp( port.memory().heap_bytes > 0 ).t();
+	shared_option_c< int > port_copy( port );
+	assertpp( port_copy.memory().heap_bytes ) == 0;
+}
+
+/**
+ * Test that chunked values keep their order across chunks, survive
+ * copies and are cleared by a higher precedence source.
+ */
+TESTPP( test_option_chunked_values )
+{
+	option_value_c< int > num;
+	num.parse_value( "1" );
+	num.chunked( 4 );
+	num.reserve_values( 10 );
+	for ( int i(2); i<=10; ++i ) {
+		num.parse_value( std::to_string( i ) );
+	}
+	assertpp( num.size() ) == 10;
+	assertpp( num.value() ) == 1;
+	assertpp( num.last_value() ) == 10;
+	assertpp( num.value( 5 ) ) == 6;
+
+	int sum( 0 );
+	option_value_c< int >::iterator it( num.begin() );
+	for ( ; it!=num.end(); ++it ) {
+		sum += *it;
+	}
+	assertpp( sum ) == 55;
+	assertpp( num.end() - num.begin() ) == 10;
+
+	option_value_c< int > copy( num );
+	assertpp( copy.size() ) == 10;
+	assertpp( copy.value( 9 ) ) == 10;
+
+	num.merge_value( "7", ARGS_SOURCE );
+	assertpp( num.size() ) == 1;
+	assertpp( num.value() ) == 7;
+}
+
+/**
+ * Test that a consumer gets every value and none are stored.
+ */
+TESTPP( test_option_consume_values )
+{
+	std::vector< std::string > hosts;
+	option_value_c< std::string > upstream;
+	upstream.max_length( 8 );
+	upstream.consume( [ &hosts ]( std::string &&host )
+			{ hosts.push_back( std::move( host ) ); } );
+
+	assertpp( upstream.parse_value( "a" ) ).t();
+	assertpp( upstream.parse_value( "b" ) ).t();
+	assertpp( hosts.size() ) == 2;
+	assertpp( hosts[1] ) == "b";
+	assertpp( upstream.set() ).t();
+	assertpp( upstream.size() ) == 0;
+	assertpp( upstream.value() ) == "";
+
+	assertpp( upstream.parse_value( "too_long_host" ) ).f();
+	assertpp( hosts.size() ) == 2;
+}
+
+/**
+ * Test iterating a bool option, whose values come back by value.
+ */
+TESTPP( test_option_iterate_bool )
+{
+	option_value_c< bool > verbose;
+	verbose.parse_value( "" );
+	verbose.parse_value( "" );
+	verbose.parse_value( "" );
+
+	int count( 0 );
+	option_value_c< bool >::iterator it( verbose.begin() );
+	for ( ; it!=verbose.end(); ++it ) {
+		if ( *it ) {
+			++count;
+		}
+	}
+	assertpp( count ) == 3;
+
+	verbose.chunked( 2 );
+	count = 0;
+	for ( it=verbose.begin(); it!=verbose.end(); ++it ) {
+		if ( *it ) {
+			++count;
+		}
+	}
+	assertpp( count ) == 3;
+}
+
+/**
+ * Guard the size of option objects.  Names and descriptions live in
+ * descriptors, or inline in the option when they're short, so an
+ * option is its values, a few flags and pointers.
+ */
+TESTPP( test_option_sizeof )
+{
+	// values, constraints, vtable, default and flags
+	assertpp( sizeof( option_value_c< int > ) <= 6 * sizeof( void * ) ).t();
+	// plus the interface vtables and the descriptor reference, which
+	// has room for short names inline and a pointer to string copies
+	assertpp( sizeof( descriptor_ref_c ) <= 5 * sizeof( void * ) ).t();
+	assertpp( sizeof( shared_option_c< int > )
+			<= sizeof( option_value_c< int > ) + 7 * sizeof( void * ) ).t();
+}
+
+/**
+ * Test that the memory report counts value storage and the string
+ * buffers too long to fit inside the strings.
+ */
+TESTPP( test_option_memory )
+{
+	option_value_c< int > num;
+	num.reserve_values( 8 );
+	num.parse_value( "1" );
+	option_memory_c num_bytes( num.memory() );
+	assertpp( num_bytes.inline_bytes ) == sizeof( num );
+	assertpp( num_bytes.value_bytes ) == 8 * sizeof( int );
+	assertpp( num_bytes.heap_bytes ) == 0;
+	assertpp( num_bytes.values ) == 1;
+
+	option_value_c< std::string > name;
+	name.parse_value( "a" );
+	assertpp( name.memory().heap_bytes ) == 0;
+	std::string long_name( 100, 'x' );
+	name.parse_value( long_name );
+	std::size_t name_heap( name.memory().heap_bytes );
+	assertpp( name_heap >= 101 ).t();
+	option_value_c< std::string > name_copy( name );
+	assertpp( name_copy.memory().heap_bytes ) == 101;
+	name.merge_value( "b", ARGS_SOURCE );
+	assertpp( name.memory().heap_bytes ) == 0;
+
+	option_value_c< bool > flag;
+	flag.reserve_values( 64 );
+	assertpp( flag.memory().value_bytes <= 8 ).t();
+
+	shared_option_c< int > port( 'p', "port", "The port to listen on." );
+	option_memory_c port_bytes( port.memory() );
+	assertpp( port_bytes.inline_bytes ) == sizeof( port );
+	assertpp( port_bytes.heap_bytes > 0 ).t();
+
+	std::string text;
+	num_bytes.append_metrics( text, "bytes", "a\"b" );
+	assertpp( text ) == "bytes{option=\"a\\\"b\",storage=\"inline\"} "
+		+ std::to_string( sizeof( num ) ) + "\n"
+		"bytes{option=\"a\\\"b\",storage=\"values\"} 32\n"
+		"bytes{option=\"a\\\"b\",storage=\"heap\"} 0\n";
+}
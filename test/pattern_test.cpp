@@ -0,0 +1,92 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/pattern.h"
+#include "stdopt/configuration.h"
+#include <testpp/test.h>
+#include <map>
+#include <sstream>
+
+using namespace stdopt;
+
+
+/**
+ * Test that wildcards capture segments and the most specific pattern
+ * wins.
+ */
+TESTPP( test_pattern_match )
+{
+	pattern_trie_c trie;
+	std::vector< std::string_view > captures;
+	assertpp( trie.heap_bytes() ) == 0;
+	assertpp( trie.match( "backend.db.weight", captures ) ) == -1;
+
+	int weight( trie.insert( "backend.<name>.weight" ) );
+	int timeout( trie.insert( "route.*.timeout" ) );
+	int any_route( trie.insert( "route.*.*" ) );
+	int main_timeout( trie.insert( "route.main.timeout" ) );
+	assertpp( trie.insert( "route.*.timeout" ) ) == timeout;
+	assertpp( trie.size() ) == 4;
+
+	assertpp( trie.match( "backend.db.weight", captures ) ) == weight;
+	assertpp( captures.size() ) == 1;
+	assertpp( captures[0] == "db" ).t();
+
+	assertpp( trie.match( "route.api.timeout", captures ) ) == timeout;
+	assertpp( captures[0] == "api" ).t();
+	assertpp( trie.match( "route.api.retries", captures ) ) == any_route;
+	assertpp( captures.size() ) == 2;
+	assertpp( captures[1] == "retries" ).t();
+	assertpp( trie.match( "route.main.timeout", captures ) ) == main_timeout;
+	assertpp( captures.empty() ).t();
+
+	assertpp( trie.match( "backend.db", captures ) ) == -1;
+	assertpp( trie.match( "backend.db.weight.x", captures ) ) == -1;
+	assertpp( trie.match( "frontend.db.weight", captures ) ) == -1;
+}
+
+/**
+ * Test that keys without an exact option go to the matching pattern
+ * and an exact option still takes its own key.
+ */
+TESTPP( test_config_pattern )
+{
+	config_option_c< int > main_weight( "backend.main.weight", "" );
+	std::map< std::string, int > weights;
+	configuration_c config;
+	config.add( main_weight );
+	config.add_pattern( "backend.<name>.weight"
+			, [ &weights ]( const std::vector< std::string_view > &captures
+				, const std::string &value )
+			{
+				std::istringstream input( value );
+				int weight( 0 );
+				input >> weight;
+				weights[ std::string( captures[0] ) ] = weight;
+				return ! input.fail();
+			} );
+
+	std::string text( "backend.a.weight = 2\nbackend.main.weight = 5\n"
+			"backend.b.weight = 3\n" );
+	assertpp( config.parse( text.data(), text.data() + text.size() ) ).t();
+	assertpp( weights.size() ) == 2;
+	assertpp( weights[ "a" ] ) == 2;
+	assertpp( weights[ "b" ] ) == 3;
+	assertpp( main_weight.value() ) == 5;
+
+	std::string bad( "backend.c.weight = heavy\n" );
+	assertpp( config.parse( bad.data(), bad.data() + bad.size() ) ).f();
+	assertpp( config.error() ).t();
+}
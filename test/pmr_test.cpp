@@ -0,0 +1,129 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/pmr.h"
+#include <testpp/test.h>
+#include <sstream>
+
+using namespace stdopt;
+
+
+/**
+ * A memory resource that counts the bytes currently allocated from it.
+ */
+class counting_resource_c
+: public std::pmr::memory_resource
+{
+public:
+	counting_resource_c()
+	: m_bytes( 0 )
+	{}
+
+	std::size_t bytes() const { return m_bytes; }
+
+private:
+	virtual void * do_allocate( std::size_t bytes, std::size_t align )
+	{
+		m_bytes += bytes;
+		return std::pmr::new_delete_resource()->allocate( bytes, align );
+	}
+
+	virtual void do_deallocate( void *p, std::size_t bytes
+			, std::size_t align )
+	{
+		m_bytes -= bytes;
+		std::pmr::new_delete_resource()->deallocate( p, bytes, align );
+	}
+
+	virtual bool do_is_equal( const std::pmr::memory_resource &r ) const
+		noexcept
+	{
+		return this == &r;
+	}
+
+	std::size_t m_bytes;
+};
+
+
+/**
+ * Test that pmr option values are allocated from the given resource.
+ */
+TESTPP( test_pmr_option_value )
+{
+	counting_resource_c resource;
+	{
+		pmr::option_value_c< int > ports( &resource );
+		ports.parse_value( "4000" );
+		ports.parse_value( "4001" );
+
+		assertpp( ports.value( 1 ) ) == 4001;
+		assertpp( resource.bytes() ) >= 2 * sizeof( int );
+	}
+	assertpp( resource.bytes() ) == 0u;
+}
+
+/**
+ * Test that long pmr strings are allocated from the option's resource.
+ */
+TESTPP( test_pmr_string_option )
+{
+	counting_resource_c resource;
+	{
+		std::pmr::string dflt( "a default long enough to allocate" );
+		pmr::config_option_c< std::pmr::string > host( dflt, "host"
+				, "Host.", &resource );
+		std::size_t default_bytes( resource.bytes() );
+		assertpp( default_bytes ) > dflt.size();
+
+		host.parse_value( "a host name with whitespace that allocates" );
+		assertpp( host.value() )
+			== "a host name with whitespace that allocates";
+		assertpp( host.value().get_allocator().resource() ) == &resource;
+		assertpp( resource.bytes() ) > default_bytes + host.value().size();
+	}
+	assertpp( resource.bytes() ) == 0u;
+}
+
+/**
+ * Test that the configuration and usage allocate from their resource
+ * and parse into pmr options.
+ */
+TESTPP( test_pmr_configuration_and_usage )
+{
+	counting_resource_c resource;
+	{
+		configuration_c config( &resource );
+		assertpp( config.resource() ) == &resource;
+
+		pmr::config_option_c< std::pmr::string > host( "host", "Host."
+				, config.resource() );
+		config.add( host );
+		assertpp( resource.bytes() ) > 0u;
+
+		std::istringstream input( "host=backend-0042.region.example.com\n" );
+		config.parse( input );
+		assertpp( host.value() ) == "backend-0042.region.example.com";
+
+		usage_c usage( &resource );
+		pmr::usage_option_c< int > depth( 'd', "depth", "Depth."
+				, usage.resource() );
+		usage.add( depth );
+
+		const char *argv[20] = { "bin", "-d", "7" };
+		assertpp( usage.parse_args( 3, argv ) ).t();
+		assertpp( depth.value() ) == 7;
+	}
+	assertpp( resource.bytes() ) == 0u;
+}
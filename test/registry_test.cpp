@@ -0,0 +1,176 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/registry.h"
+#include <testpp/test.h>
+#include <cstdlib>
+#include <sstream>
+
+using namespace stdopt;
+
+
+/**
+ * Test that a shared option can be constructed and used directly.
+ */
+TESTPP( test_shared_option_init )
+{
+	shared_option_c< int > port( 8080, 'p', "port", "Port to listen on." );
+
+	assertpp( port.usage_character() ) == 'p';
+	assertpp( port.option_name() ) == "port";
+	assertpp( port.description() ) == "Port to listen on.";
+	assertpp( port.requires_param() ).t();
+	assertpp( port.config_required() ).f();
+	assertpp( port.set() ).f();
+	assertpp( port.value() ) == 8080;
+	assertpp( port.source() ) == DEFAULT_SOURCE;
+}
+
+/**
+ * Test that values from a higher precedence source replace the values
+ * from lower precedence sources.
+ */
+TESTPP( test_merge_value_precedence )
+{
+	option_value_c< int > port;
+
+	port.merge_value( "1", CONFIG_SOURCE );
+	port.merge_value( "2", CONFIG_SOURCE );
+	assertpp( port.size() ) == 2;
+
+	port.merge_value( "3", ARGS_SOURCE );
+	port.merge_value( "4", ENVIRONMENT_SOURCE );
+
+	assertpp( port.source() ) == ARGS_SOURCE;
+	assertpp( port.size() ) == 1;
+	assertpp( port.value() ) == 3;
+}
+
+/**
+ * Test that an error from a lower precedence source is cleared when
+ * a higher precedence source sets the option.
+ */
+TESTPP( test_merge_value_replaces_error )
+{
+	option_value_c< int > port;
+
+	port.merge_value( "dog", CONFIG_SOURCE );
+	assertpp( port.error() ).t();
+
+	port.merge_value( "80", ARGS_SOURCE );
+	assertpp( port.error() ).f();
+	assertpp( port.value() ) == 80;
+}
+
+/**
+ * Test the environment variable names.
+ */
+TESTPP( test_registry_environment_name )
+{
+	option_registry_c registry( "STDOPT_" );
+
+	assertpp( registry.environment_name( "log-level" ) )
+		== "STDOPT_LOG_LEVEL";
+	assertpp( registry.environment_name( "db.host" ) ) == "STDOPT_DB_HOST";
+}
+
+/**
+ * Test that each source is applied in order of precedence.
+ */
+TESTPP( test_registry_parse_precedence )
+{
+	shared_option_c< int > port( 80, 'p', "port" );
+	shared_option_c< std::string > host( 'h', "host" );
+	shared_option_c< int > timeout( 't', "timeout" );
+	shared_option_c< int > depth( 5, 'd', "depth" );
+
+	option_registry_c registry( "STDOPT_TEST_" );
+	registry.add( port );
+	registry.add( host );
+	registry.add( timeout );
+	registry.add( depth );
+
+	setenv( "STDOPT_TEST_HOST", "env.example.com", 1 );
+	setenv( "STDOPT_TEST_PORT", "9000", 1 );
+	std::istringstream config( "port=8000\nhost=cfg.example.com\n"
+			"timeout=30\ntimeout=40\n" );
+	const char *argv[20] = { "bin", "--port=7000" };
+
+	assertpp( registry.parse( 2, argv, config ) ).t();
+	unsetenv( "STDOPT_TEST_HOST" );
+	unsetenv( "STDOPT_TEST_PORT" );
+
+	assertpp( port.value() ) == 7000;
+	assertpp( port.source() ) == ARGS_SOURCE;
+	assertpp( host.value() ) == "env.example.com";
+	assertpp( host.source() ) == ENVIRONMENT_SOURCE;
+	assertpp( timeout.size() ) == 2;
+	assertpp( timeout.last_value() ) == 40;
+	assertpp( timeout.source() ) == CONFIG_SOURCE;
+	assertpp( depth.value() ) == 5;
+	assertpp( depth.set() ).f();
+}
+
+/**
+ * Test that the precedence doesn't depend on the order the sources
+ * are parsed.
+ */
+TESTPP( test_registry_parse_out_of_order )
+{
+	shared_option_c< int > port( 80, 'p', "port" );
+
+	option_registry_c registry;
+	registry.add( port );
+
+	const char *argv[20] = { "bin", "-p", "7000" };
+	std::istringstream config( "port=8000\n" );
+	registry.parse_args( 3, argv );
+	registry.parse_config( config );
+
+	assertpp( registry.error() ).f();
+	assertpp( port.size() ) == 1;
+	assertpp( port.value() ) == 7000;
+}
+
+/**
+ * Test that a bad value in the configuration isn't an error once the
+ * command line replaces it, and doesn't stop the rest of the
+ * configuration from being parsed.
+ */
+TESTPP( test_registry_args_replace_bad_config )
+{
+	shared_option_c< int > port( 80, 'p', "port" );
+	shared_option_c< int > timeout( 't', "timeout" );
+
+	option_registry_c registry;
+	registry.add( port );
+	registry.add( timeout );
+
+	std::istringstream config( "port=eighty\ntimeout=30\n" );
+	const char *argv[20] = { "bin", "--port=8080" };
+	assertpp( registry.parse( 2, argv, config ) ).t();
+	assertpp( registry.error() ).f();
+	assertpp( port.value() ) == 8080;
+	assertpp( timeout.value() ) == 30;
+
+	// without the override the bad value is still an error
+	shared_option_c< int > depth( 'd', "depth" );
+	option_registry_c bad;
+	bad.add( depth );
+	std::istringstream bad_config( "depth=deep\n" );
+	const char *no_args[20] = { "bin" };
+	assertpp( bad.parse( 1, no_args, bad_config ) ).f();
+	assertpp( depth.error() ).t();
+}
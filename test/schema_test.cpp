@@ -0,0 +1,196 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/schema.h"
+#include <testpp/test.h>
+#include <cstring>
+#include <sstream>
+
+using namespace stdopt;
+
+
+/**
+ * Test that the schema indexes its options.
+ */
+TESTPP( test_schema_add )
+{
+	config_schema_c schema;
+	schema_key_c< int > port( schema.add( 80, "port", "Port." ) );
+	schema_key_c< std::string > host( schema.add< std::string >( "host"
+				, "Host." ) );
+
+	assertpp( schema.size() ) == 2;
+	assertpp( port.id() ) == 0;
+	assertpp( host.id() ) == 1;
+	assertpp( schema.find( "port" ) ) == 0;
+	assertpp( schema.find( "host" ) ) == 1;
+	assertpp( schema.find( "dog" ) ) == -1;
+	assertpp( schema.entry( 1 ).option_name() ) == "host";
+	assertpp( schema.default_value( port ) ) == 80;
+}
+
+/**
+ * Test that values are parsed against the schema and defaults come
+ * from the schema.
+ */
+TESTPP( test_values_parse )
+{
+	config_schema_c schema;
+	schema_key_c< int > port( schema.add( 80, "port", "Port." ) );
+	schema_key_c< std::string > host( schema.add< std::string >( "host"
+				, "Host." ) );
+	schema_key_c< int > timeout( schema.add( 30, "timeout", "Timeout." ) );
+
+	config_values_c values( schema );
+	std::istringstream input( "port = 8080\nport=8081\nhost=example.com\n" );
+	assertpp( values.parse( input ) ).t();
+
+	assertpp( values.size() ) == 2;
+	assertpp( values.set( port ) ).t();
+	assertpp( values.set( timeout ) ).f();
+	assertpp( values.value( port ) ) == 8080;
+	assertpp( values.values( port )->size() ) == 2;
+	assertpp( values.values( port )->last_value() ) == 8081;
+	assertpp( values.value( host ) ) == "example.com";
+	assertpp( values.value( timeout ) ) == 30;
+	assertpp( values.values( timeout ) == NULL ).t();
+}
+
+/**
+ * Test that many value sets can share one schema.
+ */
+TESTPP( test_values_share_schema )
+{
+	config_schema_c schema;
+	schema_key_c< int > port( schema.add( 80, "port", "Port." ) );
+
+	config_values_c tenant1( schema );
+	config_values_c tenant2( schema );
+	const char text1[] = "port=1000\n";
+	const char text2[] = "\n";
+	tenant1.parse( text1, text1 + strlen( text1 ) );
+	tenant2.parse( text2, text2 + strlen( text2 ) );
+
+	assertpp( tenant1.value( port ) ) == 1000;
+	assertpp( tenant2.value( port ) ) == 80;
+	assertpp( tenant2.size() ) == 0;
+}
+
+/**
+ * Test that unknown keys and invalid values are errors that don't
+ * stop the rest of the file from being parsed.
+ */
+TESTPP( test_values_errors )
+{
+	config_schema_c schema;
+	schema_key_c< int > port( schema.add( 80, "port", "Port." ) );
+	schema_key_c< int > timeout( schema.add( 30, "timeout", "Timeout." ) );
+
+	config_values_c values( schema );
+	const char text[] = "dog=cat\ntimeout=abc\nport=90\n";
+	assertpp( values.parse( text, text + strlen( text ) ) ).f();
+
+	assertpp( values.error() ).t();
+	assertpp( values.value( port ) ) == 90;
+	assertpp( values.set( timeout ) ).f();
+	assertpp( values.values( timeout )->error() ).t();
+}
+
+/**
+ * Test that each error is recorded with its line and key.
+ */
+TESTPP( test_values_diagnostics )
+{
+	config_schema_c schema;
+	schema_key_c< int > port( schema.add( 80, "port", "Port." ) );
+
+	config_values_c values( schema );
+	const char text[] = "port=90\ndog=cat\nport=abc\n";
+	assertpp( values.parse( text, text + strlen( text ) ) ).f();
+
+	assertpp( values.diagnostics().size() ) == 2;
+	assertpp( values.diagnostics()[0].line() ) == 2;
+	assertpp( values.diagnostics()[0].key() ) == "dog";
+	assertpp( std::string( values.diagnostics()[0].message() ) )
+		== "unknown option";
+	assertpp( values.diagnostics()[1].line() ) == 3;
+	assertpp( values.diagnostics()[1].key() ) == "port";
+	assertpp( std::string( values.diagnostics()[1].message() ) )
+		== "invalid value";
+}
+
+/**
+ * Test the scanner splits lines into key and value spans.
+ */
+TESTPP( test_config_scanner )
+{
+	const char text[] = "a = 1 \r\n\n b=two words\nnovalue=\n=nokey\nc=3";
+	config_scanner_c scanner( text, text + strlen( text ) );
+	std::string_view key;
+	std::string_view value;
+
+	assertpp( scanner.next( key, value ) ).t();
+	assertpp( key ) == "a";
+	assertpp( value ) == "1";
+	assertpp( scanner.line() ) == 1;
+
+	assertpp( scanner.next( key, value ) ).t();
+	assertpp( key ) == "b";
+	assertpp( value ) == "two";
+	assertpp( scanner.line() ) == 3;
+
+	assertpp( scanner.next( key, value ) ).t();
+	assertpp( key ) == "c";
+	assertpp( value ) == "3";
+	assertpp( scanner.line() ) == 6;
+
+	assertpp( scanner.next( key, value ) ).f();
+}
+
+/**
+ * Test that a diff finds added, removed and changed options and skips
+ * values that only differ in how they're written.
+ */
+TESTPP( test_values_diff )
+{
+	config_schema_c schema;
+	schema_key_c< int > port( schema.add( 80, "port", "Port." ) );
+	schema_key_c< std::string > host( schema.add< std::string >( "host"
+				, "Host." ) );
+	schema_key_c< int > timeout( schema.add( 30, "timeout", "Timeout." ) );
+	schema_key_c< int > retries( schema.add( 3, "retries", "Retries." ) );
+
+	config_values_c before( schema );
+	std::istringstream old_input( "port=80\nhost=a\ntimeout=5\n" );
+	before.parse( old_input );
+	config_values_c after( schema );
+	std::istringstream new_input( "port=080\nhost=b\nretries=4\n" );
+	after.parse( new_input );
+
+	std::vector< config_change_c > changes;
+	assertpp( before.diff( after, changes ) ) == 3;
+	assertpp( changes[0].type() ) == config_change_c::CHANGED;
+	assertpp( changes[0].id() ) == host.id();
+	assertpp( changes[0].old_value() == before.values( host ) ).t();
+	assertpp( changes[0].new_value() == after.values( host ) ).t();
+	assertpp( changes[1].type() ) == config_change_c::REMOVED;
+	assertpp( changes[1].key() == "timeout" ).t();
+	assertpp( changes[1].new_value() == NULL ).t();
+	assertpp( changes[2].type() ) == config_change_c::ADDED;
+	assertpp( changes[2].id() ) == retries.id();
+
+	changes.clear();
+	assertpp( after.diff( after, changes ) ) == 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/segment.h"
+#include <testpp/test.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace stdopt;
+
+
+/**
+ * A type that can be parsed but isn't trivially copyable.
+ */
+class name_list_c
+{
+public:
+	std::vector< std::string > names;
+};
+
+static std::istream & operator >> ( std::istream &input, name_list_c &list )
+{
+	std::string name;
+	while ( std::getline( input, name, ',' ) ) {
+		list.names.push_back( name );
+	}
+	input.clear();
+	return input;
+}
+
+
+/**
+ * Test that a configuration exported to a memfd can be read in place
+ * from another process.
+ */
+TESTPP( test_segment_memfd )
+{
+	config_option_c< int > port( "port", "Port." );
+	config_option_c< std::string > host( "host", "Host." );
+	config_option_c< double > ratio( "ratio", "Ratio." );
+	configuration_c config;
+	config.add( port );
+	config.add( host );
+	config.add( ratio );
+	std::istringstream input( "port=80\nhost=example.com\nport=8080\n" );
+	config.parse( input );
+
+	segment_writer_c writer;
+	assertpp( writer.add( config ) ).t();
+	int fd( writer.create_memfd( "stdopt_test" ) );
+	assertpp( fd >= 0 ).t();
+
+	pid_t child( fork() );
+	if ( child == 0 ) {
+		segment_reader_c reader;
+		bool ok( reader.attach( fd ) && reader.size() == 3
+				&& reader.size( reader.find( "port" ) ) == 2
+				&& *reader.value< int >( reader.find( "port" ), 1 ) == 8080
+				&& reader.text( reader.find( "host" ) ) == "example.com" );
+		_exit( ok ? 0 : 1 );
+	}
+	int status( -1 );
+	waitpid( child, &status, 0 );
+	assertpp( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 ).t();
+
+	segment_reader_c reader;
+	assertpp( reader.attach( fd ) ).t();
+	close( fd );
+	assertpp( reader.option_name( 0 ) ) == "host";
+	assertpp( reader.find( "ratio" ) ) == 2;
+	assertpp( reader.size( 2 ) ) == 0;
+	assertpp( reader.find( "dog" ) ) == -1;
+	assertpp( reader.value< int64_t >( 1, 0 ) == NULL ).t();
+	assertpp( reinterpret_cast< uintptr_t >( reader.value< int >( 1, 0 ) )
+			% 16 ) == 0;
+}
+
+/**
+ * Test that usage options are exported to a file and that types that
+ * can't be copied as bytes are refused.
+ */
+TESTPP( test_segment_file )
+{
+	usage_option_c< bool > verbose( 'v', "verbose", "Verbose." );
+	usage_option_c< std::string > output( 'o', "output", "Output." );
+	usage_c usage;
+	usage.add( verbose );
+	usage.add( output );
+	const char *argv[] = { "bin", "-v", "--output=out.txt" };
+	assertpp( usage.parse_args( 3, argv ) ).t();
+
+	segment_writer_c writer;
+	assertpp( writer.add( usage ) ).t();
+	config_option_c< name_list_c > names( "names", "Names." );
+	assertpp( names.parse_value( "a,b" ) ).t();
+	assertpp( writer.add( "names", names ) ).f();
+
+	std::ostringstream path;
+	path << "/tmp/stdopt_segment_test_" << getpid();
+	assertpp( writer.write_file( path.str() ) ).t();
+
+	segment_reader_c reader;
+	assertpp( reader.attach( path.str() ) ).t();
+	unlink( path.str().c_str() );
+	assertpp( reader.size() ) == 2;
+	assertpp( *reader.value< bool >( reader.find( "verbose" ) ) ).t();
+	assertpp( reader.text( reader.find( "output" ) ) ) == "out.txt";
+	assertpp( reader.find( "names" ) ) == -1;
+}
+
+/**
+ * Test that options that weren't set are exported with their default.
+ */
+TESTPP( test_segment_default )
+{
+	config_option_c< int > port( 80, "port", "Port." );
+	config_option_c< std::string > host( std::string( "localhost" )
+			, "host", "Host." );
+	config_option_c< int > timeout( "timeout", "Timeout." );
+	configuration_c config;
+	config.add( port );
+	config.add( host );
+	config.add( timeout );
+	std::istringstream input( "host=example.com\n" );
+	config.parse( input );
+
+	segment_writer_c writer;
+	assertpp( writer.add( config ) ).t();
+	int fd( writer.create_memfd( "stdopt_default_test" ) );
+	assertpp( fd >= 0 ).t();
+	segment_reader_c reader;
+	assertpp( reader.attach( fd ) ).t();
+	close( fd );
+	assertpp( reader.size( reader.find( "port" ) ) ) == 1;
+	assertpp( *reader.value< int >( reader.find( "port" ) ) ) == 80;
+	assertpp( reader.text( reader.find( "host" ) ) ) == "example.com";
+	assertpp( reader.size( reader.find( "timeout" ) ) ) == 0;
+}
+
+/**
+ * Test that writing a file doesn't use a fixed temporary name that
+ * something else might already have.
+ */
+TESTPP( test_segment_file_temp_name )
+{
+	config_option_c< int > port( 80, "port", "Port." );
+	segment_writer_c writer;
+	assertpp( writer.add( "port", port ) ).t();
+
+	std::ostringstream path;
+	path << "/tmp/stdopt_segment_temp_test_" << getpid();
+	std::string fixed_tmp( path.str() + ".tmp" );
+	assertpp( mkdir( fixed_tmp.c_str(), 0700 ) ) == 0;
+	bool written( writer.write_file( path.str() ) );
+	rmdir( fixed_tmp.c_str() );
+	assertpp( written ).t();
+
+	segment_reader_c reader;
+	assertpp( reader.attach( path.str() ) ).t();
+	unlink( path.str().c_str() );
+	assertpp( *reader.value< int >( reader.find( "port" ) ) ) == 80;
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "stdopt_single.h"
+#include <testpp/test.h>
+#include <string>
+
+using namespace stdopt;
+
+
+/**
+ * Find the first recorded event with the given name and key and copy
+ * it to found.
+ * @return false if there isn't one
+ */
+static bool find_event( const char *event, std::string_view key
+		, trace_event_c &found )
+{
+	const trace_recorder_c &trace( trace_recorder_c::global() );
+	for ( std::size_t i(0); i<trace.size(); ++i ) {
+		trace_event_c e( trace.event( i ) );
+		if ( std::string_view( e.event() ) == event && e.key() == key ) {
+			found = e;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Test that parse_args records itself and each option's value, keyed
+ * by the option name and never the value.
+ */
+TESTPP( test_trace_parse_args )
+{
+	trace_recorder_c::global().clear();
+	trace_event_c found;
+	usage_option_c< std::string > password( 'p', "password" );
+	usage_c usage;
+	usage.add( password );
+
+	const char *argv[] = { "bin", "--password=hunter2" };
+	assertpp( usage.parse_args( 2, argv ) ).t();
+
+	assertpp( find_event( "parse_args", "", found ) ).t();
+	assertpp( find_event( "parse_value", "password", found ) ).t();
+	assertpp( found.bytes() ) == 7;
+	assertpp( find_event( "parse_value", "hunter2", found ) ).f();
+}
+
+/**
+ * Test that a configuration parse records the parse, each line and
+ * each value.
+ */
+TESTPP( test_trace_config_parse )
+{
+	trace_recorder_c::global().clear();
+	trace_event_c found;
+	config_option_c< int > port( "port", "" );
+	configuration_c config;
+	config.add( port );
+
+	std::string text( "port = 8080\n" );
+	assertpp( config.parse( text.data(), text.data() + text.size() ) ).t();
+
+	assertpp( find_event( "config_parse", "", found ) ).t();
+	assertpp( find_event( "config_line", "port", found ) ).t();
+	assertpp( find_event( "parse_value", "port", found ) ).t();
+	assertpp( found.bytes() ) == 4;
+}
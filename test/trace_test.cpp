@@ -0,0 +1,114 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/trace.h"
+#include <testpp/test.h>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace stdopt;
+
+
+/**
+ * Test that the recorder keeps the newest events once it wraps
+ * and dumps them oldest first.
+ */
+TESTPP( test_trace_ring_wraps )
+{
+	trace_recorder_c trace( 2 );
+	trace.record( "config_line", "host", 9, 100 );
+	trace.record( "config_line", "port", 2, 200 );
+	trace.record( "parse_value", "", 0, 300 );
+
+	assertpp( trace.recorded() ) == 3;
+	assertpp( trace.size() ) == 2;
+	assertpp( std::string( trace.event( 0 ).key() ) ) == "port";
+
+	std::ostringstream out;
+	trace.dump( out );
+	assertpp( out.str() ) == "config_line port 2 200\nparse_value - 0 300\n";
+
+	trace.clear();
+	assertpp( trace.size() ) == 0;
+}
+
+/**
+ * Test that long keys are cut short instead of overflowing the event.
+ */
+TESTPP( test_trace_long_key )
+{
+	trace_recorder_c trace( 4 );
+	std::string key( 100, 'k' );
+	trace.record( "config_line", key, key.size(), 1 );
+	assertpp( trace.event( 0 ).key().size() ) == trace_event_c::MAX_KEY;
+	assertpp( trace.event( 0 ).bytes() ) == 100;
+}
+
+/**
+ * Test that events recorded from several threads into a ring that
+ * wraps, while another thread reads, are never read torn.
+ */
+TESTPP( test_trace_concurrent_record )
+{
+	trace_recorder_c trace( 8 );
+	const int per_thread( 20000 );
+	std::atomic< int > done( 0 );
+	std::vector< std::thread > writers;
+	for ( int t(0); t<4; ++t ) {
+		writers.push_back( std::thread( [ &trace, &done, t, per_thread ]()
+		{
+			for ( int i(0); i<per_thread; ++i ) {
+				std::uint64_t n( t * per_thread + i );
+				std::string key( "key-" + std::to_string( n ) );
+				trace.record( "config_line", key, n, n * 3 );
+			}
+			++done;
+		} ) );
+	}
+
+	bool torn( false );
+	int read( 0 );
+	bool writing( true );
+	while ( writing ) {
+		writing = done.load() < 4;
+		for ( std::size_t i(0); i<trace.size(); ++i ) {
+			trace_event_c e( trace.event( i ) );
+			if ( ! *e.event() ) {
+				continue;
+			}
+			++read;
+			if ( e.key() != "key-" + std::to_string( e.bytes() )
+					|| e.nanoseconds() != e.bytes() * 3 ) {
+				torn = true;
+			}
+		}
+	}
+	for ( std::size_t t(0); t<writers.size(); ++t ) {
+		writers[ t ].join();
+	}
+
+	assertpp( torn ).f();
+	assertpp( read > 0 ).t();
+	assertpp( trace.recorded() ) == 4u * per_thread;
+	assertpp( trace.size() ) == 8u;
+	std::ostringstream out;
+	trace.dump( out );
+	std::string dumped( out.str() );
+	assertpp( std::count( dumped.begin(), dumped.end(), '\n' ) ) == 8;
+}
@@ -0,0 +1,166 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/units.h"
+#include "stdopt/configuration.h"
+#include "stdopt/usage.h"
+#include <testpp/test.h>
+#include <sstream>
+
+using namespace stdopt;
+
+
+/**
+ * Test byte sizes with binary and decimal suffixes.
+ */
+TESTPP( test_byte_size_suffixes )
+{
+	option_value_c< byte_size_c > size;
+
+	size.parse_value( "512" );
+	size.parse_value( "4GiB" );
+	size.parse_value( "4G" );
+	size.parse_value( "2kB" );
+	size.parse_value( "1.5 MiB" );
+	size.parse_value( "10b" );
+
+	assertpp( size.error() ).f();
+	assertpp( size.size() ) == 6;
+	assertpp( size.value( 0 ).bytes() ) == 512u;
+	assertpp( size.value( 1 ).bytes() ) == 4294967296ull;
+	assertpp( size.value( 2 ).bytes() ) == 4294967296ull;
+	assertpp( size.value( 3 ).bytes() ) == 2000u;
+	assertpp( size.value( 4 ).bytes() ) == 1572864u;
+	assertpp( size.value( 5 ).bytes() ) == 10u;
+}
+
+/**
+ * Test that invalid byte sizes are errors.
+ */
+TESTPP( test_byte_size_invalid )
+{
+	uint64_t bytes;
+	const char bad_unit[] = "4GiBs";
+	const char no_number[] = "GiB";
+	const char too_big[] = "20000PiB";
+
+	assertpp( parse_byte_size( bad_unit, bad_unit + 5, bytes ) ).f();
+	assertpp( parse_byte_size( no_number, no_number + 3, bytes ) ).f();
+	assertpp( parse_byte_size( too_big, too_big + 8, bytes ) ).f();
+
+	option_value_c< byte_size_c > size;
+	size.parse_value( "-4k" );
+	assertpp( size.error() ).t();
+}
+
+/**
+ * Test parsing durations into different std::chrono types.
+ */
+TESTPP( test_duration_suffixes )
+{
+	option_value_c< std::chrono::milliseconds > timeout;
+	timeout.parse_value( "250ms" );
+	timeout.parse_value( "2s" );
+	timeout.parse_value( "1.5m" );
+	timeout.parse_value( "40" );
+
+	assertpp( timeout.error() ).f();
+	assertpp( timeout.value( 0 ).count() ) == 250;
+	assertpp( timeout.value( 1 ).count() ) == 2000;
+	assertpp( timeout.value( 2 ).count() ) == 90000;
+	assertpp( timeout.value( 3 ).count() ) == 40;
+
+	option_value_c< std::chrono::seconds > interval;
+	interval.parse_value( "1h" );
+	assertpp( interval.value().count() ) == 3600;
+
+	option_value_c< std::chrono::duration< double > > fraction;
+	fraction.parse_value( "1500us" );
+	assertpp( fraction.value().count() ) == 0.0015;
+}
+
+/**
+ * Test that a duration that isn't a whole number of ticks is an error.
+ */
+TESTPP( test_duration_inexact )
+{
+	option_value_c< std::chrono::milliseconds > timeout;
+	timeout.parse_value( "1500us" );
+
+	assertpp( timeout.error() ).t();
+	assertpp( timeout.set() ).f();
+}
+
+/**
+ * Test rates with multipliers and periods.
+ */
+TESTPP( test_rate_suffixes )
+{
+	option_value_c< rate_c > rate;
+	rate.parse_value( "10k/s" );
+	rate.parse_value( "500/ms" );
+	rate.parse_value( "120 / m" );
+	rate.parse_value( "7" );
+
+	assertpp( rate.error() ).f();
+	assertpp( rate.value( 0 ).per_second() ) == 10000.0;
+	assertpp( rate.value( 1 ).per_second() ) == 500000.0;
+	assertpp( rate.value( 2 ).per_second() ) == 2.0;
+	assertpp( rate.value( 3 ).per_second() ) == 7.0;
+
+	option_value_c< rate_c > bad;
+	bad.parse_value( "10k/" );
+	assertpp( bad.error() ).t();
+}
+
+/**
+ * Test writing units back out.
+ */
+TESTPP( test_units_output )
+{
+	std::ostringstream out;
+	out << byte_size_c( 4294967296ull ) << ' ' << byte_size_c( 1000 )
+		<< ' ' << rate_c( 250 );
+
+	assertpp( out.str() ) == "4GiB 1000B 250/s";
+}
+
+/**
+ * Test that unit types work from usage and configuration.
+ */
+TESTPP( test_units_usage_and_config )
+{
+	config_option_c< byte_size_c > cache( "cache_size", "Cache size." );
+	config_option_c< std::chrono::milliseconds > timeout( "timeout"
+			, "Timeout." );
+	configuration_c config;
+	config.add( cache );
+	config.add( timeout );
+
+	std::istringstream input( "cache_size=4GiB\ntimeout=250ms\n" );
+	config.parse( input );
+
+	assertpp( config.error() ).f();
+	assertpp( cache.value().bytes() ) == 4294967296ull;
+	assertpp( timeout.value().count() ) == 250;
+
+	usage_option_c< rate_c > rate( 'r', "rate" );
+	usage_c usage;
+	usage.add( rate );
+
+	const char *argv[20] = { "bin", "--rate=10k/s" };
+	assertpp( usage.parse_args( 2, argv ) ).t();
+	assertpp( rate.value().per_second() ) == 10000.0;
+}
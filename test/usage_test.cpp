@@ -15,6 +15,7 @@
 
 #include "stdopt/usage.h"
 #include <testpp/test.h>
+#include <optional>
 #include <sstream>
 
 using namespace stdopt;
@@ -208,14 +209,422 @@ TESTPP( test_mixed_usage )
 
 
 /**
- * Test that option document creation works and formats properly.
-TESTPP( test_option_doc )
+ * Test that the usage document lays out the option columns properly.
+ */
+TESTPP( test_usage_doc )
 {
 	usage_option_c< bool > debug( 'g', "debug", "Write debugging logging." );
-	std::ostringstream doc;
-	debug.write_usage_doc( doc );
+	usage_option_c< int > depth( 'd', "depth", "Depth of something." );
+	usage_option_c< bool > quiet( 0, "quiet" );
+	usage_c usage;
+	usage.add( debug );
+	usage.add( depth );
+	usage.add( quiet );
+
+	usage_doc_c doc( "bin" );
+	std::ostringstream out;
+	doc.write( usage, out );
+
+	assertpp( out.str() ) == "Usage: bin [OPTIONS]\n\n"
+		"Options:\n"
+		"  -g, --debug        Write debugging logging.\n"
+		"  -d, --depth=VALUE  Depth of something.\n"
+		"      --quiet\n";
+}
+
+/**
+ * Test that the cached usage document is rendered again after
+ * an option is added.
+ */
+TESTPP( test_usage_doc_rerender )
+{
+	usage_option_c< bool > debug( 'g', "debug", "Debug." );
+	usage_option_c< bool > verbose( 'v', "verbose", "Verbose." );
+	usage_c usage;
+	usage.add( debug );
+
+	usage_doc_c doc;
+	assertpp( doc.text( usage ) ) == "Options:\n  -g, --debug  Debug.\n";
+
+	usage.add( verbose );
+	assertpp( doc.text( usage ) ) == "Options:\n"
+		"  -g, --debug    Debug.\n"
+		"  -v, --verbose  Verbose.\n";
+}
+
+/**
+ * Test that a different usage built at the same address with the same
+ * number of options isn't given the old text.
+ */
+TESTPP( test_usage_doc_same_address )
+{
+	usage_option_c< bool > debug( 'g', "debug", "Debug." );
+	usage_option_c< bool > quiet( 'q', "quiet", "Quiet." );
+	std::optional< usage_c > usage;
+	usage_doc_c doc;
+
+	usage.emplace();
+	usage->add( debug );
+	assertpp( doc.text( *usage ) ) == "Options:\n  -g, --debug  Debug.\n";
+
+	usage.reset();
+	usage.emplace();
+	usage->add( quiet );
+	assertpp( doc.text( *usage ) ) == "Options:\n  -q, --quiet  Quiet.\n";
+}
+
+/**
+ * Test that the man page is written with roff escapes.
+ */
+TESTPP( test_usage_man )
+{
+	usage_option_c< bool > debug( 'g', "debug", "Write debug-logs." );
+	usage_option_c< int > depth( 0, "depth", ".Depth" );
+	usage_c usage;
+	usage.add( debug );
+	usage.add( depth );
+
+	usage_doc_c doc( "bin" );
+	std::ostringstream out;
+	doc.write_man( usage, out );
+
+	assertpp( out.str() ) == ".TH BIN 1\n"
+		".SH NAME\nbin\n"
+		".SH SYNOPSIS\n.B bin\n[OPTIONS]\n"
+		".SH OPTIONS\n"
+		".TP\n\\fB\\-g\\fR, \\fB\\-\\-debug\\fR\n"
+		"Write debug\\-logs.\n"
+		".TP\n\\fB\\-\\-depth\\fR=\\fIVALUE\\fR\n"
+		"\\&.Depth\n";
+}
+
+/**
+ * Test that a unique prefix of a long option is accepted.
+ */
+TESTPP( test_long_usage_prefix )
+{
+	usage_option_c< bool > verbose( 'v', "verbose" );
+	usage_option_c< int > depth( 'd', "depth" );
+	usage_c usage;
+	usage.add( verbose );
+	usage.add( depth );
+
+	const char *argv[20] = { "bin", "--verb", "--dep=4" };
+	usage.parse_args( 3, argv );
+
+	assertpp( usage.error() ).f();
+	assertpp( verbose.value() ).t();
+	assertpp( depth.value() ) == 4;
+}
+
+/**
+ * Test that an ambiguous prefix is an error that's told apart from an
+ * unknown option, but an exact match that's also a prefix of another
+ * option is not an error.
+ */
+TESTPP( test_long_usage_ambiguous_prefix )
+{
+	usage_option_c< bool > verbose( 'v', "verbose" );
+	usage_option_c< bool > version( 'V', "version" );
+	usage_option_c< bool > ver( 0, "ver" );
+
+	usage_c usage;
+	usage.add( verbose );
+	usage.add( version );
+	usage.add( ver );
+
+	const char *exact[20] = { "bin", "--ver" };
+	assertpp( usage.parse_args( 2, exact ) ).t();
+	assertpp( usage.ambiguous() ).f();
+	assertpp( ver.set() ).t();
+	assertpp( verbose.set() ).f();
+
+	usage_c ambiguous;
+	ambiguous.add( verbose );
+	ambiguous.add( version );
+
+	const char *argv[20] = { "bin", "--ver" };
+	assertpp( ambiguous.parse_args( 2, argv ) ).f();
+	assertpp( ambiguous.ambiguous() ).t();
+	assertpp( verbose.set() ).f();
+	assertpp( version.set() ).f();
+
+	ambiguous.reset();
+	const char *unknown[20] = { "bin", "--quiet" };
+	assertpp( ambiguous.parse_args( 2, unknown ) ).f();
+	assertpp( ambiguous.error() ).t();
+	assertpp( ambiguous.ambiguous() ).f();
+}
+
+/**
+ * Test the --complete query mode.
+ */
+TESTPP( test_complete_args )
+{
+	usage_option_c< bool > verbose( 'v', "verbose" );
+	usage_option_c< bool > version( 'V', "version" );
+	usage_option_c< int > depth( 'd', "depth" );
+	usage_c usage;
+	usage.add( verbose );
+	usage.add( version );
+	usage.add( depth );
+
+	std::ostringstream out;
+	const char *argv[20] = { "bin", "--complete", "--ver" };
+	assertpp( usage.complete_args( 3, argv, out ) ).t();
+	assertpp( out.str() ) == "--verbose\n--version\n";
+
+	std::ostringstream none;
+	const char *args[20] = { "bin", "--verbose" };
+	assertpp( usage.complete_args( 2, args, none ) ).f();
+	assertpp( none.str() ) == "";
+}
+
+/**
+ * Test that the bash completion script is named after the program,
+ * asks the program for --complete matches and quotes the word being
+ * completed.
+ */
+TESTPP( test_bash_completion )
+{
+	usage_doc_c doc( "my-tool" );
+	std::ostringstream out;
+	doc.write_bash_completion( out );
+	assertpp( out.str() ) == "_my_tool_complete()\n"
+		"{\n"
+		"\tlocal cur=\"${COMP_WORDS[COMP_CWORD]}\"\n"
+		"\tcase \"$cur\" in\n"
+		"\t--*)\n"
+		"\t\tCOMPREPLY=( $( \"${COMP_WORDS[0]}\" --complete \"$cur\" ) )\n"
+		"\t\t;;\n"
+		"\tesac\n"
+		"}\n"
+		"complete -o default -F _my_tool_complete my-tool\n";
+}
+
+/**
+ * Test that the zsh completion script is named after the program,
+ * asks the program for --complete matches and quotes the prefix and
+ * the matches it splits by line.
+ */
+TESTPP( test_zsh_completion )
+{
+	usage_doc_c doc( "my-tool" );
+	std::ostringstream out;
+	doc.write_zsh_completion( out );
+	assertpp( out.str() ) == "#compdef my-tool\n"
+		"if [[ \"$PREFIX\" == --* ]]; then\n"
+		"\tlocal -a opts\n"
+		"\topts=( ${(f)\"$( \"${words[1]}\" --complete \"$PREFIX\" )\"} )\n"
+		"\tcompadd -- $opts\n"
+		"else\n"
+		"\t_files\n"
+		"fi\n";
+}
+
+
+/**
+ * An option implemented straight from the interfaces, with names kept
+ * in std::strings.
+ */
+class string_named_option_c
+: public option_value_c< int >
+, public usage_option_i
+{
+public:
+	string_named_option_c( const std::string &name )
+	: m_name( name )
+	, m_description( "Named by a string." )
+	{}
+
+	virtual char usage_character() const { return 0; }
+	virtual const std::string & option_name() const { return m_name; }
+	virtual const std::string & description() const
+	{
+		return m_description;
+	}
+	virtual bool requires_param() const { return true; }
+
+private:
+	std::string m_name;
+	std::string m_description;
+};
 
-	assertpp( doc.str() ) == "\t-g\t--debug\tWrite debugging logging.\n";
+/**
+ * Test that options implementing the string accessors are parsed and
+ * documented through their default views.
+ */
+TESTPP( test_usage_string_named_option )
+{
+	string_named_option_c count( "count" );
+	usage_c usage;
+	usage.add( count );
+	const char *argv[] = { "bin", "--count=4" };
+	assertpp( usage.parse_args( 2, argv ) ).t();
+	assertpp( count.value() ) == 4;
+	assertpp( count.option_name_view() == "count" ).t();
+
+	usage_doc_c doc;
+	assertpp( doc.text( usage ) ) == "Options:\n"
+		"      --count=VALUE  Named by a string.\n";
+}
+
+/**
+ * Test that usage options made from static descriptors parse the
+ * same as ones that own their names.
+ */
+TESTPP( test_usage_descriptor )
+{
+	static constexpr option_descriptor_c VERBOSE( 'v', "verbose"
+			, "Print more." );
+	static constexpr option_descriptor_c DEPTH( 'd', "depth", "Depth." );
+	usage_option_c< bool > verbose( VERBOSE );
+	usage_option_c< int > depth( 3, DEPTH );
+
+	usage_c usage;
+	usage.add( verbose );
+	usage.add( depth );
+	const char *argv[] = { "bin", "-v", "--depth=7" };
+	assertpp( usage.parse_args( 3, argv ) ).t();
+	assertpp( verbose.value() ).t();
+	assertpp( depth.value() ) == 7;
 }
-*/
 
+
+/**
+ * An option that changes how its values are parsed.
+ */
+class upper_option_c
+: public usage_option_c< std::string >
+{
+public:
+	upper_option_c( char short_opt, const std::string &name )
+	: usage_option_c< std::string >( short_opt, name, "" )
+	{}
+
+	virtual bool parse_value( const std::string &str_value )
+	{
+		std::string upper( str_value );
+		for ( std::size_t i(0); i<upper.length(); ++i ) {
+			upper[i] = toupper( upper[i] );
+		}
+		return usage_option_c< std::string >::parse_value( upper );
+	}
+};
+
+/**
+ * Test that subclasses overriding parse_value are still called through
+ * it while the library's own options are parsed directly.
+ */
+TESTPP( test_usage_subclass_parse_value )
+{
+	upper_option_c name( 'n', "name" );
+	upper_option_c alias( 'a', "alias" );
+	usage_option_c< std::string > host( 'h', "host" );
+	usage_c usage;
+	usage.add( name );
+	// added through a reference to the typed base class
+	usage_option_c< std::string > &alias_base( alias );
+	usage.add( alias_base );
+	usage.add( host );
+
+	const char *argv[] = { "bin", "-n", "bob", "--host=example", "-a", "x" };
+	assertpp( usage.parse_args( 6, argv ) ).t();
+	assertpp( name.value() ) == "BOB";
+	assertpp( alias.value() ) == "X";
+	assertpp( host.value() ) == "example";
+}
+
+/**
+ * Test that a reset usage parses the next args from scratch, clearing
+ * errors and values from the last args.
+ */
+TESTPP( test_usage_reset )
+{
+	usage_option_c< bool > verbose( 'v', "verbose" );
+	usage_option_c< int > depth( 'd', "depth" );
+	positional_value_c< std::string > command;
+	usage_c usage;
+	usage.add( verbose );
+	usage.add( depth );
+	usage.add( command );
+
+	const char *bad[] = { "bin", "--depth=deep", "-q" };
+	assertpp( usage.parse_args( 3, bad ) ).f();
+
+	usage.reset();
+	assertpp( usage.error() ).f();
+	assertpp( depth.set() ).f();
+	const char *first[] = { "bin", "-v", "--depth=2", "run" };
+	assertpp( usage.parse_args( 4, first ) ).t();
+	assertpp( verbose.value() ).t();
+	assertpp( depth.value() ) == 2;
+	assertpp( command.value() ) == "run";
+
+	usage.reset();
+	const char *second[] = { "bin", "stop" };
+	assertpp( usage.parse_args( 2, second ) ).t();
+	assertpp( verbose.set() ).f();
+	assertpp( depth.size() ) == 0;
+	assertpp( command.size() ) == 1;
+	assertpp( command.value() ) == "stop";
+}
+
+/**
+ * Test that command lines are split on whitespace with quotes and
+ * escapes, both into an arena and in place.
+ */
+TESTPP( test_command_scanner )
+{
+	std::string arena;
+	command_scanner_c scanner( "say 'a  b' \"c \\\"d\\\" \\n\" e\\ f \"\" g\\\n"
+			, arena );
+	std::vector< std::string > args;
+	std::string_view arg;
+	while ( scanner.next( arg ) ) {
+		args.push_back( std::string( arg ) );
+	}
+	assertpp( scanner.error() ).f();
+	assertpp( args.size() ) == 6;
+	assertpp( args[0] ) == "say";
+	assertpp( args[1] ) == "a  b";
+	assertpp( args[2] ) == "c \"d\" \\n";
+	assertpp( args[3] ) == "e f";
+	assertpp( args[4] ) == "";
+	assertpp( args[5] ) == "g";
+
+	char line[] = "run 'x y'z";
+	command_scanner_c in_place( line, line + sizeof( line ) - 1 );
+	assertpp( in_place.next( arg ) ).t();
+	assertpp( in_place.next( arg ) ).t();
+	assertpp( arg == "x yz" ).t();
+	assertpp( arg.data() == line + 3 ).t();
+
+	command_scanner_c open_quote( "run 'x", arena );
+	assertpp( open_quote.next( arg ) ).t();
+	assertpp( open_quote.next( arg ) ).f();
+	assertpp( open_quote.error() ).t();
+}
+
+/**
+ * Test that a usage parses a whole command line.
+ */
+TESTPP( test_usage_parse_command )
+{
+	usage_option_c< bool > verbose( 'v', "verbose" );
+	usage_option_c< std::string > name( 'n', "name" );
+	positional_value_c< std::string > target;
+	usage_c usage;
+	usage.add( verbose );
+	usage.add( name );
+	usage.add( target );
+
+	assertpp( usage.parse_command( "greet -v -n 'Jo Smith' \"the world\"" ) ).t();
+	assertpp( verbose.value() ).t();
+	assertpp( name.value() ) == "Jo Smith";
+	assertpp( target.value() ) == "the world";
+
+	usage.reset();
+	assertpp( usage.parse_command( "greet --name=\"unclosed" ) ).f();
+	assertpp( usage.error() ).t();
+}
@@ -0,0 +1,111 @@
+#!/bin/sh
+# Copyright 2008 Matthew Graham
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Build the single header version of stdopt.
+#
+#   amalgamate.sh OUTPUT HEADER... -- SOURCE...
+#
+# Headers must be given in dependency order.  Includes of other stdopt
+# headers are dropped.  The sources are wrapped in namespace stdopt, with
+# their stdopt:: qualifications removed, and
+# only compiled where STDOPT_IMPLEMENTATION or STDOPT_HEADER_ONLY is
+# defined.  System includes in the sources are moved out of the
+# namespace, along with any #if block that only holds #include and
+# #define lines.
+
+set -e
+
+# print the part of a source named by $1: "includes" for its system
+# includes, "blocks" for its #if blocks of includes and "body" for the rest
+split_source()
+{
+	awk -v mode="$1" '
+	function flush( hoist ) {
+		if ( ( hoist && mode == "blocks" ) || ( ! hoist && mode == "body" ) )
+			printf "%s", block
+		block = ""
+	}
+	depth == 0 && /^#if/ {
+		depth = 1; block = $0 "\n"; only_includes = 1; next
+	}
+	depth > 0 {
+		block = block $0 "\n"
+		if ( /^#if/ ) depth++
+		else if ( /^#endif/ ) depth--
+		else if ( ! /^#(include|define|else|elif)/ ) only_includes = 0
+		if ( depth == 0 ) flush( only_includes )
+		next
+	}
+	/^#include </ { if ( mode == "includes" ) print; next }
+	/^#include/ || /^using namespace stdopt;/ { next }
+	{ if ( mode == "body" ) print }
+	' "$2"
+}
+
+output="$1"
+shift
+
+headers=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+	headers="$headers $1"
+	shift
+done
+[ "$1" = "--" ] && shift
+sources="$*"
+
+tmp="$output.tmp"
+{
+	echo "#ifndef STDOPT_SINGLE_H"
+	echo "#define STDOPT_SINGLE_H"
+	echo "/**"
+	echo " * Generated by tools/amalgamate.sh.  Do not edit."
+	echo " *"
+	echo " * Define STDOPT_IMPLEMENTATION in exactly one translation unit"
+	echo " * before including this to compile the library there.  Or define"
+	echo " * STDOPT_HEADER_ONLY everywhere it's included to make the whole"
+	echo " * library inline."
+	echo " */"
+	echo
+	for h in $headers; do
+		echo "// ---- $h"
+		grep -v -e '^#include <stdopt/' -e '^#include "' "$h"
+		echo
+	done
+
+	echo "#if defined( STDOPT_IMPLEMENTATION ) || defined( STDOPT_HEADER_ONLY )"
+	echo
+	# system includes have to stay outside of the namespace
+	for s in $sources; do
+		split_source includes "$s"
+	done | sort -u
+	for s in $sources; do
+		split_source blocks "$s"
+	done
+	echo
+	echo "namespace stdopt {"
+	for s in $sources; do
+		echo
+		echo "// ---- $s"
+		# already inside the namespace, so drop qualifications
+		# that gcc rejects there
+		split_source body "$s" | sed 's/stdopt:://g'
+	done
+	echo
+	echo "} // end namespace"
+	echo
+	echo "#endif"
+	echo
+	echo "#endif"
+} > "$tmp"
+mv "$tmp" "$output"
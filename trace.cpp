@@ -0,0 +1,199 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/trace.h"
+#include "stdopt/option.h"
+#include <cstring>
+#include <string>
+
+using namespace stdopt;
+
+
+STDOPT_INLINE
+trace_event_c::trace_event_c()
+: m_event( "" )
+, m_bytes( 0 )
+, m_nanoseconds( 0 )
+, m_key_length( 0 )
+{}
+
+STDOPT_INLINE
+void trace_event_c::set( const char *event, std::string_view key
+		, std::size_t bytes, std::uint64_t nanoseconds )
+{
+	std::size_t length( key.size() < MAX_KEY ? key.size() : MAX_KEY );
+	m_event = event;
+	m_bytes = bytes;
+	m_nanoseconds = nanoseconds;
+	m_key_length = length;
+	memcpy( m_key, key.data(), length );
+}
+
+
+STDOPT_INLINE
+trace_recorder_c::slot::slot()
+: sequence( 0 )
+, event( "" )
+, bytes( 0 )
+, nanoseconds( 0 )
+{
+	for ( std::size_t i(0); i<KEY_WORDS; ++i ) {
+		key[ i ].store( 0, std::memory_order_relaxed );
+	}
+}
+
+
+STDOPT_INLINE
+trace_recorder_c::trace_recorder_c( std::size_t capacity )
+: m_slot( capacity ? capacity : 1 )
+, m_next( 0 )
+, m_first( 0 )
+{}
+
+STDOPT_INLINE
+trace_recorder_c & trace_recorder_c::global()
+{
+	static trace_recorder_c recorder;
+	return recorder;
+}
+
+STDOPT_INLINE
+void trace_recorder_c::record( const char *event, std::string_view key
+		, std::size_t bytes, std::uint64_t nanoseconds )
+{
+	std::uint64_t n( m_next.fetch_add( 1, std::memory_order_relaxed ) );
+	slot &s( m_slot[ n % m_slot.size() ] );
+	const std::uint64_t written( 2 * ( n + 1 ) );
+
+	// claim the slot, unless a newer event already has
+	std::uint64_t seq( s.sequence.load( std::memory_order_relaxed ) );
+	for ( ;; ) {
+		if ( seq >= written ) {
+			return;
+		}
+		if ( seq & 1 ) {
+			// an older event is still being written
+			seq = s.sequence.load( std::memory_order_relaxed );
+			continue;
+		}
+		if ( s.sequence.compare_exchange_weak( seq, written + 1
+					, std::memory_order_acquire
+					, std::memory_order_relaxed ) ) {
+			break;
+		}
+	}
+	// keep the writes below from moving above the claim
+	std::atomic_thread_fence( std::memory_order_release );
+
+	char packed[ KEY_WORDS * sizeof( std::uint64_t ) ] = {};
+	std::size_t length( key.size() < trace_event_c::MAX_KEY ? key.size()
+			: trace_event_c::MAX_KEY );
+	memcpy( packed, key.data(), length );
+	packed[ sizeof( packed ) - 1 ] = char( length );
+	for ( std::size_t i(0); i<KEY_WORDS; ++i ) {
+		std::uint64_t word;
+		memcpy( &word, packed + i * sizeof( word ), sizeof( word ) );
+		s.key[ i ].store( word, std::memory_order_relaxed );
+	}
+	s.event.store( event, std::memory_order_relaxed );
+	s.bytes.store( bytes, std::memory_order_relaxed );
+	s.nanoseconds.store( nanoseconds, std::memory_order_relaxed );
+	s.sequence.store( written, std::memory_order_release );
+}
+
+STDOPT_INLINE
+bool trace_recorder_c::read( std::uint64_t n, trace_event_c &e ) const
+{
+	const slot &s( m_slot[ n % m_slot.size() ] );
+	const std::uint64_t written( 2 * ( n + 1 ) );
+	if ( s.sequence.load( std::memory_order_acquire ) != written ) {
+		return false;
+	}
+
+	char packed[ KEY_WORDS * sizeof( std::uint64_t ) ];
+	for ( std::size_t i(0); i<KEY_WORDS; ++i ) {
+		std::uint64_t word( s.key[ i ].load( std::memory_order_relaxed ) );
+		memcpy( packed + i * sizeof( word ), &word, sizeof( word ) );
+	}
+	const char *event( s.event.load( std::memory_order_relaxed ) );
+	std::uint64_t bytes( s.bytes.load( std::memory_order_relaxed ) );
+	std::uint64_t nanoseconds( s.nanoseconds.load(
+				std::memory_order_relaxed ) );
+
+	// keep the reads above from moving below the check
+	std::atomic_thread_fence( std::memory_order_acquire );
+	if ( s.sequence.load( std::memory_order_relaxed ) != written ) {
+		return false;
+	}
+	std::size_t length( static_cast< unsigned char >(
+				packed[ sizeof( packed ) - 1 ] ) );
+	e.set( event, std::string_view( packed, length ), bytes, nanoseconds );
+	return true;
+}
+
+STDOPT_INLINE
+std::uint64_t trace_recorder_c::oldest() const
+{
+	std::uint64_t next( m_next.load( std::memory_order_acquire ) );
+	std::uint64_t first( m_first.load( std::memory_order_acquire ) );
+	if ( next - first > m_slot.size() ) {
+		return next - m_slot.size();
+	}
+	return first;
+}
+
+STDOPT_INLINE
+std::size_t trace_recorder_c::size() const
+{
+	std::uint64_t n( recorded() );
+	return n < m_slot.size() ? n : m_slot.size();
+}
+
+STDOPT_INLINE
+trace_event_c trace_recorder_c::event( std::size_t i ) const
+{
+	trace_event_c e;
+	if ( ! read( oldest() + i, e ) ) {
+		return trace_event_c();
+	}
+	return e;
+}
+
+STDOPT_INLINE
+void trace_recorder_c::dump( std::ostream &out ) const
+{
+	std::string text;
+	std::uint64_t first( oldest() );
+	std::uint64_t next( m_next.load( std::memory_order_acquire ) );
+	trace_event_c e;
+	for ( std::uint64_t n(first); n<next; ++n ) {
+		if ( ! read( n, e ) ) {
+			continue;
+		}
+		text += e.event();
+		text += ' ';
+		if ( e.key().empty() ) {
+			text += '-';
+		} else {
+			text += e.key();
+		}
+		text += ' ';
+		text += std::to_string( e.bytes() );
+		text += ' ';
+		text += std::to_string( e.nanoseconds() );
+		text += '\n';
+	}
+	out.write( text.data(), text.size() );
+}
@@ -0,0 +1,288 @@
+/**
+ * Copyright 2008 Matthew Graham
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stdopt/units.h"
+
+using namespace stdopt;
+
+
+namespace {
+
+struct unit_s
+{
+	const char *suffix;
+	long double scale;
+};
+
+const unit_s SIZE_UNITS[] = {
+	{ "b", 1.0L },
+	{ "k", 1024.0L },
+	{ "kib", 1024.0L },
+	{ "kb", 1e3L },
+	{ "m", 1048576.0L },
+	{ "mib", 1048576.0L },
+	{ "mb", 1e6L },
+	{ "g", 1073741824.0L },
+	{ "gib", 1073741824.0L },
+	{ "gb", 1e9L },
+	{ "t", 1099511627776.0L },
+	{ "tib", 1099511627776.0L },
+	{ "tb", 1e12L },
+	{ "p", 1125899906842624.0L },
+	{ "pib", 1125899906842624.0L },
+	{ "pb", 1e15L },
+	{ NULL, 0 }
+};
+
+const unit_s TIME_UNITS[] = {
+	{ "ns", 1.0L },
+	{ "us", 1e3L },
+	{ "ms", 1e6L },
+	{ "s", 1e9L },
+	{ "m", 60e9L },
+	{ "min", 60e9L },
+	{ "h", 3600e9L },
+	{ "d", 86400e9L },
+	{ NULL, 0 }
+};
+
+const unit_s COUNT_UNITS[] = {
+	{ "k", 1e3L },
+	{ "K", 1e3L },
+	{ "M", 1e6L },
+	{ "G", 1e9L },
+	{ NULL, 0 }
+};
+
+/**
+ * The first value that doesn't fit in 64 bits.
+ */
+const long double TWO_POW_64( 18446744073709551616.0L );
+
+
+const char * skip_space( const char *p, const char *end )
+{
+	while ( p != end && ( *p == ' ' || *p == '\t' || *p == '\r'
+				|| *p == '\n' ) ) {
+		++p;
+	}
+	return p;
+}
+
+bool is_letter( char c )
+{
+	return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' );
+}
+
+char lower( char c )
+{
+	return ( c >= 'A' && c <= 'Z' ) ? c - 'A' + 'a' : c;
+}
+
+/**
+ * Parse an unsigned decimal number with an optional fraction.
+ * p is left after the number.
+ */
+bool parse_decimal( const char *&p, const char *end, long double &value )
+{
+	bool digits( false );
+	value = 0;
+	for ( ; p != end && *p >= '0' && *p <= '9'; ++p ) {
+		value = value * 10 + ( *p - '0' );
+		digits = true;
+	}
+	if ( p != end && *p == '.' ) {
+		long double place( 0.1L );
+		for ( ++p; p != end && *p >= '0' && *p <= '9'; ++p ) {
+			value += ( *p - '0' ) * place;
+			place /= 10;
+			digits = true;
+		}
+	}
+	return digits;
+}
+
+/**
+ * Match the run of letters at p against a table of units.  An empty
+ * run matches with a scale of 1.  p is left after the letters.
+ * @return false if the letters aren't a unit in the table
+ */
+bool parse_unit( const char *&p, const char *end, const unit_s *units
+		, bool ignore_case, long double &scale, bool &has_unit )
+{
+	const char *start( p );
+	while ( p != end && is_letter( *p ) ) {
+		++p;
+	}
+	has_unit = p != start;
+	if ( ! has_unit ) {
+		scale = 1;
+		return true;
+	}
+
+	std::size_t length( p - start );
+	for ( ; units->suffix; ++units ) {
+		const char *suffix( units->suffix );
+		std::size_t i( 0 );
+		for ( ; i < length && suffix[i]; ++i ) {
+			char c( ignore_case ? lower( start[i] ) : start[i] );
+			if ( c != suffix[i] ) {
+				break;
+			}
+		}
+		if ( i == length && ! suffix[i] ) {
+			scale = units->scale;
+			return true;
+		}
+	}
+	return false;
+}
+
+} // end namespace
+
+
+STDOPT_INLINE
+bool stdopt::parse_byte_size( const char *begin, const char *end
+		, uint64_t &bytes )
+{
+	const char *p( skip_space( begin, end ) );
+	long double value;
+	long double scale;
+	bool has_unit;
+	if ( ! parse_decimal( p, end, value ) ) {
+		return false;
+	}
+	p = skip_space( p, end );
+	if ( ! parse_unit( p, end, SIZE_UNITS, true, scale, has_unit ) ) {
+		return false;
+	}
+	if ( skip_space( p, end ) != end ) {
+		return false;
+	}
+
+	value = std::floor( value * scale + 0.5L );
+	if ( value >= TWO_POW_64 ) {
+		return false;
+	}
+	bytes = static_cast< uint64_t >( value );
+	return true;
+}
+
+STDOPT_INLINE
+bool stdopt::parse_duration( const char *begin, const char *end
+		, long double unit_ns, long double &count )
+{
+	const char *p( skip_space( begin, end ) );
+	long double scale;
+	bool has_unit;
+	if ( ! parse_decimal( p, end, count ) ) {
+		return false;
+	}
+	p = skip_space( p, end );
+	if ( ! parse_unit( p, end, TIME_UNITS, false, scale, has_unit ) ) {
+		return false;
+	}
+	if ( skip_space( p, end ) != end ) {
+		return false;
+	}
+
+	if ( has_unit ) {
+		count = count * scale / unit_ns;
+	}
+	return true;
+}
+
+STDOPT_INLINE
+bool stdopt::parse_rate( const char *begin, const char *end
+		, double &per_second )
+{
+	const char *p( skip_space( begin, end ) );
+	long double value;
+	long double count_scale;
+	long double period_ns( 1e9L );
+	bool has_unit;
+	if ( ! parse_decimal( p, end, value ) ) {
+		return false;
+	}
+	p = skip_space( p, end );
+	if ( ! parse_unit( p, end, COUNT_UNITS, false, count_scale
+				, has_unit ) ) {
+		return false;
+	}
+	p = skip_space( p, end );
+	if ( p != end && *p == '/' ) {
+		p = skip_space( p + 1, end );
+		if ( ! parse_unit( p, end, TIME_UNITS, false, period_ns
+					, has_unit ) || ! has_unit ) {
+			return false;
+		}
+	}
+	if ( skip_space( p, end ) != end ) {
+		return false;
+	}
+
+	per_second = static_cast< double >( value * count_scale * 1e9L
+			/ period_ns );
+	return true;
+}
+
+
+STDOPT_INLINE
+bool value_parser_c< byte_size_c >::parse( const std::string &str_value
+		, byte_size_c &value )
+{
+	uint64_t bytes;
+	const char *begin( str_value.data() );
+	if ( ! parse_byte_size( begin, begin + str_value.size(), bytes ) ) {
+		return false;
+	}
+	value = byte_size_c( bytes );
+	return true;
+}
+
+STDOPT_INLINE
+bool value_parser_c< rate_c >::parse( const std::string &str_value
+		, rate_c &value )
+{
+	double per_second;
+	const char *begin( str_value.data() );
+	if ( ! parse_rate( begin, begin + str_value.size(), per_second ) ) {
+		return false;
+	}
+	value = rate_c( per_second );
+	return true;
+}
+
+
+STDOPT_INLINE
+std::ostream & stdopt::operator << ( std::ostream &out
+		, const byte_size_c &size )
+{
+	static const char *UNITS[] = { "B", "KiB", "MiB", "GiB", "TiB", "PiB"
+		, "EiB" };
+	uint64_t bytes( size.bytes() );
+	int unit( 0 );
+	while ( bytes && bytes % 1024 == 0 ) {
+		bytes /= 1024;
+		++unit;
+	}
+	return out << bytes << UNITS[ unit ];
+}
+
+STDOPT_INLINE
+std::ostream & stdopt::operator << ( std::ostream &out, const rate_c &rate )
+{
+	return out << rate.per_second() << "/s";
+}
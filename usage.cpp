@@ -17,53 +17,242 @@
 #include <iostream>
 #include <sstream>
 #include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <atomic>
 
 using namespace stdopt;
 
 
-/*
-void usage_option_c::write_usage_doc( std::ostream &doc ) const
+/**
+ * Order options by their long name.
+ */
+static bool long_name_less( const option_record_c &a
+		, const option_record_c &b )
 {
-	if ( m_short_opt ) {
-		doc << "\t-" << m_short_opt;
-	}
+	return a.option_name() < b.option_name();
+}
+
+/**
+ * Compare an option's long name to a search string for lower_bound.
+ */
+static bool long_name_before( const option_record_c &opt
+		, std::string_view name )
+{
+	return opt.option_name() < name;
+}
+
+/**
+ * Check if the option's long name starts with the given prefix.
+ */
+static bool long_name_starts_with( const option_record_c &opt
+		, std::string_view prefix )
+{
+	return opt.option_name().substr( 0, prefix.length() ) == prefix;
+}
+
 
-	if ( ! m_long_opt.empty() ) {
-		doc << "\t--" << m_long_opt;
+STDOPT_INLINE
+usage_c::usage_c()
+: m_option()
+, m_positional()
+, m_long_index()
+, m_long_index_sorted( true )
+, m_value_buffer()
+, m_command_buffer()
+, m_generation( next_generation() )
+, m_error( false )
+, m_ambiguous( false )
+{}
+
+STDOPT_INLINE
+usage_c::usage_c( std::pmr::memory_resource *resource )
+: m_option( resource )
+, m_positional( resource )
+, m_long_index( resource )
+, m_long_index_sorted( true )
+, m_value_buffer()
+, m_command_buffer()
+, m_generation( next_generation() )
+, m_error( false )
+, m_ambiguous( false )
+{}
+
+STDOPT_INLINE
+void usage_c::add_record( const option_record_c &record )
+{
+	m_option.push_back( record );
+	if ( ! record.option_name().empty() ) {
+		m_long_index.push_back( record );
+		m_long_index_sorted = false;
 	}
+	m_generation = next_generation();
+}
 
-	if ( ! m_description.empty() ) {
-		doc << "\t" << m_description;
+STDOPT_INLINE
+uint64_t usage_c::next_generation()
+{
+	static std::atomic< uint64_t > generation( 0 );
+	return ++generation;
+}
+
+STDOPT_INLINE
+void usage_c::reset()
+{
+	option_list::const_iterator it;
+	for ( it=m_option.begin(); it!=m_option.end(); ++it ) {
+		it->usage_option()->clear_source( ARGS_SOURCE );
+	}
+	positional_list::iterator pos;
+	for ( pos=m_positional.begin(); pos!=m_positional.end(); ++pos ) {
+		( *pos )->clear_source( ARGS_SOURCE );
 	}
+	m_error = false;
+	m_ambiguous = false;
+}
 
-	doc << std::endl;
+STDOPT_INLINE
+option_memory_c usage_c::memory() const
+{
+	option_memory_c bytes( table_memory() );
+	option_list::const_iterator it;
+	for ( it=m_option.begin(); it!=m_option.end(); ++it ) {
+		bytes += it->usage_option()->memory();
+	}
+	positional_list::const_iterator pos;
+	for ( pos=m_positional.begin(); pos!=m_positional.end(); ++pos ) {
+		bytes += ( *pos )->memory();
+	}
+	return bytes;
 }
-*/
 
+STDOPT_INLINE
+option_memory_c usage_c::table_memory() const
+{
+	option_memory_c bytes;
+	bytes.inline_bytes = sizeof( *this );
+	// a list node holds the pointer and two links
+	bytes.heap_bytes = ( m_option.capacity() + m_long_index.capacity() )
+			* sizeof( option_record_c )
+		+ m_positional.size() * 3 * sizeof( void * )
+		+ value_footprint_c< std::string >::heap_bytes( m_value_buffer )
+		+ value_footprint_c< std::string >::heap_bytes( m_command_buffer );
+	return bytes;
+}
 
-void usage_c::add( usage_option_i &option )
+STDOPT_INLINE
+void usage_c::write_memory( std::ostream &out
+		, std::string_view prefix ) const
 {
-	m_option.push_back( &option );
+	std::string metric( prefix );
+	metric += "_option_bytes";
+	std::string text;
+	std::string label;
+	option_memory_c total( table_memory() );
+	option_memory_c bytes;
+	option_list::const_iterator it;
+	for ( it=m_option.begin(); it!=m_option.end(); ++it ) {
+		label.assign( it->option_name().data(), it->option_name().size() );
+		if ( label.empty() ) {
+			label.assign( 1, it->usage_character() );
+		}
+		bytes = it->usage_option()->memory();
+		bytes.append_metrics( text, metric, label );
+		total += bytes;
+	}
+	int position( 0 );
+	positional_list::const_iterator pos;
+	for ( pos=m_positional.begin(); pos!=m_positional.end(); ++pos ) {
+		label = "#" + std::to_string( ++position );
+		bytes = ( *pos )->memory();
+		bytes.append_metrics( text, metric, label );
+		total += bytes;
+	}
+	metric.assign( prefix.data(), prefix.size() );
+	metric += "_bytes";
+	total.append_metrics( text, metric, std::string_view() );
+	out.write( text.data(), text.size() );
 }
 
+/**
+ * Gives parse_tokens the args from an argv array.
+ */
+class usage_c::argv_scanner_c
+{
+public:
+	argv_scanner_c( int argc, const char **argv )
+	: m_arg( argv )
+	, m_end( argv + argc )
+	{}
+
+	bool next( std::string_view &arg )
+	{
+		if ( m_arg == m_end ) {
+			return false;
+		}
+		arg = *m_arg++;
+		return true;
+	}
+
+private:
+	const char **m_arg;
+	const char **m_end;
+};
+
+
+STDOPT_INLINE
 bool usage_c::parse_args( int argc, const char **argv )
+{
+	argv_scanner_c args( argc, argv );
+	return parse_tokens( args );
+}
+
+STDOPT_INLINE
+bool usage_c::parse_command( std::string_view line )
+{
+	command_scanner_c args( line, m_command_buffer );
+	bool ok( parse_tokens( args ) );
+	if ( args.error() ) {
+		m_error = true;
+	}
+	return ok && ! args.error();
+}
+
+STDOPT_INLINE
+bool usage_c::parse_command( char *begin, char *end )
+{
+	command_scanner_c args( begin, end );
+	bool ok( parse_tokens( args ) );
+	if ( args.error() ) {
+		m_error = true;
+	}
+	return ok && ! args.error();
+}
+
+template < typename Args >
+STDOPT_INLINE
+bool usage_c::parse_tokens( Args &args )
 {
 	positional_list::iterator pos_it( m_positional.begin() );
+	std::size_t count( 0 );
+	STDOPT_EVENT_START( parse_args, parse_timer, std::string_view(), 0 );
 
 	// skip the first arg which is the command
-	for ( int i(1); i<argc; ++i ) {
-		// usage_error = usage_error || 
-		// std::cerr << "argv[" << i << "] = " << argv[i] << std::endl;
+	std::string_view arg;
+	std::string_view next_arg;
+	bool has_next( args.next( next_arg ) && args.next( next_arg ) );
+	while ( has_next ) {
+		arg = next_arg;
+		has_next = args.next( next_arg );
+		++count;
 
 		bool consumed_param( false );
-		if ( long_style_arg( argv[i] ) ) {
-			parse_long_arg( argv[i] + 2 );
-		} else if ( short_style_arg( argv[i] ) ) {
-			std::string short_param;
-			if ( i + 1 < argc ) {
-				short_param = argv[i+1];
-			}
-			parse_short_args( argv[i] + 1, short_param
+		if ( long_style_arg( arg ) ) {
+			parse_long_arg( arg.substr( 2 ) );
+		} else if ( short_style_arg( arg ) ) {
+			std::string_view short_param( has_next ? next_arg
+					: std::string_view() );
+			parse_short_args( arg.substr( 1 ), short_param
 					, consumed_param );
 		} else {
 			// positional arg
@@ -71,73 +260,85 @@ bool usage_c::parse_args( int argc, const char **argv )
 				m_error = true;
 				continue;
 			}
-			(*pos_it)->parse_value( argv[i] );
+			m_value_buffer.assign( arg );
+			(*pos_it)->merge_value( m_value_buffer, ARGS_SOURCE );
 			++pos_it;
 		}
 
 		if ( consumed_param ) {
-			++i;
+			has_next = args.next( next_arg );
+			++count;
 		}
 	}
 
+	// the size of a whole parse is its number of args
+	STDOPT_EVENT_END( parse_args, parse_timer, std::string_view(), count );
 	return ! m_error;
 }
 
-bool usage_c::short_style_arg( const char *arg )
+STDOPT_INLINE
+bool usage_c::short_style_arg( std::string_view arg )
 {
-	return arg[0] == '-' && arg[1] != '-';
+	return ! arg.empty() && arg[0] == '-'
+		&& ( arg.size() == 1 || arg[1] != '-' );
 }
 
-bool usage_c::long_style_arg( const char *arg )
+STDOPT_INLINE
+bool usage_c::long_style_arg( std::string_view arg )
 {
-	return arg[0] == '-' && arg[1] == '-';
+	return arg.size() >= 2 && arg[0] == '-' && arg[1] == '-';
 }
 
-void usage_c::parse_short_args( const std::string &args
-		, const std::string &param, bool &consumed_param )
+STDOPT_INLINE
+void usage_c::parse_short_args( std::string_view args
+		, std::string_view param, bool &consumed_param )
 {
-	std::string::const_iterator it( args.begin() );
+	std::string_view::const_iterator it( args.begin() );
 	for ( ; it!=args.end(); ++it ) {
 		// short option
-		usage_option_i *option = find_short_option( *it );
+		const option_record_c *option = find_short_option( *it );
 		if ( ! option ) {
 			// this option is not found
 			// flag as error
 			m_error = true;
+			continue;
 		}
 
 		if ( option->requires_param() ) {
 			if ( ! param.empty() ) {
 				consumed_param = true;
-				option->parse_value( param );
+				m_value_buffer.assign( param );
+				option->merge_value( m_value_buffer, ARGS_SOURCE );
 			} else {
 				m_error = true;
 			}
 		} else {
-			std::string no_param;
-			option->parse_value( no_param );
+			m_value_buffer.clear();
+			option->merge_value( m_value_buffer, ARGS_SOURCE );
 		}
 	}
 }
 
-void usage_c::parse_long_arg( const std::string &arg )
+STDOPT_INLINE
+void usage_c::parse_long_arg( std::string_view arg )
 {
-	std::string option_name;
-	std::string option_value;
-	bool has_value;
+	std::string_view option_name( arg );
+	bool has_value( false );
 
-	std::size_t equal_pos( arg.find( "=" ) );
-	if ( equal_pos == std::string::npos ) {
-		option_name = arg;
-	} else {
+	m_value_buffer.clear();
+	std::size_t equal_pos( arg.find( '=' ) );
+	if ( equal_pos != std::string_view::npos ) {
 		option_name = arg.substr( 0, equal_pos );
-		option_value = arg.substr( equal_pos + 1 );
+		m_value_buffer.assign( arg.substr( equal_pos + 1 ) );
 		has_value = true;
 	}
 
-	usage_option_i *option = find_long_option( option_name );
+	bool ambiguous( false );
+	const option_record_c *option = find_long_option( option_name
+			, ambiguous );
 	if ( ! option ) {
 		m_error = true;
+		m_ambiguous = m_ambiguous || ambiguous;
 		return;
 	}
 
@@ -146,43 +347,343 @@ void usage_c::parse_long_arg( const std::string &arg )
 		return;
 	}
 
-	option->parse_value( option_value );
+	option->merge_value( m_value_buffer, ARGS_SOURCE );
 }
 
-usage_option_i * usage_c::find_short_option( char short_opt )
+STDOPT_INLINE
+const option_record_c * usage_c::find_short_option( char short_opt ) const
 {
-	option_list::iterator it;
+	option_list::const_iterator it;
 	for ( it=m_option.begin(); it!=m_option.end(); ++it ) {
-		usage_option_i &opt( **it );
-		if ( opt.usage_character() == short_opt ) {
-			return &opt;
+		if ( it->usage_character() == short_opt ) {
+			return &*it;
 		}
 	}
 	return NULL;
 }
 
-usage_option_i * usage_c::find_long_option( const std::string &long_opt )
+STDOPT_INLINE
+const option_record_c * usage_c::find_long_option(
+		std::string_view long_opt, bool &ambiguous ) const
 {
-	option_list::iterator it;
-	for ( it=m_option.begin(); it!=m_option.end(); ++it ) {
-		usage_option_i &opt( **it );
-		if ( opt.option_name() == long_opt ) {
-			return &opt;
+	const option_list &index( long_index() );
+	option_list::const_iterator it( std::lower_bound( index.begin()
+				, index.end(), long_opt, long_name_before ) );
+	if ( it == index.end() || ! long_name_starts_with( *it, long_opt ) ) {
+		return NULL;
+	}
+
+	// an exact match always wins, even if it's a prefix of another name
+	if ( it->option_name().length() == long_opt.length() ) {
+		return &*it;
+	}
+
+	option_list::const_iterator next( it + 1 );
+	if ( next != index.end() && long_name_starts_with( *next, long_opt ) ) {
+		ambiguous = true;
+		return NULL;
+	}
+	return &*it;
+}
+
+STDOPT_INLINE
+const usage_c::option_list & usage_c::long_index() const
+{
+	if ( ! m_long_index_sorted ) {
+		std::stable_sort( m_long_index.begin(), m_long_index.end()
+				, long_name_less );
+		m_long_index_sorted = true;
+	}
+	return m_long_index;
+}
+
+STDOPT_INLINE
+int usage_c::complete( const std::string &prefix
+		, std::vector< const usage_option_i * > &matches ) const
+{
+	const option_list &index( long_index() );
+	option_list::const_iterator it( std::lower_bound( index.begin()
+				, index.end(), prefix, long_name_before ) );
+	int count( 0 );
+	for ( ; it!=index.end() && long_name_starts_with( *it, prefix ); ++it ) {
+		matches.push_back( it->usage_option() );
+		++count;
+	}
+	return count;
+}
+
+STDOPT_INLINE
+bool usage_c::complete_args( int argc, const char **argv
+		, std::ostream &output ) const
+{
+	if ( argc < 2 || strcmp( argv[1], "--complete" ) != 0 ) {
+		return false;
+	}
+
+	std::string prefix( argc > 2 ? argv[2] : "" );
+	if ( prefix.compare( 0, 2, "--" ) == 0 ) {
+		prefix.erase( 0, 2 );
+	}
+
+	std::vector< const usage_option_i * > matches;
+	complete( prefix, matches );
+
+	std::string reply;
+	std::vector< const usage_option_i * >::const_iterator it;
+	for ( it=matches.begin(); it!=matches.end(); ++it ) {
+		reply += "--";
+		reply += (*it)->option_name_view();
+		reply += '\n';
+	}
+	output.write( reply.data(), reply.size() );
+	return true;
+}
+
+/**
+ * The widest the option column will grow before descriptions get
+ * pushed onto their own line.
+ */
+static const std::size_t MAX_OPTION_COLUMN( 32 );
+
+/**
+ * Append the option column for the given option.  ie. "-d, --depth=VALUE"
+ */
+static void append_option_column( std::string &out, const usage_option_i &opt )
+{
+	if ( opt.usage_character() ) {
+		out += '-';
+		out += opt.usage_character();
+		if ( ! opt.option_name_view().empty() ) {
+			out += ", ";
 		}
+	} else {
+		out += "    ";
+	}
+
+	if ( ! opt.option_name_view().empty() ) {
+		out += "--";
+		out += opt.option_name_view();
+		if ( opt.requires_param() ) {
+			out += "=VALUE";
+		}
+	} else if ( opt.requires_param() ) {
+		out += " VALUE";
 	}
-	return NULL;
 }
 
-/*
+/**
+ * Get the width of the option column for the given option without
+ * building it.
+ */
+static std::size_t option_column_width( const usage_option_i &opt )
+{
+	std::size_t width( opt.option_name_view().empty() && opt.usage_character()
+			? 2 : 4 );
+	if ( ! opt.option_name_view().empty() ) {
+		width += 2 + opt.option_name_view().length();
+	}
+	if ( opt.requires_param() ) {
+		width += 6;
+	}
+	return width;
+}
+
+/**
+ * Append text to a roff document, escaping characters that roff
+ * would otherwise interpret.
+ */
+static void append_roff( std::string &out, std::string_view text )
+{
+	std::string_view::const_iterator it( text.begin() );
+	for ( ; it!=text.end(); ++it ) {
+		if ( *it == '\\' ) {
+			out += "\\e";
+		} else if ( *it == '-' ) {
+			out += "\\-";
+		} else {
+			out += *it;
+		}
+		if ( *it == '\n' && it + 1 != text.end()
+				&& ( it[1] == '.' || it[1] == '\'' ) ) {
+			// don't let a line of the text be read as a request
+			out += "\\&";
+		}
+	}
+}
+
+
+STDOPT_INLINE
+usage_doc_c::usage_doc_c( const std::string &program )
+: m_program( program )
+, m_text()
+, m_rendered_generation( 0 )
+{}
+
+STDOPT_INLINE
 void usage_doc_c::write( const usage_c &usage, std::ostream &doc ) const
 {
-	doc << "Usage: shessiond [OPTIONS]\n\n";
-	doc << "Options:\n";
-	usage_option_c::list::const_iterator it;
+	const std::string &txt( text( usage ) );
+	doc.write( txt.data(), txt.size() );
+}
+
+STDOPT_INLINE
+const std::string & usage_doc_c::text( const usage_c &usage ) const
+{
+	if ( m_rendered_generation != usage.m_generation ) {
+		render_text( usage );
+	}
+	return m_text;
+}
+
+STDOPT_INLINE
+void usage_doc_c::render_text( const usage_c &usage ) const
+{
+	usage_c::option_list::const_iterator it;
+
+	// lay out the columns once before writing anything
+	std::size_t column( 0 );
+	std::size_t length( m_program.length() + 32 );
+	for ( it=usage.m_option.begin(); it!=usage.m_option.end(); ++it ) {
+		std::size_t width( option_column_width( *it->usage_option() ) );
+		if ( width <= MAX_OPTION_COLUMN && width > column ) {
+			column = width;
+		}
+		length += width + it->usage_option()->description_view().length()
+			+ MAX_OPTION_COLUMN + 6;
+	}
+	column += 2;
+
+	m_text.clear();
+	m_text.reserve( length );
+	if ( ! m_program.empty() ) {
+		m_text += "Usage: ";
+		m_text += m_program;
+		m_text += " [OPTIONS]\n\n";
+	}
+	m_text += "Options:\n";
+
+	for ( it=usage.m_option.begin(); it!=usage.m_option.end(); ++it ) {
+		const usage_option_i &opt( *it->usage_option() );
+		std::size_t line_start( m_text.length() );
+		m_text += "  ";
+		append_option_column( m_text, opt );
+
+		if ( ! opt.description_view().empty() ) {
+			std::size_t width( m_text.length() - line_start - 2 );
+			if ( width > column ) {
+				// too wide, put the description on the next line
+				m_text += '\n';
+				width = 0;
+			}
+			m_text.append( column - width, ' ' );
+			m_text += opt.description_view();
+		}
+		m_text += '\n';
+	}
+
+	m_rendered_generation = usage.m_generation;
+}
+
+STDOPT_INLINE
+void usage_doc_c::write_man( const usage_c &usage, std::ostream &doc ) const
+{
+	std::string man;
+	std::string title( m_program.empty() ? std::string( "PROGRAM" )
+			: m_program );
+	std::string::iterator t( title.begin() );
+	for ( ; t!=title.end(); ++t ) {
+		*t = toupper( *t );
+	}
+
+	man += ".TH ";
+	append_roff( man, title );
+	man += " 1\n";
+	if ( ! m_program.empty() ) {
+		man += ".SH NAME\n";
+		append_roff( man, m_program );
+		man += "\n.SH SYNOPSIS\n.B ";
+		append_roff( man, m_program );
+		man += "\n[OPTIONS]\n";
+	}
+	man += ".SH OPTIONS\n";
+
+	usage_c::option_list::const_iterator it;
 	for ( it=usage.m_option.begin(); it!=usage.m_option.end(); ++it ) {
-		(*it)->write_usage_doc( doc );
+		const usage_option_i &opt( *it->usage_option() );
+		man += ".TP\n";
+		if ( opt.usage_character() ) {
+			man += "\\fB\\-";
+			man += opt.usage_character();
+			man += "\\fR";
+			if ( ! opt.option_name_view().empty() ) {
+				man += ", ";
+			}
+		}
+		if ( ! opt.option_name_view().empty() ) {
+			man += "\\fB\\-\\-";
+			append_roff( man, opt.option_name_view() );
+			man += "\\fR";
+			if ( opt.requires_param() ) {
+				man += "=\\fIVALUE\\fR";
+			}
+		} else if ( opt.requires_param() ) {
+			man += " \\fIVALUE\\fR";
+		}
+		man += '\n';
+		if ( ! opt.description_view().empty() ) {
+			if ( opt.description_view()[0] == '.'
+					|| opt.description_view()[0] == '\'' ) {
+				man += "\\&";
+			}
+			append_roff( man, opt.description_view() );
+			man += '\n';
+		}
 	}
-	doc << "\n";
+
+	doc.write( man.data(), man.size() );
 }
-*/
 
+STDOPT_INLINE
+void usage_doc_c::write_bash_completion( std::ostream &doc ) const
+{
+	std::string func( "_" );
+	std::string::const_iterator it( m_program.begin() );
+	for ( ; it!=m_program.end(); ++it ) {
+		func += isalnum( *it ) ? *it : '_';
+	}
+	func += "_complete";
+
+	std::string script;
+	script += func;
+	script += "()\n{\n"
+		"\tlocal cur=\"${COMP_WORDS[COMP_CWORD]}\"\n"
+		"\tcase \"$cur\" in\n"
+		"\t--*)\n"
+		"\t\tCOMPREPLY=( $( \"${COMP_WORDS[0]}\" --complete \"$cur\" ) )\n"
+		"\t\t;;\n"
+		"\tesac\n"
+		"}\n"
+		"complete -o default -F ";
+	script += func;
+	script += ' ';
+	script += m_program;
+	script += '\n';
+	doc.write( script.data(), script.size() );
+}
+
+STDOPT_INLINE
+void usage_doc_c::write_zsh_completion( std::ostream &doc ) const
+{
+	std::string script;
+	script += "#compdef ";
+	script += m_program;
+	script += "\n"
+		"if [[ \"$PREFIX\" == --* ]]; then\n"
+		"\tlocal -a opts\n"
+		"\topts=( ${(f)\"$( \"${words[1]}\" --complete \"$PREFIX\" )\"} )\n"
+		"\tcompadd -- $opts\n"
+		"else\n"
+		"\t_files\n"
+		"fi\n";
+	doc.write( script.data(), script.size() );
+}